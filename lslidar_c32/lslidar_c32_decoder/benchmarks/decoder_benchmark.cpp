@@ -0,0 +1,136 @@
+/*
+ * This file is part of lslidar_c32 driver.
+ *
+ * The driver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The driver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the driver.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmarks of the C32 packet decoding and point projection.
+// Each iteration of the scan benchmark decodes one revolution of
+// synthetic packets into a fresh sweep, like packetCallback() does,
+// and reports points/s and heap allocations per scan. No ROS master
+// is needed.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include <lslidar_c32_decoder/lslidar_c32_decoder.h>
+
+using namespace lslidar_c32_decoder;
+
+namespace {
+
+boost::atomic<size_t> g_allocations(0);
+
+// Azimuth step between blocks, 0.18 degree at 10 Hz.
+const int AZIMUTH_STEP = 18;
+const int PACKETS_PER_SWEEP = 36000 / (AZIMUTH_STEP * BLOCKS_PER_PACKET);
+
+// One revolution of packets with smooth ranges and some misses.
+std::vector<RawPacket> makeSweepPackets() {
+    std::vector<RawPacket> packets(PACKETS_PER_SWEEP);
+    unsigned int rotation = 0;
+    unsigned int noise = 12345;
+    for (size_t pkt_idx = 0; pkt_idx < packets.size(); ++pkt_idx) {
+        RawPacket& packet = packets[pkt_idx];
+        for (size_t blk_idx = 0; blk_idx < BLOCKS_PER_PACKET; ++blk_idx) {
+            RawBlock& block = packet.blocks[blk_idx];
+            block.header = UPPER_BANK;
+            block.rotation = rotation;
+            for (size_t scan_idx = 0; scan_idx < SCANS_PER_BLOCK; ++scan_idx) {
+                noise = noise * 1103515245 + 12345;
+                // distance in cm, zero for no return
+                int distance = 1000 + 600 * std::sin(rotation * 0.0005 + scan_idx * 0.4) +
+                        (noise >> 16) % 4;
+                if ((noise >> 8) % 16 == 0) distance = 0;
+                uint8_t* data = &block.data[RAW_SCAN_SIZE * scan_idx];
+                data[0] = distance & 0xff;
+                data[1] = (distance >> 8) & 0xff;
+                data[2] = static_cast<uint8_t>(20 + (noise >> 20) % 80);
+            }
+            rotation = (rotation + AZIMUTH_STEP) % 36000;
+        }
+        packet.time_stamp = 0;
+    }
+    return packets;
+}
+
+void BM_DecodeFirings(benchmark::State& state) {
+    const std::vector<RawPacket> packets = makeSweepPackets();
+    Firing firings[FIRINGS_PER_PACKET];
+    size_t pkt_idx = 0;
+    for (auto _ : state) {
+        decodeFirings(&packets[pkt_idx], firings);
+        benchmark::DoNotOptimize(firings);
+        pkt_idx = (pkt_idx + 1) % packets.size();
+    }
+    state.SetItemsProcessed(state.iterations() * FIRINGS_PER_PACKET * SCANS_PER_FIRING);
+}
+BENCHMARK(BM_DecodeFirings);
+
+void BM_DecodeAndProjectSweep(benchmark::State& state) {
+    const std::vector<RawPacket> packets = makeSweepPackets();
+    FiringProjector projector;
+    projector.setRange(0.5, 100.0);
+    Firing firings[FIRINGS_PER_PACKET];
+
+    size_t points = 0;
+    size_t allocations = 0;
+    for (auto _ : state) {
+        const size_t before = g_allocations;
+        lslidar_c32_msgs::LslidarC32SweepPtr sweep(new lslidar_c32_msgs::LslidarC32Sweep());
+        double packet_start_time = 0.0;
+        for (size_t pkt_idx = 0; pkt_idx < packets.size(); ++pkt_idx) {
+            decodeFirings(&packets[pkt_idx], firings);
+            projector.project(firings, 0, FIRINGS_PER_PACKET,
+                              packet_start_time, 0, *sweep);
+            packet_start_time += FIRING_TOFFSET * FIRINGS_PER_PACKET;
+        }
+        for (size_t scan_idx = 0; scan_idx < 32; ++scan_idx)
+            points += sweep->scans[scan_idx].points.size();
+        benchmark::DoNotOptimize(sweep.get());
+        sweep.reset();
+        allocations += g_allocations - before;
+    }
+
+    state.SetItemsProcessed(points);
+    state.counters["points/s"] = benchmark::Counter(points, benchmark::Counter::kIsRate);
+    state.counters["points/scan"] = benchmark::Counter(points, benchmark::Counter::kAvgIterations);
+    state.counters["allocs/scan"] = benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_DecodeAndProjectSweep)->Unit(benchmark::kMicrosecond);
+
+} // end namespace
+
+// Count the heap allocations of the whole process.
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+BENCHMARK_MAIN();
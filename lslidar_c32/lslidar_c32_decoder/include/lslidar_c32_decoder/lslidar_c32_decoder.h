@@ -275,6 +275,70 @@ struct PointXYZIT {
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW  // make sure our new allocators are aligned
 } EIGEN_ALIGN16;
 
+union TwoBytes {
+    uint16_t distance;
+    uint8_t  bytes[2];
+};
+
+struct RawBlock {
+    uint16_t header;        ///< UPPER_BANK or LOWER_BANK
+    uint16_t rotation;      ///< 0-35999, divide by 100 to get degrees
+    uint8_t  data[BLOCK_DATA_SIZE];
+};
+
+struct RawPacket {
+    RawBlock blocks[BLOCKS_PER_PACKET];
+    uint32_t time_stamp;
+    uint8_t factory[2];
+    //uint16_t revolution;
+    //uint8_t status[PACKET_STATUS_SIZE];
+};
+
+struct Firing {
+    // Azimuth associated with the first shot within this firing.
+    double firing_azimuth;
+    double azimuth[SCANS_PER_FIRING];
+    double distance[SCANS_PER_FIRING];
+    double intensity[SCANS_PER_FIRING];
+};
+
+// Fill in the azimuth, distance and intensity of each firing in a packet.
+void decodeFirings(const RawPacket* packet, Firing* firings);
+
+// Converts decoded firings to the points of a sweep. Neither this nor
+// decodeFirings() needs ROS I/O, so both can run without a master.
+class FiringProjector {
+public:
+
+    FiringProjector();
+
+    void setRange(const double min_range, const double max_range) {
+        this->min_range = min_range;
+        this->max_range = max_range;
+    }
+
+    // Append the points of firings [start_fir_idx, end_fir_idx) to the
+    // scans of the sweep. Point times are relative to packet_start_time
+    // at firing time_fir_idx.
+    void project(const Firing* firings,
+                 const size_t start_fir_idx, const size_t end_fir_idx,
+                 const double packet_start_time, const size_t time_fir_idx,
+                 lslidar_c32_msgs::LslidarC32Sweep& sweep) const;
+
+private:
+
+    // Check if a point is in the required range.
+    bool isPointInRange(const double& distance) const {
+        return (distance >= min_range && distance <= max_range);
+    }
+
+    double min_range;
+    double max_range;
+
+    double cos_azimuth_table[6300];
+    double sin_azimuth_table[6300];
+};
+
 class LslidarC32Decoder {
 public:
 
@@ -290,33 +354,6 @@ public:
 
 private:
 
-    union TwoBytes {
-        uint16_t distance;
-        uint8_t  bytes[2];
-    };
-
-    struct RawBlock {
-        uint16_t header;        ///< UPPER_BANK or LOWER_BANK
-        uint16_t rotation;      ///< 0-35999, divide by 100 to get degrees
-        uint8_t  data[BLOCK_DATA_SIZE];
-    };
-
-    struct RawPacket {
-        RawBlock blocks[BLOCKS_PER_PACKET];
-        uint32_t time_stamp;
-        uint8_t factory[2];
-        //uint16_t revolution;
-        //uint8_t status[PACKET_STATUS_SIZE];
-    };
-
-    struct Firing {
-        // Azimuth associated with the first shot within this firing.
-        double firing_azimuth;
-        double azimuth[SCANS_PER_FIRING];
-        double distance[SCANS_PER_FIRING];
-        double intensity[SCANS_PER_FIRING];
-    };
-
     // Intialization sequence
     bool loadParameters();
     bool createRosIO();
@@ -324,7 +361,6 @@ private:
 
     // Callback function for a single lslidar packet.
     bool checkPacketValidity(const RawPacket* packet);
-    void decodePacket(const RawPacket* packet);
     void layerCallback(const std_msgs::Int8Ptr& msg);
     void packetCallback(const lslidar_c32_msgs::LslidarC32PacketConstPtr& msg);
     // Publish data
@@ -333,17 +369,6 @@ private:
     // Publish scan Data
     void publishScan();
 
-    // Check if a point is in the required range.
-    bool isPointInRange(const double& distance) {
-        return (distance >= min_range && distance <= max_range);
-    }
-
-    double rawAzimuthToDouble(const uint16_t& raw_azimuth) {
-        // According to the user manual,
-        // azimuth = raw_azimuth / 100.0;
-        return static_cast<double>(raw_azimuth) / 100.0 * DEG_TO_RAD;
-    }
-
     // calc the means_point
     point_struct getMeans(std::vector<point_struct> clusters);
 
@@ -359,9 +384,8 @@ private:
     double frequency;
     bool publish_point_cloud;
     bool publish_channels;
-    
-    double cos_azimuth_table[6300];
-    double sin_azimuth_table[6300];
+
+    FiringProjector projector;
 
     bool is_first_sweep;
     double last_azimuth;
@@ -21,6 +21,13 @@
 using namespace std;
 
 namespace lslidar_c32_decoder {
+
+static double rawAzimuthToDouble(const uint16_t& raw_azimuth) {
+    // According to the user manual,
+    // azimuth = raw_azimuth / 100.0;
+    return static_cast<double>(raw_azimuth) / 100.0 * DEG_TO_RAD;
+}
+
 LslidarC32Decoder::LslidarC32Decoder(
         ros::NodeHandle& n, ros::NodeHandle& pn):
     nh(n),
@@ -52,6 +59,7 @@ bool LslidarC32Decoder::loadParameters() {
     pnh.param<string>("child_frame_id", child_frame_id, "lslidar");
 
     angle_base = M_PI*2 / point_num;
+    projector.setRange(min_range, max_range);
     return true;
 }
 
@@ -88,13 +96,6 @@ bool LslidarC32Decoder::initialize() {
         sweep_data->scans[remapped_scan_idx].altitude = scan_altitude[scan_idx];
     }
 
-    // Create the sin and cos table for different azimuth values.
-    for (size_t i = 0; i < 6300; ++i) {
-        double angle = static_cast<double>(i) / 1000.0;
-        cos_azimuth_table[i] = cos(angle);
-        sin_azimuth_table[i] = sin(angle);
-    }
-
     return true;
 }
 
@@ -290,7 +291,78 @@ point_struct LslidarC32Decoder::getMeans(std::vector<point_struct> clusters)
     return tmp;
 }
 
-void LslidarC32Decoder::decodePacket(const RawPacket* packet) {
+FiringProjector::FiringProjector():
+    min_range(0.0),
+    max_range(DISTANCE_MAX) {
+    // Create the sin and cos table for different azimuth values.
+    for (size_t i = 0; i < 6300; ++i) {
+        double angle = static_cast<double>(i) / 1000.0;
+        cos_azimuth_table[i] = cos(angle);
+        sin_azimuth_table[i] = sin(angle);
+    }
+}
+
+void FiringProjector::project(const Firing* firings,
+        const size_t start_fir_idx, const size_t end_fir_idx,
+        const double packet_start_time, const size_t time_fir_idx,
+        lslidar_c32_msgs::LslidarC32Sweep& sweep) const {
+    for (size_t fir_idx = start_fir_idx; fir_idx < end_fir_idx; ++fir_idx) {
+        for (size_t scan_idx = 0; scan_idx < SCANS_PER_FIRING; ++scan_idx) {
+            // Check if the point is valid.
+            if (!isPointInRange(firings[fir_idx].distance[scan_idx])) continue;
+
+            // Convert the point to xyz coordinate
+            size_t table_idx = floor(firings[fir_idx].azimuth[scan_idx]*1000.0+0.5);
+            //cout << table_idx << endl;
+            if(table_idx>6280) table_idx-=6280;
+            double cos_azimuth = cos_azimuth_table[table_idx];
+            double sin_azimuth = sin_azimuth_table[table_idx];
+
+            //double x = firings[fir_idx].distance[scan_idx] *
+            //  cos_scan_altitude[scan_idx] * sin(firings[fir_idx].azimuth[scan_idx]);
+            //double y = firings[fir_idx].distance[scan_idx] *
+            //  cos_scan_altitude[scan_idx] * cos(firings[fir_idx].azimuth[scan_idx]);
+            //double z = firings[fir_idx].distance[scan_idx] *
+            //  sin_scan_altitude[scan_idx];
+
+            double x = firings[fir_idx].distance[scan_idx] *
+                    cos_scan_altitude[scan_idx] * sin_azimuth;
+            double y = firings[fir_idx].distance[scan_idx] *
+                    cos_scan_altitude[scan_idx] * cos_azimuth;
+            double z = firings[fir_idx].distance[scan_idx] *
+                    sin_scan_altitude[scan_idx];
+
+            double x_coord = y;
+            double y_coord = -x;
+            double z_coord = z;
+
+            // Compute the time of the point
+            double time = packet_start_time +
+                    FIRING_TOFFSET*(fir_idx-time_fir_idx) + DSR_TOFFSET*scan_idx;
+
+            // Remap the index of the scan
+            int remapped_scan_idx = scan_idx%2 == 0 ? scan_idx/2 : scan_idx/2+16;
+            sweep.scans[remapped_scan_idx].points.push_back(
+                        lslidar_c32_msgs::LslidarC32Point());
+
+            lslidar_c32_msgs::LslidarC32Point& new_point =		// new_point 为push_back最后一个的引用
+                    sweep.scans[remapped_scan_idx].points[
+                    sweep.scans[remapped_scan_idx].points.size()-1];
+
+            // Pack the data into point msg
+            new_point.time = time;
+            new_point.x = x_coord;
+            new_point.y = y_coord;
+            new_point.z = z_coord;
+            new_point.azimuth = firings[fir_idx].azimuth[scan_idx];
+            new_point.distance = firings[fir_idx].distance[scan_idx];
+            new_point.intensity = firings[fir_idx].intensity[scan_idx];
+        }
+    }
+    return;
+}
+
+void decodeFirings(const RawPacket* packet, Firing* firings) {
 
     // Compute the azimuth angle for each firing
     for (size_t fir_idx = 0; fir_idx < FIRINGS_PER_PACKET; fir_idx++) {
@@ -409,7 +481,7 @@ void LslidarC32Decoder::packetCallback(
     if (!checkPacketValidity(raw_packet)) return;
 
     // Decode the packet
-    decodePacket(raw_packet);
+    decodeFirings(raw_packet, firings);
     point_time = msg->stamp.toSec();
     // Find the start of a new revolution
     //    If there is one, new_sweep_start will be the index of the start firing,
@@ -444,59 +516,8 @@ void LslidarC32Decoder::packetCallback(
         }
     }
 
-    for (size_t fir_idx = start_fir_idx; fir_idx < end_fir_idx; ++fir_idx) {
-        for (size_t scan_idx = 0; scan_idx < SCANS_PER_FIRING; ++scan_idx) {
-            // Check if the point is valid.
-            if (!isPointInRange(firings[fir_idx].distance[scan_idx])) continue;
-
-            // Convert the point to xyz coordinate
-            size_t table_idx = floor(firings[fir_idx].azimuth[scan_idx]*1000.0+0.5);
-            //cout << table_idx << endl;
-            if(table_idx>6280) table_idx-=6280;
-            double cos_azimuth = cos_azimuth_table[table_idx];
-            double sin_azimuth = sin_azimuth_table[table_idx];
-
-            //double x = firings[fir_idx].distance[scan_idx] *
-            //  cos_scan_altitude[scan_idx] * sin(firings[fir_idx].azimuth[scan_idx]);
-            //double y = firings[fir_idx].distance[scan_idx] *
-            //  cos_scan_altitude[scan_idx] * cos(firings[fir_idx].azimuth[scan_idx]);
-            //double z = firings[fir_idx].distance[scan_idx] *
-            //  sin_scan_altitude[scan_idx];
-
-            double x = firings[fir_idx].distance[scan_idx] *
-                    cos_scan_altitude[scan_idx] * sin_azimuth;
-            double y = firings[fir_idx].distance[scan_idx] *
-                    cos_scan_altitude[scan_idx] * cos_azimuth;
-            double z = firings[fir_idx].distance[scan_idx] *
-                    sin_scan_altitude[scan_idx];
-
-            double x_coord = y;
-            double y_coord = -x;
-            double z_coord = z;
-
-            // Compute the time of the point
-            double time = packet_start_time +
-                    FIRING_TOFFSET*fir_idx + DSR_TOFFSET*scan_idx;
-
-            // Remap the index of the scan
-            int remapped_scan_idx = scan_idx%2 == 0 ? scan_idx/2 : scan_idx/2+16;
-            sweep_data->scans[remapped_scan_idx].points.push_back(
-                        lslidar_c32_msgs::LslidarC32Point());
-
-            lslidar_c32_msgs::LslidarC32Point& new_point =		// new_point 为push_back最后一个的引用
-                    sweep_data->scans[remapped_scan_idx].points[
-                    sweep_data->scans[remapped_scan_idx].points.size()-1];
-
-            // Pack the data into point msg
-            new_point.time = time;
-            new_point.x = x_coord;
-            new_point.y = y_coord;
-            new_point.z = z_coord;
-            new_point.azimuth = firings[fir_idx].azimuth[scan_idx];
-            new_point.distance = firings[fir_idx].distance[scan_idx];
-            new_point.intensity = firings[fir_idx].intensity[scan_idx];
-        }
-    }
+    projector.project(firings, start_fir_idx, end_fir_idx,
+                      packet_start_time, 0, *sweep_data);
 
     packet_start_time += FIRING_TOFFSET * (end_fir_idx-start_fir_idx);
 
@@ -530,58 +551,8 @@ void LslidarC32Decoder::packetCallback(
         start_fir_idx = end_fir_idx;
         end_fir_idx = FIRINGS_PER_PACKET;
 
-        for (size_t fir_idx = start_fir_idx; fir_idx < end_fir_idx; ++fir_idx) {
-            for (size_t scan_idx = 0; scan_idx < SCANS_PER_FIRING; ++scan_idx) {
-                // Check if the point is valid.
-                if (!isPointInRange(firings[fir_idx].distance[scan_idx])) continue;
-
-                // Convert the point to xyz coordinate
-                size_t table_idx = floor(firings[fir_idx].azimuth[scan_idx]*1000.0+0.5);
-                //cout << table_idx << endl;
-                if(table_idx>6280) table_idx-=6280;
-                double cos_azimuth = cos_azimuth_table[table_idx];
-                double sin_azimuth = sin_azimuth_table[table_idx];
-
-                //double x = firings[fir_idx].distance[scan_idx] *
-                //  cos_scan_altitude[scan_idx] * sin(firings[fir_idx].azimuth[scan_idx]);
-                //double y = firings[fir_idx].distance[scan_idx] *
-                //  cos_scan_altitude[scan_idx] * cos(firings[fir_idx].azimuth[scan_idx]);
-                //double z = firings[fir_idx].distance[scan_idx] *
-                //  sin_scan_altitude[scan_idx];
-
-                double x = firings[fir_idx].distance[scan_idx] *
-                        cos_scan_altitude[scan_idx] * sin_azimuth;
-                double y = firings[fir_idx].distance[scan_idx] *
-                        cos_scan_altitude[scan_idx] * cos_azimuth;
-                double z = firings[fir_idx].distance[scan_idx] *
-                        sin_scan_altitude[scan_idx];
-
-                double x_coord = y;
-                double y_coord = -x;
-                double z_coord = z;
-
-                // Compute the time of the point
-                double time = packet_start_time +
-                        FIRING_TOFFSET*(fir_idx-start_fir_idx) + DSR_TOFFSET*scan_idx;
-
-                // Remap the index of the scan
-                int remapped_scan_idx = scan_idx%2 == 0 ? scan_idx/2 : scan_idx/2+16;
-                sweep_data->scans[remapped_scan_idx].points.push_back(
-                            lslidar_c32_msgs::LslidarC32Point());
-                lslidar_c32_msgs::LslidarC32Point& new_point =
-                        sweep_data->scans[remapped_scan_idx].points[
-                        sweep_data->scans[remapped_scan_idx].points.size()-1];
-
-                // Pack the data into point msg
-                new_point.time = time;
-                new_point.x = x_coord;
-                new_point.y = y_coord;
-                new_point.z = z_coord;
-                new_point.azimuth = firings[fir_idx].azimuth[scan_idx];
-                new_point.distance = firings[fir_idx].distance[scan_idx];
-                new_point.intensity = firings[fir_idx].intensity[scan_idx];
-            }
-        }
+        projector.project(firings, start_fir_idx, end_fir_idx,
+                          packet_start_time, start_fir_idx, *sweep_data);
 
         packet_start_time += FIRING_TOFFSET * (end_fir_idx-start_fir_idx);
     }
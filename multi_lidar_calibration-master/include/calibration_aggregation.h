@@ -0,0 +1,48 @@
+#ifndef PROJECT_CALIBRATION_AGGREGATION_H
+#define PROJECT_CALIBRATION_AGGREGATION_H
+
+#include <cstddef>
+#include <vector>
+#include <Eigen/Dense>
+
+typedef std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > TransformVector;
+
+/*!
+ * One child frame and the parent frame nearest in time
+ */
+struct FramePair
+{
+	size_t                              child;
+	size_t                              parent_frame;
+	size_t                              child_frame;
+};
+
+/*!
+ * Pairs every child frame with the nearest parent frame within in_max_time_diff,
+ * then keeps at most in_max_pairs pairs evenly spread over the recording
+ * @param in_child index of the child, copied to the pairs
+ * @param in_parent_stamps stamps of the parent frames, sorted
+ * @param in_child_stamps stamps of the child frames
+ * @param in_max_time_diff largest stamp difference of a pair
+ * @param in_max_pairs largest number of pairs returned
+ * @return pairs, in the order of the child frames
+ */
+std::vector<FramePair> PairFrames(size_t in_child, const std::vector<double>& in_parent_stamps,
+                                  const std::vector<double>& in_child_stamps, double in_max_time_diff,
+                                  size_t in_max_pairs);
+
+/*!
+ * Mean of the transformations within the inlier thresholds of the median one
+ * @param in_transforms transformations found by the alignments of one child
+ * @param in_inlier_translation largest distance of an inlier to the median
+ * @param in_inlier_rotation largest angle of an inlier to the median
+ * @param out_transform mean of the inliers, left unchanged when there is none
+ * @param out_translation_spread largest distance of an inlier to the mean
+ * @param out_rotation_spread largest angle of an inlier to the mean
+ * @return number of inliers
+ */
+size_t AggregateTransforms(const TransformVector& in_transforms, double in_inlier_translation,
+                           double in_inlier_rotation, Eigen::Matrix4f& out_transform,
+                           double& out_translation_spread, double& out_rotation_spread);
+
+#endif //PROJECT_CALIBRATION_AGGREGATION_H
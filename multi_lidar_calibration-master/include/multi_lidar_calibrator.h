@@ -3,13 +3,22 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <map>
 #include <chrono>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <condition_variable>
 #include <ros/ros.h>
 #include <sensor_msgs/point_cloud_conversion.h>
 #include <sensor_msgs/PointCloud.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <diagnostic_updater/diagnostic_updater.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl/PCLPointCloud2.h>
 #include <pcl_ros/transforms.h>
@@ -17,6 +26,7 @@
 #include <pcl/point_types.h>
 #include <pcl/filters/voxel_grid.h>
 #include <pcl/registration/ndt.h>
+#include <pclomp/ndt_omp.h>
 #include <message_filters/subscriber.h>
 #include <message_filters/synchronizer.h>
 #include <message_filters/sync_policies/approximate_time.h>
@@ -26,21 +36,93 @@
 #include <tf/transform_broadcaster.h>
 #include <tf_conversions/tf_eigen.h>
 
+#include "point_cloud2_view.h"
+#include "registration_backend.h"
+
 #define __APP_NAME__ "multi_lidar_calibrator"
 
 class ROSMultiLidarCalibratorApp
 
 {
+	typedef
+	message_filters::sync_policies::ApproximateTime<sensor_msgs::PointCloud2,
+			sensor_msgs::PointCloud2>   SyncPolicyT;
+
+	typedef pcl::PointXYZ               PointT;
+
+	/*!
+	 * Pair of frames kept for the submaps of a child
+	 */
+	struct Keyframe
+	{
+		// downsampled at voxel_size_, each in its own sensor frame
+		pcl::PointCloud<PointT>::ConstPtr                       parent_cloud;
+		pcl::PointCloud<PointT>::ConstPtr                       child_cloud;
+		// parent frame of the keyframe in the parent frame of the first keyframe of the submaps
+		Eigen::Matrix4f                                         parent_pose;
+
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	};
+
+	/*!
+	 * Calibration of one child lidar against the parent. Each child is aligned by its own worker thread.
+	 */
+	struct ChildCalibration
+	{
+		std::string                                             topic;
+		message_filters::Subscriber<sensor_msgs::PointCloud2>   *subscriber;
+		message_filters::Synchronizer<SyncPolicyT>              *synchronizer;
+		ros::Publisher                                          result_publisher;
+		std::thread                                             worker;
+
+		// guards everything below, shared with the callbacks and the tf timer
+		std::mutex                                              mutex;
+		std::condition_variable                                 fresh_pair;
+
+		// latest synchronized pair, taken by the worker
+		sensor_msgs::PointCloud2::ConstPtr                      parent_msg, child_msg;
+
+		std::string                                             parent_frame;
+		std::string                                             child_frame;
+		Eigen::Matrix4f                                         current_guess;
+
+		bool                                                    calibrated;
+		bool                                                    converged;
+		bool                                                    drifted;        // calibrating again
+		bool                                                    unsubscribe_pending;    // done, see BroadcastTransform
+		int                                                     alignment_count;
+		ros::Time                                               last_alignment_time;
+
+		// drift monitor of a converged calibration, see CheckDrift
+		ros::Time                                               last_check_time;
+		double                                                  consistency;
+		double                                                  consistency_baseline;
+		int                                                     baseline_checks;
+		int                                                     degraded_checks;
+
+		// last alignment, see ChildDiagnostics
+		AlignmentResult                                         last_result;
+		double                                                  translation_delta;
+		double                                                  rotation_delta;
+
+		std::deque<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > recent_transforms;
+		std::deque<double>                                      recent_fitness;
+
+		// used by the worker only, newest last
+		std::deque<Keyframe, Eigen::aligned_allocator<Keyframe> > keyframes;
+		std::unordered_set<int64_t>                             keyframe_voxels;    // occupied by the newest parent
+		ros::Time                                               last_keyframe_stamp;
+
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	};
+
 	ros::NodeHandle                     node_handle_;
 	ros::Publisher                      calibrated_cloud_publisher_;
+	ros::Timer                          tf_timer_;
 
 	ros::Subscriber                     initialpose_subscriber_;
     tf::TransformBroadcaster            tf_br;
 
-    int child_topic_num_;
-
-    std::map<std::string, std::vector<double>> transfer_map_;
-
     std::string points_parent_topic_str, points_child_topic_str;
 
 
@@ -57,55 +139,149 @@ class ROSMultiLidarCalibratorApp
 	double                              initial_yaw_;
 
 	int                                 ndt_iterations_;
+	int                                 ndt_num_threads_;
 
-	std::string                         parent_frame_;
-	std::string                         child_frame_;
+	// coarse to fine, the last level is voxel_size_ and the ndt_ parameters
+	std::vector<RegistrationLevel>      levels_;
+	RegistrationBackend::ConstPtr       backend_;
+	pclomp::NeighborSearchMethod        ndt_search_method_;
 
-	Eigen::Matrix4f                     current_guess_;
+	int                                 convergence_window_;
+	double                              convergence_translation_;
+	double                              convergence_rotation_;
+	double                              convergence_fitness_;
+	double                              monitor_interval_;
 
-	typedef
-	message_filters::sync_policies::ApproximateTime<sensor_msgs::PointCloud2,
-			sensor_msgs::PointCloud2>   SyncPolicyT;
+	// consistency of converged calibrations, checked every monitor_interval_ at the calibrated pose
+	double                              monitor_voxel_size_;
+	int                                 monitor_samples_;
+	double                              monitor_tolerance_;
+	int                                 monitor_degraded_checks_;
+	diagnostic_updater::Updater         diagnostics_;
 
-	typedef pcl::PointXYZ               PointT;
+	// submaps of keyframe_count_ keyframes, 1 aligns single frames
+	int                                 keyframe_count_;
+	double                              keyframe_overlap_;
+	double                              keyframe_interval_;
+
+	message_filters::Subscriber<sensor_msgs::PointCloud2>   *cloud_parent_subscriber_;
 
-	message_filters::Subscriber<sensor_msgs::PointCloud2>   *cloud_parent_subscriber_, *cloud_child_subscriber_;
-	message_filters::Synchronizer<SyncPolicyT>              *cloud_synchronizer_;
+	std::vector<std::unique_ptr<ChildCalibration> >         children_;
+	size_t                                                  unsubscribed_children_;    // by BroadcastTransform only
+	std::atomic<bool>                                       shutting_down_;
 
-    pcl::PointCloud<PointT>::Ptr in_parent_cloud_, in_child_cloud_, in_child_filtered_cloud_;
+	// target of the last parent message, built once for every child
+	std::mutex                                              parent_mutex_;
+	sensor_msgs::PointCloud2::ConstPtr                      parent_msg_;
+	RegistrationBackend::TargetConstPtr                     parent_target_;
 
 	/*!
-	 * Receives 2 synchronized point cloud messages.
-	 * @param[in] in_parent_cloud_msg Message containing pointcloud classified as ground.
-	 * @param[in] in_child_cloud_msg Message containing pointcloud classified as obstacle.
+	 * Receives 2 synchronized point cloud messages and hands them to the worker of the child.
+	 * @param[in] in_child calibration the pair belongs to
+	 * @param[in] in_parent_cloud_msg Message containing the pointcloud of the parent lidar.
+	 * @param[in] in_child_cloud_msg Message containing the pointcloud of the child lidar.
 	 */
-	void PointsCallback(const sensor_msgs::PointCloud2::ConstPtr& in_parent_cloud_msg,
+	void PointsCallback(ChildCalibration* in_child,
+	                    const sensor_msgs::PointCloud2::ConstPtr& in_parent_cloud_msg,
 	                    const sensor_msgs::PointCloud2::ConstPtr& in_child_cloud_msg);
 
 	/*!
-	 * Obtains parameters from the command line, initializes subscribers and publishers.
-	 * @param in_private_handle ROS private handle to get parameters for this node.
+	 * Worker thread of a child, aligns every pair it receives until shutdown.
+	 * @param[in] in_child calibration to run
 	 */
-	void InitializeROSIo(ros::NodeHandle& in_private_handle);
+	void CalibrateChild(ChildCalibration* in_child);
+
+	/*!
+	 * Builds the registration target of a parent cloud message, once for all the children
+	 * @param[in] in_parent_cloud_msg parent cloud message of a synchronized pair
+	 * @return parent target
+	 */
+	RegistrationBackend::TargetConstPtr GetParentTarget(const sensor_msgs::PointCloud2::ConstPtr& in_parent_cloud_msg);
+
+	/*!
+	 * Adds a pair to the keyframes of a child when its parent frame differs enough from the newest keyframe,
+	 * or when keyframe_interval_ passed since it. The pose of the parent is found against the parent submap.
+	 * The clouds are only converted, downsampled, for a keyframe.
+	 * @param in_child calibration of the child, from its worker
+	 * @param in_parent_cloud_msg parent cloud of the pair
+	 * @param in_child_cloud_msg child cloud of the pair
+	 * @return true when the pair became a keyframe
+	 */
+	bool AddKeyframe(ChildCalibration& in_child, const sensor_msgs::PointCloud2& in_parent_cloud_msg,
+	                 const sensor_msgs::PointCloud2& in_child_cloud_msg);
 
 	/*!
-	 * Applies a Voxel Grid filter to the point cloud
-	 * @param in_cloud_ptr point cloud to downsample
-	 * @param out_cloud_ptr downsampled point cloud
-	 * @param in_leaf_size voxel side size
+	 * Accumulates the keyframes of a child into submaps, in the frames of the newest keyframe
+	 * @param in_child calibration of the child, from its worker
+	 * @param in_guess transformation from the child to the parent, used to place the child frames
+	 * @param out_parent_submap parent submap, in the parent frame
+	 * @param out_child_submap child submap, in the child frame, skipped when null
 	 */
-	void DownsampleCloud(pcl::PointCloud<PointT>::ConstPtr in_cloud_ptr, pcl::PointCloud<PointT>::Ptr out_cloud_ptr, double in_leaf_size);
+	void BuildSubmaps(const ChildCalibration& in_child, const Eigen::Matrix4f& in_guess,
+	                  pcl::PointCloud<PointT>::Ptr out_parent_submap, pcl::PointCloud<PointT>::Ptr out_child_submap);
+
+	/*!
+	 * Obtains parameters from the command line, initializes subscribers and publishers.
+	 * @param in_private_handle ROS private handle to get parameters for this node.
+	 */
+	void InitializeROSIo(ros::NodeHandle& in_private_handle);
 
 	/*!
 	 * Publishes a PointCloud in the specified publisher
 	 * @param in_publisher Publisher to use
 	 * @param in_cloud_to_publish_ptr Cloud to Publish
+	 * @param in_frame frame of the cloud
 	 */
-	void PublishCloud(const ros::Publisher& in_publisher, pcl::PointCloud<PointT>::ConstPtr in_cloud_to_publish_ptr);
+	void PublishCloud(const ros::Publisher& in_publisher, pcl::PointCloud<PointT>::ConstPtr in_cloud_to_publish_ptr,
+	                  const std::string& in_frame);
 
-    void MatrixToTranform(Eigen::Matrix4f & matrix, tf::Transform & trans);
+    void MatrixToTranform(const Eigen::Matrix4f & matrix, tf::Transform & trans);
 
-    void PerformNdtOptimize();
+	/*!
+	 * Aligns one pair of clouds of a child and updates its calibration
+	 * @param in_child calibration of the child
+	 * @param in_parent_target target built from the parent cloud of the pair
+	 * @param in_child_cloud child cloud of the pair
+	 */
+    void PerformNdtOptimize(ChildCalibration& in_child, const RegistrationBackend::Target& in_parent_target,
+                            pcl::PointCloud<PointT>::ConstPtr in_child_cloud);
+
+	/*!
+	 * Adds an alignment to the convergence window of a child
+	 * @param in_child calibration of the child, locked
+	 * @param in_transform transformation found by the alignment
+	 * @param in_fitness fitness score of the alignment
+	 * @return true once every transformation in the window is within the convergence thresholds of the last one
+	 */
+	bool UpdateConvergence(ChildCalibration& in_child, const Eigen::Matrix4f& in_transform, double in_fitness);
+
+	/*!
+	 * Scores a pair of a converged child at its calibrated transformation, without any registration:
+	 * the fraction of sampled child points next to a parent point. Once the score stays below the baseline
+	 * of the first checks for monitor_degraded_checks_ checks, the child is calibrated again.
+	 * @param in_child calibration of the child, from its worker
+	 * @param in_parent_cloud_msg parent cloud of the pair
+	 * @param in_child_cloud_msg child cloud of the pair
+	 */
+	void CheckDrift(ChildCalibration& in_child, const sensor_msgs::PointCloud2& in_parent_cloud_msg,
+	                const sensor_msgs::PointCloud2& in_child_cloud_msg);
+
+	/*!
+	 * Reports the calibration state, the last alignment and the drift monitor of a child on /diagnostics
+	 */
+	void ChildDiagnostics(ChildCalibration* in_child, diagnostic_updater::DiagnosticStatusWrapper& out_status);
+
+	/*!
+	 * Publishes the converged transformation of a child, latched
+	 */
+	void PublishResult(const ChildCalibration& in_child);
+
+	/*!
+	 * Broadcasts the current transformation of every child on tf, and unsubscribes the children that are done,
+	 * then the parent once no child is left.
+	 * The subscriber waits for a running PointsCallback, so it is only shut down here, without the lock of the child.
+	 */
+	void BroadcastTransform(const ros::TimerEvent& in_event);
 
 public:
 	void Run();
@@ -0,0 +1,304 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2010-2011, Willow Garage, Inc.
+ *  Copyright (c) 2012-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Derived from pcl/registration/ndt.h of PCL, by way of include/pclomp/ndt_omp.h of ndt_omp
+ *  (https://github.com/koide3/ndt_omp, Kenji Koide, BSD License), which
+ *  parallelized it with OpenMP. Changed here for the neighbor searches and
+ *  the shared targets of the calibrator.
+ */
+
+#ifndef PCLOMP_NDT_OMP_H
+#define PCLOMP_NDT_OMP_H
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <Eigen/Dense>
+#include <pcl/registration/registration.h>
+#include <pclomp/voxel_grid_covariance_omp.h>
+
+namespace pclomp
+{
+
+/*!
+ * Normal Distributions Transform registration [Magnusson 2009], multi-threaded with OpenMP.
+ *
+ * A drop-in replacement of pcl::NormalDistributionsTransform: the score, gradient and
+ * hessian are accumulated over the source points in parallel, each thread into its own
+ * sums, which are added in thread order. With one thread and the KDTREE search the
+ * results are identical to pcl::NormalDistributionsTransform, and for a given number
+ * of threads they are the same on every run.
+ */
+template <typename PointSource, typename PointTarget>
+class NormalDistributionsTransform : public pcl::Registration<PointSource, PointTarget>
+{
+protected:
+    typedef typename pcl::Registration<PointSource, PointTarget>::PointCloudSource  PointCloudSource;
+    typedef typename PointCloudSource::Ptr                                          PointCloudSourcePtr;
+    typedef typename PointCloudSource::ConstPtr                                     PointCloudSourceConstPtr;
+
+    typedef typename pcl::Registration<PointSource, PointTarget>::PointCloudTarget  PointCloudTarget;
+    typedef typename PointCloudTarget::Ptr                                          PointCloudTargetPtr;
+    typedef typename PointCloudTarget::ConstPtr                                     PointCloudTargetConstPtr;
+
+    typedef VoxelGridCovariance<PointTarget>        TargetGrid;
+    typedef typename TargetGrid::Ptr                TargetGridPtr;
+    typedef typename TargetGrid::ConstPtr           TargetGridConstPtr;
+    typedef typename TargetGrid::LeafConstPtr       TargetGridLeafConstPtr;
+
+    typedef Eigen::Matrix<double, 6, 1>             Vector6d;
+    typedef Eigen::Matrix<double, 6, 6>             Matrix6d;
+
+public:
+    typedef boost::shared_ptr<NormalDistributionsTransform<PointSource, PointTarget> >        Ptr;
+    typedef boost::shared_ptr<const NormalDistributionsTransform<PointSource, PointTarget> >  ConstPtr;
+
+    NormalDistributionsTransform();
+
+    virtual ~NormalDistributionsTransform() {}
+
+    /*!
+     * Sets the number of threads
+     * @param[in] num_threads number of threads, 0 to use every core
+     */
+    void setNumThreads(int num_threads);
+    int getNumThreads() const { return num_threads_; }
+
+    /*!
+     * Sets how target cells are found around a source point (default KDTREE)
+     */
+    void setNeighborhoodSearchMethod(NeighborSearchMethod method) { search_method_ = method; }
+    NeighborSearchMethod getNeighborhoodSearchMethod() const { return search_method_; }
+
+    /*!
+     * Sets the target cloud and computes its cells
+     * @param[in] cloud target cloud
+     */
+    inline void setInputTarget(const PointCloudTargetConstPtr& cloud)
+    {
+        pcl::Registration<PointSource, PointTarget>::setInputTarget(cloud);
+        init();
+    }
+
+    /*!
+     * Sets the target cloud with cells computed beforehand, so that many alignments
+     * and threads can share them. The resolution becomes the leaf size of the cells.
+     * @param[in] cloud target cloud
+     * @param[in] cells filtered cells of the cloud
+     */
+    inline void setInputTarget(const PointCloudTargetConstPtr& cloud, const TargetGridConstPtr& cells)
+    {
+        pcl::Registration<PointSource, PointTarget>::setInputTarget(cloud);
+        target_cells_ = cells;
+        resolution_ = cells->getLeafSize();
+    }
+
+    /*!
+     * Cells of the target cloud
+     */
+    inline const TargetGridConstPtr& getTargetCells() const { return target_cells_; }
+
+    /*!
+     * Sets the side of the target cells
+     * @param[in] resolution cell size in meters
+     */
+    inline void setResolution(float resolution)
+    {
+        if (resolution_ != resolution)
+        {
+            resolution_ = resolution;
+            if (target_)
+            {
+                init();
+            }
+        }
+    }
+    inline float getResolution() const { return resolution_; }
+
+    /*!
+     * Sets the maximum step length of the More-Thuente line search
+     */
+    inline void setStepSize(double step_size) { step_size_ = step_size; }
+    inline double getStepSize() const { return step_size_; }
+
+    /*!
+     * Sets the ratio of outliers in the target, spelled as in pcl::NormalDistributionsTransform
+     */
+    inline void setOulierRatio(double outlier_ratio) { outlier_ratio_ = outlier_ratio; }
+    inline double getOulierRatio() const { return outlier_ratio_; }
+
+    /*!
+     * Score of the final transformation, normalized by the number of source points
+     */
+    inline double getTransformationProbability() const { return trans_probability_; }
+
+    inline int getFinalNumIteration() const { return nr_iterations_; }
+
+    /*!
+     * Converts a pose [x, y, z, roll, pitch, yaw] to a transformation
+     */
+    static void convertTransform(const Eigen::Matrix<double, 6, 1>& x, Eigen::Affine3f& trans)
+    {
+        trans = Eigen::Translation<float, 3>(float(x(0)), float(x(1)), float(x(2))) *
+                Eigen::AngleAxis<float>(float(x(3)), Eigen::Vector3f::UnitX()) *
+                Eigen::AngleAxis<float>(float(x(4)), Eigen::Vector3f::UnitY()) *
+                Eigen::AngleAxis<float>(float(x(5)), Eigen::Vector3f::UnitZ());
+    }
+
+    static void convertTransform(const Eigen::Matrix<double, 6, 1>& x, Eigen::Matrix4f& trans)
+    {
+        Eigen::Affine3f affine;
+        convertTransform(x, affine);
+        trans = affine.matrix();
+    }
+
+protected:
+    using pcl::Registration<PointSource, PointTarget>::reg_name_;
+    using pcl::Registration<PointSource, PointTarget>::input_;
+    using pcl::Registration<PointSource, PointTarget>::target_;
+    using pcl::Registration<PointSource, PointTarget>::nr_iterations_;
+    using pcl::Registration<PointSource, PointTarget>::max_iterations_;
+    using pcl::Registration<PointSource, PointTarget>::previous_transformation_;
+    using pcl::Registration<PointSource, PointTarget>::final_transformation_;
+    using pcl::Registration<PointSource, PointTarget>::transformation_;
+    using pcl::Registration<PointSource, PointTarget>::transformation_epsilon_;
+    using pcl::Registration<PointSource, PointTarget>::converged_;
+    using pcl::Registration<PointSource, PointTarget>::update_visualizer_;
+
+    /*!
+     * Derivatives of the rotation by the angles, shared by all points [Magnusson 2009, 6.19, 6.21]
+     */
+    struct AngleDerivatives
+    {
+        Eigen::Vector3d j_ang_a, j_ang_b, j_ang_c, j_ang_d, j_ang_e, j_ang_f, j_ang_g, j_ang_h;
+        Eigen::Vector3d h_ang_a2, h_ang_a3, h_ang_b2, h_ang_b3, h_ang_c2, h_ang_c3, h_ang_d1, h_ang_d2,
+                        h_ang_d3, h_ang_e1, h_ang_e2, h_ang_e3, h_ang_f1, h_ang_f2, h_ang_f3;
+    };
+
+    /*!
+     * Derivatives of one transformed point, one per thread [Magnusson 2009, 6.18, 6.20]
+     */
+    struct PointDerivatives
+    {
+        PointDerivatives()
+        {
+            point_gradient.setZero();
+            point_gradient.block<3, 3>(0, 0).setIdentity();
+            point_hessian.setZero();
+        }
+
+        Eigen::Matrix<double, 3, 6> point_gradient;
+        Eigen::Matrix<double, 18, 6> point_hessian;
+    };
+
+    virtual void computeTransformation(PointCloudSource& output)
+    {
+        computeTransformation(output, Eigen::Matrix4f::Identity());
+    }
+
+    virtual void computeTransformation(PointCloudSource& output, const Eigen::Matrix4f& guess);
+
+    /*!
+     * Computes the cells of the target cloud
+     */
+    inline void init()
+    {
+        TargetGridPtr cells(new TargetGrid);
+        cells->setLeafSize(resolution_);
+        cells->setInputCloud(target_);
+        cells->filter(true);
+        target_cells_ = cells;
+    }
+
+    /*!
+     * Target cells around the transformed point, for the selected search method
+     */
+    void getNeighborhood(const PointSource& point, std::vector<TargetGridLeafConstPtr>& neighborhood,
+                         std::vector<float>& distances) const;
+
+    double computeDerivatives(Vector6d& score_gradient, Matrix6d& hessian, const PointCloudSource& trans_cloud,
+                              const Vector6d& p, bool compute_hessian = true);
+
+    double updateDerivatives(Vector6d& score_gradient, Matrix6d& hessian, const PointDerivatives& derivatives,
+                             const Eigen::Vector3d& x_trans, const Eigen::Matrix3d& c_inv,
+                             bool compute_hessian = true) const;
+
+    void computeAngleDerivatives(const Vector6d& p, bool compute_hessian = true);
+
+    void computePointDerivatives(PointDerivatives& derivatives, const Eigen::Vector3d& x,
+                                 bool compute_hessian = true) const;
+
+    void computeHessian(Matrix6d& hessian, const PointCloudSource& trans_cloud, const Vector6d& p);
+
+    void updateHessian(Matrix6d& hessian, const PointDerivatives& derivatives, const Eigen::Vector3d& x_trans,
+                       const Eigen::Matrix3d& c_inv) const;
+
+    double computeStepLengthMT(const Vector6d& x, Vector6d& step_dir, double step_init, double step_max,
+                               double step_min, double& score, Vector6d& score_gradient, Matrix6d& hessian,
+                               PointCloudSource& trans_cloud);
+
+    bool updateIntervalMT(double& a_l, double& f_l, double& g_l, double& a_u, double& f_u, double& g_u,
+                          double a_t, double f_t, double g_t);
+
+    double trialValueSelectionMT(double a_l, double f_l, double g_l, double a_u, double f_u, double g_u,
+                                 double a_t, double f_t, double g_t);
+
+    inline double auxilaryFunction_PsiMT(double a, double f_a, double f_0, double g_0, double mu = 1.e-4)
+    {
+        return f_a - f_0 - mu * g_0 * a;
+    }
+
+    inline double auxilaryFunction_dPsiMT(double g_a, double g_0, double mu = 1.e-4)
+    {
+        return g_a - mu * g_0;
+    }
+
+    TargetGridConstPtr target_cells_;
+
+    float resolution_;
+    double step_size_;
+    double outlier_ratio_;
+    double gauss_d1_, gauss_d2_;
+    double trans_probability_;
+
+    int num_threads_;
+    NeighborSearchMethod search_method_;
+
+    AngleDerivatives angle_derivatives_;
+};
+
+}  // namespace pclomp
+
+#endif  // PCLOMP_NDT_OMP_H
@@ -0,0 +1,204 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2010-2011, Willow Garage, Inc.
+ *  Copyright (c) 2012-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Derived from pcl/filters/voxel_grid_covariance.h of PCL, by way of include/pclomp/voxel_grid_covariance_omp.h of ndt_omp
+ *  (https://github.com/koide3/ndt_omp, Kenji Koide, BSD License), which
+ *  parallelized it with OpenMP. Changed here for the neighbor searches and
+ *  the shared targets of the calibrator.
+ */
+
+#ifndef PCLOMP_VOXEL_GRID_COVARIANCE_OMP_H
+#define PCLOMP_VOXEL_GRID_COVARIANCE_OMP_H
+
+#include <vector>
+#include <unordered_map>
+#include <boost/shared_ptr.hpp>
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+namespace pclomp
+{
+
+/*!
+ * How the NDT looks up the target cells around a transformed source point.
+ * KDTREE is a radius search over the cell centroids, as pcl::NormalDistributionsTransform,
+ * DIRECT7 takes the cell of the point and its 6 face neighbors, DIRECT1 only the cell of the point.
+ */
+enum NeighborSearchMethod
+{
+    KDTREE,
+    DIRECT7,
+    DIRECT1
+};
+
+/*!
+ * Voxel grid of the normal distributions of a target cloud.
+ *
+ * Computes the same cells as pcl::VoxelGridCovariance, and adds const lookups,
+ * so that many threads can search one grid concurrently.
+ */
+template <typename PointT>
+class VoxelGridCovariance
+{
+public:
+    typedef pcl::PointCloud<PointT>             PointCloud;
+    typedef typename PointCloud::Ptr            PointCloudPtr;
+    typedef typename PointCloud::ConstPtr       PointCloudConstPtr;
+
+    typedef boost::shared_ptr<VoxelGridCovariance<PointT> >        Ptr;
+    typedef boost::shared_ptr<const VoxelGridCovariance<PointT> >  ConstPtr;
+
+    /*!
+     * Normal distribution of the points of one cell.
+     */
+    struct Leaf
+    {
+        // cov_ starts from the identity, as in pcl::VoxelGridCovariance
+        Leaf() :
+            nr_points(0),
+            mean_(Eigen::Vector3d::Zero()),
+            centroid(Eigen::Vector3f::Zero()),
+            cov_(Eigen::Matrix3d::Identity()),
+            icov_(Eigen::Matrix3d::Zero())
+        {
+        }
+
+        int getPointCount() const { return nr_points; }
+        const Eigen::Vector3d& getMean() const { return mean_; }
+        const Eigen::Matrix3d& getCov() const { return cov_; }
+        const Eigen::Matrix3d& getInverseCov() const { return icov_; }
+
+        /// number of points, -1 if the covariance is degenerate
+        int nr_points;
+        Eigen::Vector3d mean_;
+        Eigen::Vector3f centroid;
+        Eigen::Matrix3d cov_;
+        Eigen::Matrix3d icov_;
+    };
+
+    typedef const Leaf* LeafConstPtr;
+
+    VoxelGridCovariance();
+
+    /*!
+     * Sets the side of the cubic cells
+     * @param[in] leaf_size cell size in meters
+     */
+    void setLeafSize(float leaf_size);
+    float getLeafSize() const { return leaf_size_; }
+
+    /*!
+     * Sets the minimum number of points of a cell to compute its distribution (default 6)
+     */
+    void setMinPointPerVoxel(int min_points) { min_points_per_voxel_ = min_points > 3 ? min_points : 3; }
+    int getMinPointPerVoxel() const { return min_points_per_voxel_; }
+
+    /*!
+     * Sets the smallest eigenvalue of a covariance, relative to the largest (default 0.01)
+     */
+    void setCovEigValueInflationRatio(double ratio) { min_covar_eigvalue_mult_ = ratio; }
+    double getCovEigValueInflationRatio() const { return min_covar_eigvalue_mult_; }
+
+    void setInputCloud(const PointCloudConstPtr& cloud) { input_ = cloud; }
+    const PointCloudConstPtr& getInputCloud() const { return input_; }
+
+    /*!
+     * Computes the cells of the input cloud
+     * @param[in] searchable build the KD-tree of the cell centroids for radiusSearch
+     */
+    void filter(bool searchable = true);
+
+    /*!
+     * Cells whose centroid is within radius of the point, sorted by distance
+     * @return number of cells found
+     */
+    int radiusSearch(const PointT& point, double radius, std::vector<LeafConstPtr>& k_leaves,
+                     std::vector<float>& k_sqr_distances, unsigned int max_nn = 0) const;
+
+    /*!
+     * Cell containing the point, or NULL if it has too few points
+     */
+    LeafConstPtr getLeaf(const PointT& point) const;
+
+    /*!
+     * Cells containing the point (DIRECT1) or adjacent to it (DIRECT7)
+     */
+    void getNeighborhoodAtPoint1(const PointT& point, std::vector<LeafConstPtr>& neighbors) const;
+    void getNeighborhoodAtPoint7(const PointT& point, std::vector<LeafConstPtr>& neighbors) const;
+
+    /*!
+     * Cells with enough points to have a distribution, in centroid order
+     */
+    const std::vector<Leaf>& getLeaves() const { return leaves_; }
+
+    /*!
+     * Centroids of the cells, as searched by radiusSearch
+     */
+    PointCloudConstPtr getCentroids() const { return voxel_centroids_; }
+
+protected:
+    /*!
+     * Integer coordinates of the cell of the point, false if it is not within one cell of the grid
+     */
+    bool getCell(const PointT& point, Eigen::Vector3i& ijk) const;
+
+    /*!
+     * Cell with the given integer coordinates, or NULL
+     */
+    LeafConstPtr findLeaf(int i, int j, int k) const;
+
+    float leaf_size_;
+    float inverse_leaf_size_;
+    int min_points_per_voxel_;
+    double min_covar_eigvalue_mult_;
+
+    PointCloudConstPtr input_;
+
+    /// cell bounds, in cells
+    Eigen::Vector3i min_b_, div_b_;
+
+    std::vector<Leaf> leaves_;
+    /// cell index ijk to position in leaves_
+    std::unordered_map<int64_t, int> leaf_indices_;
+
+    PointCloudPtr voxel_centroids_;
+    pcl::KdTreeFLANN<PointT> kdtree_;
+};
+
+}  // namespace pclomp
+
+#endif  // PCLOMP_VOXEL_GRID_COVARIANCE_OMP_H
@@ -0,0 +1,308 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2010-2011, Willow Garage, Inc.
+ *  Copyright (c) 2012-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Derived from pcl/filters/impl/voxel_grid_covariance.hpp of PCL, by way of include/pclomp/voxel_grid_covariance_omp_impl.hpp of ndt_omp
+ *  (https://github.com/koide3/ndt_omp, Kenji Koide, BSD License), which
+ *  parallelized it with OpenMP. Changed here for the neighbor searches and
+ *  the shared targets of the calibrator.
+ */
+
+#ifndef PCLOMP_VOXEL_GRID_COVARIANCE_OMP_IMPL_HPP
+#define PCLOMP_VOXEL_GRID_COVARIANCE_OMP_IMPL_HPP
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <Eigen/Eigenvalues>
+#include <pclomp/voxel_grid_covariance_omp.h>
+
+template <typename PointT>
+pclomp::VoxelGridCovariance<PointT>::VoxelGridCovariance() :
+    leaf_size_(1.0f),
+    inverse_leaf_size_(1.0f),
+    min_points_per_voxel_(6),
+    min_covar_eigvalue_mult_(0.01),
+    min_b_(Eigen::Vector3i::Zero()),
+    div_b_(Eigen::Vector3i::Zero()),
+    voxel_centroids_(new PointCloud)
+{
+}
+
+template <typename PointT>
+void pclomp::VoxelGridCovariance<PointT>::setLeafSize(float leaf_size)
+{
+    leaf_size_ = leaf_size;
+    inverse_leaf_size_ = 1.0f / leaf_size;
+}
+
+template <typename PointT>
+void pclomp::VoxelGridCovariance<PointT>::filter(bool searchable)
+{
+    leaves_.clear();
+    leaf_indices_.clear();
+    voxel_centroids_.reset(new PointCloud);
+    if (!input_ || input_->points.empty())
+    {
+        return;
+    }
+
+    const std::vector<PointT, Eigen::aligned_allocator<PointT> >& points = input_->points;
+
+    // bounding box, as pcl::getMinMax3D
+    Eigen::Array3f min_p, max_p;
+    min_p.setConstant(FLT_MAX);
+    max_p.setConstant(-FLT_MAX);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (!input_->is_dense &&
+            (!std::isfinite(points[i].x) || !std::isfinite(points[i].y) || !std::isfinite(points[i].z)))
+        {
+            continue;
+        }
+        const Eigen::Array3f pt(points[i].x, points[i].y, points[i].z);
+        min_p = min_p.min(pt);
+        max_p = max_p.max(pt);
+    }
+    if (min_p[0] > max_p[0])
+    {
+        return;
+    }
+
+    Eigen::Vector3i max_b;
+    for (int i = 0; i < 3; i++)
+    {
+        min_b_[i] = static_cast<int>(std::floor(min_p[i] * inverse_leaf_size_));
+        max_b[i] = static_cast<int>(std::floor(max_p[i] * inverse_leaf_size_));
+    }
+    div_b_ = max_b - min_b_ + Eigen::Vector3i::Ones();
+    const int64_t divb_mul[3] = {1, div_b_[0], static_cast<int64_t>(div_b_[0]) * div_b_[1]};
+
+    // accumulate the cells in point order, keyed as in pcl::VoxelGridCovariance
+    std::unordered_map<int64_t, Leaf> cells;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (!input_->is_dense &&
+            (!std::isfinite(points[i].x) || !std::isfinite(points[i].y) || !std::isfinite(points[i].z)))
+        {
+            continue;
+        }
+        const int ijk0 = static_cast<int>(std::floor(points[i].x * inverse_leaf_size_) - static_cast<float>(min_b_[0]));
+        const int ijk1 = static_cast<int>(std::floor(points[i].y * inverse_leaf_size_) - static_cast<float>(min_b_[1]));
+        const int ijk2 = static_cast<int>(std::floor(points[i].z * inverse_leaf_size_) - static_cast<float>(min_b_[2]));
+        Leaf& leaf = cells[ijk0 * divb_mul[0] + ijk1 * divb_mul[1] + ijk2 * divb_mul[2]];
+
+        const Eigen::Vector3d pt3d(points[i].x, points[i].y, points[i].z);
+        leaf.mean_ += pt3d;
+        leaf.cov_ += pt3d * pt3d.transpose();
+        leaf.centroid += Eigen::Vector3f(points[i].x, points[i].y, points[i].z);
+        ++leaf.nr_points;
+    }
+
+    std::vector<int64_t> keys;
+    keys.reserve(cells.size());
+    for (typename std::unordered_map<int64_t, Leaf>::const_iterator it = cells.begin(); it != cells.end(); ++it)
+    {
+        keys.push_back(it->first);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    leaves_.reserve(keys.size());
+    voxel_centroids_->points.reserve(keys.size());
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eigensolver;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        Leaf& leaf = cells[keys[i]];
+        leaf.centroid /= static_cast<float>(leaf.nr_points);
+        const Eigen::Vector3d pt_sum = leaf.mean_;
+        leaf.mean_ /= leaf.nr_points;
+        if (leaf.nr_points < min_points_per_voxel_)
+        {
+            continue;
+        }
+
+        PointT centroid;
+        centroid.x = leaf.centroid[0];
+        centroid.y = leaf.centroid[1];
+        centroid.z = leaf.centroid[2];
+        voxel_centroids_->points.push_back(centroid);
+
+        // single pass covariance, inflating the smallest eigenvalues
+        leaf.cov_ = (leaf.cov_ - 2 * (pt_sum * leaf.mean_.transpose())) / leaf.nr_points +
+                    leaf.mean_ * leaf.mean_.transpose();
+        leaf.cov_ *= (leaf.nr_points - 1.0) / leaf.nr_points;
+        eigensolver.compute(leaf.cov_);
+        Eigen::Matrix3d eigen_val = eigensolver.eigenvalues().asDiagonal();
+        const Eigen::Matrix3d evecs = eigensolver.eigenvectors();
+
+        if (eigen_val(0, 0) < 0 || eigen_val(1, 1) < 0 || eigen_val(2, 2) <= 0)
+        {
+            leaf.nr_points = -1;
+        }
+        else
+        {
+            const double min_covar_eigvalue = min_covar_eigvalue_mult_ * eigen_val(2, 2);
+            if (eigen_val(0, 0) < min_covar_eigvalue)
+            {
+                eigen_val(0, 0) = min_covar_eigvalue;
+                if (eigen_val(1, 1) < min_covar_eigvalue)
+                {
+                    eigen_val(1, 1) = min_covar_eigvalue;
+                }
+                leaf.cov_ = evecs * eigen_val * evecs.inverse();
+            }
+            leaf.icov_ = leaf.cov_.inverse();
+            if (leaf.icov_.maxCoeff() == std::numeric_limits<float>::infinity() ||
+                leaf.icov_.minCoeff() == -std::numeric_limits<float>::infinity())
+            {
+                leaf.nr_points = -1;
+            }
+        }
+
+        // degenerate cells stay searchable by radius, as in pcl::VoxelGridCovariance
+        leaf_indices_[keys[i]] = static_cast<int>(leaves_.size());
+        leaves_.push_back(leaf);
+    }
+
+    voxel_centroids_->width = static_cast<uint32_t>(voxel_centroids_->points.size());
+    voxel_centroids_->height = 1;
+    voxel_centroids_->is_dense = true;
+    if (searchable && !voxel_centroids_->points.empty())
+    {
+        kdtree_.setInputCloud(voxel_centroids_);
+    }
+}
+
+template <typename PointT>
+int pclomp::VoxelGridCovariance<PointT>::radiusSearch(const PointT& point, double radius,
+                                                      std::vector<LeafConstPtr>& k_leaves,
+                                                      std::vector<float>& k_sqr_distances,
+                                                      unsigned int max_nn) const
+{
+    k_leaves.clear();
+    if (voxel_centroids_->points.empty())
+    {
+        k_sqr_distances.clear();
+        return 0;
+    }
+
+    std::vector<int> k_indices;
+    const int k = kdtree_.radiusSearch(point, radius, k_indices, k_sqr_distances, max_nn);
+    k_leaves.reserve(k);
+    for (size_t i = 0; i < k_indices.size(); i++)
+    {
+        k_leaves.push_back(&leaves_[k_indices[i]]);
+    }
+    return k;
+}
+
+template <typename PointT>
+typename pclomp::VoxelGridCovariance<PointT>::LeafConstPtr
+pclomp::VoxelGridCovariance<PointT>::findLeaf(int i, int j, int k) const
+{
+    if (i < 0 || j < 0 || k < 0 || i >= div_b_[0] || j >= div_b_[1] || k >= div_b_[2])
+    {
+        return NULL;
+    }
+    const int64_t index = i + static_cast<int64_t>(j) * div_b_[0] + static_cast<int64_t>(k) * div_b_[0] * div_b_[1];
+    typename std::unordered_map<int64_t, int>::const_iterator it = leaf_indices_.find(index);
+    if (it == leaf_indices_.end() || leaves_[it->second].nr_points < min_points_per_voxel_)
+    {
+        return NULL;
+    }
+    return &leaves_[it->second];
+}
+
+template <typename PointT>
+bool pclomp::VoxelGridCovariance<PointT>::getCell(const PointT& point, Eigen::Vector3i& ijk) const
+{
+    const float coordinates[3] = {point.x, point.y, point.z};
+    for (int i = 0; i < 3; i++)
+    {
+        const float cell = std::floor(coordinates[i] * inverse_leaf_size_) - static_cast<float>(min_b_[i]);
+        // also rejects NaN, and keeps the cast in range
+        if (!(cell >= -1.0f && cell <= static_cast<float>(div_b_[i])))
+        {
+            return false;
+        }
+        ijk[i] = static_cast<int>(cell);
+    }
+    return true;
+}
+
+template <typename PointT>
+typename pclomp::VoxelGridCovariance<PointT>::LeafConstPtr
+pclomp::VoxelGridCovariance<PointT>::getLeaf(const PointT& point) const
+{
+    Eigen::Vector3i ijk;
+    return getCell(point, ijk) ? findLeaf(ijk[0], ijk[1], ijk[2]) : NULL;
+}
+
+template <typename PointT>
+void pclomp::VoxelGridCovariance<PointT>::getNeighborhoodAtPoint1(const PointT& point,
+                                                                  std::vector<LeafConstPtr>& neighbors) const
+{
+    neighbors.clear();
+    LeafConstPtr leaf = getLeaf(point);
+    if (leaf)
+    {
+        neighbors.push_back(leaf);
+    }
+}
+
+template <typename PointT>
+void pclomp::VoxelGridCovariance<PointT>::getNeighborhoodAtPoint7(const PointT& point,
+                                                                  std::vector<LeafConstPtr>& neighbors) const
+{
+    static const int OFFSETS[7][3] = {{0, 0, 0}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+    neighbors.clear();
+    Eigen::Vector3i ijk;
+    if (!getCell(point, ijk))
+    {
+        return;
+    }
+    for (int n = 0; n < 7; n++)
+    {
+        LeafConstPtr leaf = findLeaf(ijk[0] + OFFSETS[n][0], ijk[1] + OFFSETS[n][1], ijk[2] + OFFSETS[n][2]);
+        if (leaf)
+        {
+            neighbors.push_back(leaf);
+        }
+    }
+}
+
+#endif  // PCLOMP_VOXEL_GRID_COVARIANCE_OMP_IMPL_HPP
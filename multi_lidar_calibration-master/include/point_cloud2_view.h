@@ -0,0 +1,127 @@
+#ifndef PROJECT_POINT_CLOUD2_VIEW_H
+#define PROJECT_POINT_CLOUD2_VIEW_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_set>
+#include <Eigen/Dense>
+#include <sensor_msgs/PointCloud2.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+/*!
+ * Reads x, y, z straight from the buffer of a PointCloud2, without converting the message.
+ * Only FLOAT32 coordinates are viewed, IsValid is false for any other layout.
+ */
+class PointCloud2XYZView
+{
+public:
+	explicit PointCloud2XYZView(const sensor_msgs::PointCloud2& in_msg) :
+		msg_(in_msg), valid_(false), x_offset_(0), y_offset_(0), z_offset_(0)
+	{
+		bool has_x = false, has_y = false, has_z = false;
+		for (size_t i = 0; i < in_msg.fields.size(); ++i)
+		{
+			const sensor_msgs::PointField& field = in_msg.fields[i];
+			if (field.datatype != sensor_msgs::PointField::FLOAT32)
+			{
+				continue;
+			}
+			if (field.name == "x")
+			{
+				x_offset_ = field.offset;
+				has_x = true;
+			}
+			else if (field.name == "y")
+			{
+				y_offset_ = field.offset;
+				has_y = true;
+			}
+			else if (field.name == "z")
+			{
+				z_offset_ = field.offset;
+				has_z = true;
+			}
+		}
+		const uint32_t last_offset = std::max(x_offset_, std::max(y_offset_, z_offset_));
+		valid_ = has_x && has_y && has_z
+		         && last_offset + sizeof(float) <= in_msg.point_step
+		         && in_msg.data.size() >= (size_t)in_msg.row_step * in_msg.height
+		         && in_msg.row_step >= (size_t)in_msg.point_step * in_msg.width;
+	}
+
+	bool IsValid() const { return valid_; }
+
+	size_t Size() const { return (size_t)msg_.width * msg_.height; }
+
+	/*!
+	 * Calls in_function(x, y, z) for every in_stride-th point that is finite, in the order of the message
+	 */
+	template <typename FunctionT>
+	void ForEachPoint(FunctionT in_function, size_t in_stride = 1) const
+	{
+		const size_t size = Size();
+		for (size_t i = 0; i < size; i += in_stride)
+		{
+			const uint8_t* point = msg_.data.data() + (i / msg_.width) * msg_.row_step
+			                       + (i % msg_.width) * msg_.point_step;
+			// the fields are not aligned in general
+			float x, y, z;
+			std::memcpy(&x, point + x_offset_, sizeof(float));
+			std::memcpy(&y, point + y_offset_, sizeof(float));
+			std::memcpy(&z, point + z_offset_, sizeof(float));
+			if (std::isfinite(x) && std::isfinite(y) && std::isfinite(z))
+			{
+				in_function(x, y, z);
+			}
+		}
+	}
+
+private:
+	const sensor_msgs::PointCloud2&     msg_;
+	bool                                valid_;
+	uint32_t                            x_offset_;
+	uint32_t                            y_offset_;
+	uint32_t                            z_offset_;
+};
+
+/*!
+ * Converts the finite points of a message
+ * @param in_msg cloud message
+ * @param out_cloud its finite points
+ */
+void ConvertCloud(const sensor_msgs::PointCloud2& in_msg, pcl::PointCloud<pcl::PointXYZ>& out_cloud);
+
+/*!
+ * Applies a Voxel Grid filter to a message, converting only the centroids of the voxels
+ * @param in_msg cloud message to downsample
+ * @param out_cloud_ptr downsampled point cloud
+ * @param in_leaf_size voxel side size
+ */
+void DownsampleCloud(const sensor_msgs::PointCloud2& in_msg, pcl::PointCloud<pcl::PointXYZ>::Ptr out_cloud_ptr,
+                     double in_leaf_size);
+
+/*!
+ * Keys of the voxels occupied by the points of a message
+ * @param in_msg cloud message
+ * @param in_voxel_size voxel side size
+ * @param out_voxels keys of the occupied voxels
+ */
+void OccupiedVoxels(const sensor_msgs::PointCloud2& in_msg, double in_voxel_size,
+                    std::unordered_set<int64_t>& out_voxels);
+
+/*!
+ * Fraction of sampled points of a message that land, once transformed, in or next to an occupied voxel
+ * @param in_msg cloud message
+ * @param in_transform transformation of the points
+ * @param in_voxels keys of the occupied voxels, from OccupiedVoxels
+ * @param in_voxel_size voxel side size of in_voxels
+ * @param in_max_samples points sampled evenly from the message
+ * @return fraction of the finite sampled points, 0 without any
+ */
+double VoxelOverlap(const sensor_msgs::PointCloud2& in_msg, const Eigen::Matrix4f& in_transform,
+                    const std::unordered_set<int64_t>& in_voxels, double in_voxel_size, size_t in_max_samples);
+
+#endif //PROJECT_POINT_CLOUD2_VIEW_H
@@ -0,0 +1,153 @@
+#ifndef PROJECT_REGISTRATION_BACKEND_H
+#define PROJECT_REGISTRATION_BACKEND_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pclomp/voxel_grid_covariance_omp.h>
+
+/*!
+ * One level of the coarse to fine registration pyramid
+ */
+struct RegistrationLevel
+{
+	double                              voxel_size;     // of the child cloud
+	double                              resolution;     // NDT cell size, ICP maximum correspondence distance
+	int                                 iterations;
+	double                              epsilon;        // NDT step length, ICP transformation change
+};
+
+/*!
+ * Result of the alignment of one pair, at one level or through every level
+ */
+struct AlignmentResult
+{
+	Eigen::Matrix4f                     transformation;
+	bool                                converged;      // of the finest level
+	int                                 iterations;     // of every level
+	double                              fitness;
+	double                              probability;    // NDT only
+	std::string                         levels;         // iterations and time per level
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/*!
+ * Registration method used by the calibrator, NDT, GICP or point to plane ICP.
+ *
+ * The target is prepared once per parent cloud and only read by the alignments,
+ * so one backend and one target can be used by many threads at once.
+ */
+class RegistrationBackend
+{
+public:
+	typedef pcl::PointXYZ               PointT;
+	typedef pcl::PointCloud<PointT>     PointCloudT;
+
+	typedef std::shared_ptr<const RegistrationBackend>  ConstPtr;
+
+	/*!
+	 * Everything the backend derives from a target cloud, specialized by each backend
+	 */
+	struct Target
+	{
+		virtual ~Target() {}
+
+		PointCloudT::ConstPtr           cloud;
+	};
+	typedef std::shared_ptr<const Target>               TargetConstPtr;
+
+	virtual ~RegistrationBackend() {}
+
+	/*!
+	 * Name of the method, as given to Create
+	 */
+	virtual std::string Name() const = 0;
+
+	/*!
+	 * Prepares a target cloud for the alignments at the given levels
+	 * @param in_cloud target cloud
+	 * @param in_levels levels the target will be aligned at
+	 * @return target shared by the alignments
+	 */
+	virtual TargetConstPtr PrepareTarget(PointCloudT::ConstPtr in_cloud,
+	                                     const std::vector<RegistrationLevel>& in_levels) const = 0;
+
+	/*!
+	 * Aligns a source cloud to the target at one level
+	 * @param in_target target prepared by this backend
+	 * @param in_level index of the level in the levels of PrepareTarget
+	 * @param in_settings settings of the level
+	 * @param in_source source cloud, downsampled for the level
+	 * @param in_guess initial guess
+	 * @param in_compute_fitness computes the fitness score of the result
+	 * @param out_result result of the level
+	 */
+	virtual void Align(const Target& in_target, size_t in_level, const RegistrationLevel& in_settings,
+	                   PointCloudT::ConstPtr in_source, const Eigen::Matrix4f& in_guess,
+	                   bool in_compute_fitness, AlignmentResult& out_result) const = 0;
+
+	/*!
+	 * Aligns a source cloud through every level, each starting from the result of the previous one.
+	 * The fitness score is the one of the finest level.
+	 * @param in_target target prepared by this backend for in_levels
+	 * @param in_levels levels, coarse to fine
+	 * @param in_source source cloud, downsampled at each level
+	 * @param in_guess initial guess of the coarsest level
+	 * @param out_result transformation of the finest level, and the report of every level
+	 */
+	void AlignPyramid(const Target& in_target, const std::vector<RegistrationLevel>& in_levels,
+	                  PointCloudT::ConstPtr in_source, const Eigen::Matrix4f& in_guess,
+	                  AlignmentResult& out_result) const;
+
+	/*!
+	 * Names of the available methods
+	 */
+	static std::vector<std::string> Methods();
+
+	/*!
+	 * Creates a backend
+	 * @param in_method NDT, GICP or POINT_TO_PLANE
+	 * @param in_num_threads threads of the NDT and of the normal estimation, 0 for every core
+	 * @param in_search_method neighbor search of the NDT
+	 * @param in_ndt_step_size maximum step length of the NDT
+	 * @return the backend, or null for an unknown method
+	 */
+	static ConstPtr Create(const std::string& in_method, int in_num_threads,
+	                       pclomp::NeighborSearchMethod in_search_method, double in_ndt_step_size);
+};
+
+/*!
+ * Pyramid of multi_lidar_calibrator.launch, its pyramid_ lists then voxel_size and the ndt_ parameters
+ */
+std::vector<RegistrationLevel> DefaultRegistrationLevels();
+
+/*!
+ * Applies a Voxel Grid filter to the point cloud
+ * @param in_cloud_ptr point cloud to downsample
+ * @param out_cloud_ptr downsampled point cloud
+ * @param in_leaf_size voxel side size
+ */
+void DownsampleCloud(RegistrationBackend::PointCloudT::ConstPtr in_cloud_ptr,
+                     RegistrationBackend::PointCloudT::Ptr out_cloud_ptr, double in_leaf_size);
+
+/*!
+ * Transformation from x, y, z, yaw, pitch, roll, as in child_topic_list
+ */
+Eigen::Matrix4f XyzyprToMatrix(const std::vector<double>& in_xyzypr);
+
+/*!
+ * x, y, z, yaw, pitch, roll of a transformation, inverse of XyzyprToMatrix
+ */
+std::vector<double> MatrixToXyzypr(const Eigen::Matrix4f& in_transform);
+
+/*!
+ * Translation and rotation angle between two transformations
+ */
+void TransformDelta(const Eigen::Matrix4f& in_a, const Eigen::Matrix4f& in_b,
+                    double& out_translation, double& out_rotation);
+
+#endif //PROJECT_REGISTRATION_BACKEND_H
@@ -0,0 +1,131 @@
+#include "calibration_aggregation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "registration_backend.h"
+
+std::vector<FramePair> PairFrames(size_t in_child, const std::vector<double>& in_parent_stamps,
+                                  const std::vector<double>& in_child_stamps, double in_max_time_diff,
+                                  size_t in_max_pairs)
+{
+	std::vector<FramePair> pairs;
+	for (size_t i = 0; i < in_child_stamps.size(); ++i)
+	{
+		const double stamp = in_child_stamps[i];
+		const std::vector<double>::const_iterator after =
+				std::lower_bound(in_parent_stamps.begin(), in_parent_stamps.end(), stamp);
+
+		std::vector<double>::const_iterator nearest = in_parent_stamps.end();
+		if (after != in_parent_stamps.end())
+		{
+			nearest = after;
+		}
+		if (after != in_parent_stamps.begin()
+		    && (nearest == in_parent_stamps.end() || stamp - *(after - 1) < *after - stamp))
+		{
+			nearest = after - 1;
+		}
+		if (nearest == in_parent_stamps.end() || std::abs(*nearest - stamp) > in_max_time_diff)
+		{
+			continue;
+		}
+
+		FramePair pair;
+		pair.child = in_child;
+		pair.parent_frame = nearest - in_parent_stamps.begin();
+		pair.child_frame = i;
+		pairs.push_back(pair);
+	}
+
+	if (pairs.size() <= in_max_pairs)
+	{
+		return pairs;
+	}
+	std::vector<FramePair> spread;
+	for (size_t k = 0; k < in_max_pairs; ++k)
+	{
+		spread.push_back(pairs[k * pairs.size() / in_max_pairs]);
+	}
+	return spread;
+}
+
+size_t AggregateTransforms(const TransformVector& in_transforms, double in_inlier_translation,
+                           double in_inlier_rotation, Eigen::Matrix4f& out_transform,
+                           double& out_translation_spread, double& out_rotation_spread)
+{
+	out_translation_spread = 0.0;
+	out_rotation_spread = 0.0;
+	if (in_transforms.empty())
+	{
+		return 0;
+	}
+
+	// median of each translation component, with the rotation of the transformation nearest to it
+	Eigen::Vector3f median_translation;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		std::vector<float> values;
+		for (size_t i = 0; i < in_transforms.size(); ++i)
+		{
+			values.push_back(in_transforms[i](axis, 3));
+		}
+		std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+		median_translation[axis] = values[values.size() / 2];
+	}
+	size_t nearest = 0;
+	for (size_t i = 1; i < in_transforms.size(); ++i)
+	{
+		if ((in_transforms[i].block<3, 1>(0, 3) - median_translation).norm()
+		    < (in_transforms[nearest].block<3, 1>(0, 3) - median_translation).norm())
+		{
+			nearest = i;
+		}
+	}
+	Eigen::Matrix4f median = in_transforms[nearest];
+	median.block<3, 1>(0, 3) = median_translation;
+
+	const Eigen::Quaternionf median_rotation(Eigen::Matrix3f(median.block<3, 3>(0, 0)));
+	Eigen::Vector3f translation_sum = Eigen::Vector3f::Zero();
+	Eigen::Vector4f rotation_sum = Eigen::Vector4f::Zero();
+	TransformVector inliers;
+	for (size_t i = 0; i < in_transforms.size(); ++i)
+	{
+		double translation, rotation;
+		TransformDelta(median, in_transforms[i], translation, rotation);
+		if (translation > in_inlier_translation || rotation > in_inlier_rotation)
+		{
+			continue;
+		}
+		// q and -q are the same rotation, the sum needs them on the side of the median
+		Eigen::Quaternionf quaternion(Eigen::Matrix3f(in_transforms[i].block<3, 3>(0, 0)));
+		if (quaternion.dot(median_rotation) < 0)
+		{
+			quaternion.coeffs() = -quaternion.coeffs();
+		}
+		translation_sum += in_transforms[i].block<3, 1>(0, 3);
+		rotation_sum += quaternion.coeffs();
+		inliers.push_back(in_transforms[i]);
+	}
+
+	if (inliers.empty())
+	{
+		return 0;
+	}
+
+	// the normalized sum of close quaternions approximates their mean rotation
+	Eigen::Quaternionf mean_rotation;
+	mean_rotation.coeffs() = rotation_sum.normalized();
+	out_transform = Eigen::Matrix4f::Identity();
+	out_transform.block<3, 3>(0, 0) = mean_rotation.toRotationMatrix();
+	out_transform.block<3, 1>(0, 3) = translation_sum / static_cast<float>(inliers.size());
+
+	for (size_t i = 0; i < inliers.size(); ++i)
+	{
+		double translation, rotation;
+		TransformDelta(out_transform, inliers[i], translation, rotation);
+		out_translation_spread = std::max(out_translation_spread, translation);
+		out_rotation_spread = std::max(out_rotation_spread, rotation);
+	}
+	return inliers.size();
+}
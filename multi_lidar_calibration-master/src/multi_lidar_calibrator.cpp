@@ -1,15 +1,22 @@
 #include "multi_lidar_calibrator.h"
 
-void ROSMultiLidarCalibratorApp::PublishCloud(const ros::Publisher& in_publisher, pcl::PointCloud<PointT>::ConstPtr in_cloud_to_publish_ptr)
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+void ROSMultiLidarCalibratorApp::PublishCloud(const ros::Publisher& in_publisher, pcl::PointCloud<PointT>::ConstPtr in_cloud_to_publish_ptr,
+                                              const std::string& in_frame)
 {
 	sensor_msgs::PointCloud2 cloud_msg;
 	pcl::toROSMsg(*in_cloud_to_publish_ptr, cloud_msg);
-	cloud_msg.header.frame_id = parent_frame_;
+	cloud_msg.header.frame_id = in_frame;
 	in_publisher.publish(cloud_msg);
 }
 
 
-void ROSMultiLidarCalibratorApp::MatrixToTranform(Eigen::Matrix4f & matrix, tf::Transform & trans){
+void ROSMultiLidarCalibratorApp::MatrixToTranform(const Eigen::Matrix4f & matrix, tf::Transform & trans){
     tf::Vector3 origin;
     origin.setValue(static_cast<double>(matrix(0,3)),static_cast<double>(matrix(1,3)),static_cast<double>(matrix(2,3)));
 
@@ -25,101 +32,448 @@ void ROSMultiLidarCalibratorApp::MatrixToTranform(Eigen::Matrix4f & matrix, tf::
     trans.setRotation(tfqt);
 }
 
-void ROSMultiLidarCalibratorApp::PerformNdtOptimize(){
+bool ROSMultiLidarCalibratorApp::UpdateConvergence(ChildCalibration& in_child, const Eigen::Matrix4f& in_transform,
+                                                   double in_fitness)
+{
+    in_child.recent_transforms.push_back(in_transform);
+    in_child.recent_fitness.push_back(in_fitness);
+    while (static_cast<int>(in_child.recent_transforms.size()) > convergence_window_)
+    {
+        in_child.recent_transforms.pop_front();
+        in_child.recent_fitness.pop_front();
+    }
+    if (static_cast<int>(in_child.recent_transforms.size()) < convergence_window_)
+    {
+        return false;
+    }
 
-    if (in_parent_cloud_== nullptr || in_child_cloud_== nullptr){
-        return;
+    // every alignment in the window agrees with the last one
+    double min_fitness = in_fitness, max_fitness = in_fitness;
+    for (size_t i = 0; i < in_child.recent_transforms.size(); ++i)
+    {
+        double translation, rotation;
+        TransformDelta(in_child.recent_transforms[i], in_transform, translation, rotation);
+        if (translation > convergence_translation_ || rotation > convergence_rotation_)
+        {
+            return false;
+        }
+        min_fitness = std::min(min_fitness, in_child.recent_fitness[i]);
+        max_fitness = std::max(max_fitness, in_child.recent_fitness[i]);
     }
+    return max_fitness - min_fitness <= convergence_fitness_ * max_fitness;
+}
 
-    // Initializing Normal Distributions Transform (NDT).
-    pcl::NormalDistributionsTransform<PointT, PointT> ndt;
+void ROSMultiLidarCalibratorApp::PublishResult(const ChildCalibration& in_child)
+{
+    tf::Transform t_transform;
+    MatrixToTranform(in_child.current_guess, t_transform);
+
+    geometry_msgs::TransformStamped result_msg;
+    tf::transformStampedTFToMsg(tf::StampedTransform(t_transform, in_child.last_alignment_time,
+                                                     in_child.parent_frame, in_child.child_frame),
+                                result_msg);
+    in_child.result_publisher.publish(result_msg);
+
+    Eigen::Matrix3f rotation_matrix = in_child.current_guess.block(0,0,3,3);
+    Eigen::Vector3f translation_vector = in_child.current_guess.block(0,3,3,1);
+
+    std::ostringstream replicate;
+    replicate << "rosrun tf static_transform_publisher " << translation_vector.transpose()
+              << " " << rotation_matrix.eulerAngles(2,1,0).transpose() << " /" << in_child.parent_frame
+              << " /" << in_child.child_frame << " 10";
+    ROS_INFO("[%s] Calibration of %s to %s converged after %d alignments. It can be replicated using:\n%s",
+             __APP_NAME__, in_child.child_frame.c_str(), in_child.parent_frame.c_str(), in_child.alignment_count,
+             replicate.str().c_str());
+}
 
-    ndt.setTransformationEpsilon(ndt_epsilon_);
-    ndt.setStepSize(ndt_step_size_);
-    ndt.setResolution(ndt_resolution_);
+void ROSMultiLidarCalibratorApp::BroadcastTransform(const ros::TimerEvent& in_event)
+{
+    const ros::Time now = ros::Time::now();
+    for (size_t i = 0; i < children_.size(); ++i)
+    {
+        ChildCalibration& child = *children_[i];
+        bool unsubscribe;
+        {
+            std::lock_guard<std::mutex> lock(child.mutex);
+            unsubscribe = child.unsubscribe_pending;
+            child.unsubscribe_pending = false;
+            if (child.calibrated)
+            {
+                tf::Transform t_transform;
+                MatrixToTranform(child.current_guess,t_transform);
+                tf_br.sendTransform(tf::StampedTransform(t_transform, now, child.parent_frame, child.child_frame));
+            }
+        }
 
-    ndt.setMaximumIterations(ndt_iterations_);
+        if (unsubscribe)
+        {
+            child.subscriber->unsubscribe();
+            if (++unsubscribed_children_ == children_.size())
+            {
+                ROS_INFO("[%s] Every child is done, unsubscribing from %s.", __APP_NAME__,
+                         points_parent_topic_str.c_str());
+                cloud_parent_subscriber_->unsubscribe();
+            }
+        }
+    }
 
-    ndt.setInputSource(in_child_filtered_cloud_);
-    ndt.setInputTarget(in_parent_cloud_);
+    // published at the period of the updater, not at every call
+    diagnostics_.update();
+}
 
-    pcl::PointCloud<PointT>::Ptr output_cloud(new pcl::PointCloud<PointT>);
+void ROSMultiLidarCalibratorApp::PerformNdtOptimize(ChildCalibration& in_child,
+                                                    const RegistrationBackend::Target& in_parent_target,
+                                                    pcl::PointCloud<PointT>::ConstPtr in_child_cloud){
 
+    Eigen::Matrix4f current_guess;
+    {
+        std::lock_guard<std::mutex> lock(in_child.mutex);
+        current_guess = in_child.current_guess;
+    }
+
+    AlignmentResult result;
+    backend_->AlignPyramid(in_parent_target, levels_, in_child_cloud, current_guess, result);
+
+    const Eigen::Matrix4f& final_transformation = result.transformation;
+    const double fitness = result.fitness;
+
+    double translation_delta, rotation_delta;
+    TransformDelta(current_guess, final_transformation, translation_delta, rotation_delta);
+
+    std::unique_lock<std::mutex> lock(in_child.mutex);
 
+    in_child.last_alignment_time = ros::Time::now();
+    in_child.alignment_count++;
 
-    if(current_guess_ == Eigen::Matrix4f::Identity())
+    in_child.current_guess = final_transformation;
+    in_child.calibrated = true;
+    in_child.last_result = result;
+    in_child.translation_delta = translation_delta;
+    in_child.rotation_delta = rotation_delta;
+
+    if (UpdateConvergence(in_child, final_transformation, fitness))
     {
-        Eigen::Translation3f init_translation(transfer_map_[points_child_topic_str][0],
-                transfer_map_[points_child_topic_str][1], transfer_map_[points_child_topic_str][2]);
-        Eigen::AngleAxisf init_rotation_x(transfer_map_[points_child_topic_str][5], Eigen::Vector3f::UnitX());
-        Eigen::AngleAxisf init_rotation_y(transfer_map_[points_child_topic_str][4], Eigen::Vector3f::UnitY());
-        Eigen::AngleAxisf init_rotation_z(transfer_map_[points_child_topic_str][3], Eigen::Vector3f::UnitZ());
+        // from now on only CheckDrift runs, at the converged transformation
+        in_child.converged = true;
+        in_child.drifted = false;
+        in_child.last_check_time = in_child.last_alignment_time;
+        in_child.consistency = 0.0;
+        in_child.consistency_baseline = 0.0;
+        in_child.baseline_checks = 0;
+        in_child.degraded_checks = 0;
+        PublishResult(in_child);
+        if (monitor_interval_ <= 0)
+        {
+            ROS_INFO("[%s] Calibration of %s done, no longer aligning it.", __APP_NAME__,
+                     in_child.child_frame.c_str());
+            // PointsCallback drops the pairs until the tf timer unsubscribes
+            in_child.unsubscribe_pending = true;
+        }
+    }
 
-        Eigen::Matrix4f init_guess_ = (init_translation * init_rotation_z * init_rotation_y * init_rotation_x).matrix();
+    ROS_DEBUG("[%s] Alignment %d of %s: fitness %f, translation_delta %f, rotation_delta %f, levels [%s]",
+              __APP_NAME__, in_child.alignment_count, in_child.child_frame.c_str(), fitness, translation_delta,
+              rotation_delta, result.levels.c_str());
+    lock.unlock();
 
-        current_guess_ = init_guess_;
+    if (calibrated_cloud_publisher_.getNumSubscribers() == 0)
+    {
+        return;
     }
 
-    ndt.align(*output_cloud, current_guess_);
+    // Transforming the downsampled input cloud using found transform.
+    pcl::PointCloud<PointT>::Ptr output_cloud(new pcl::PointCloud<PointT>);
+    pcl::transformPointCloud (*in_child_cloud, *output_cloud, final_transformation);
 
-    std::cout << "Normal Distributions Transform converged:" << ndt.hasConverged ()
-              << " score: " << ndt.getFitnessScore () << " prob:" << ndt.getTransformationProbability() << std::endl;
-    std::cout << "transformation from " << child_frame_ << " to " << parent_frame_ << std::endl;
+    PublishCloud(calibrated_cloud_publisher_, output_cloud, in_child.parent_frame);
+}
 
-    // Transforming unfiltered, input cloud using found transform.
-    pcl::transformPointCloud (*in_child_cloud_, *output_cloud, ndt.getFinalTransformation());
+RegistrationBackend::TargetConstPtr
+ROSMultiLidarCalibratorApp::GetParentTarget(const sensor_msgs::PointCloud2::ConstPtr& in_parent_cloud_msg)
+{
+    std::lock_guard<std::mutex> lock(parent_mutex_);
+    if (in_parent_cloud_msg == parent_msg_)
+    {
+        return parent_target_;
+    }
 
-    current_guess_ = ndt.getFinalTransformation();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-    Eigen::Matrix3f rotation_matrix = current_guess_.block(0,0,3,3);
-    Eigen::Vector3f translation_vector = current_guess_.block(0,3,3,1);
+    // the target is built from every finite point, the NDT cells need them
+    pcl::PointCloud<PointT>::Ptr parent_cloud (new pcl::PointCloud<PointT>);
+    ConvertCloud(*in_parent_cloud_msg, *parent_cloud);
 
+    parent_msg_ = in_parent_cloud_msg;
+    parent_target_ = backend_->PrepareTarget(parent_cloud, levels_);
 
-    std::cout << "This transformation can be replicated using:" << std::endl;
-    std::cout << "rosrun tf static_transform_publisher " << translation_vector.transpose()
-              << " " << rotation_matrix.eulerAngles(2,1,0).transpose() << " /" << parent_frame_
-              << " /" << child_frame_ << " 10" << std::endl;
+    ROS_DEBUG("[%s] Built the %s target of %zu parent points in %.1f ms", __APP_NAME__, backend_->Name().c_str(),
+              parent_cloud->size(),
+              std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return parent_target_;
+}
 
-    std::cout << "Corresponding transformation matrix:" << std::endl
-              << std::endl << current_guess_ << std::endl << std::endl;
+void ROSMultiLidarCalibratorApp::CalibrateChild(ChildCalibration* in_child)
+{
+    while (true)
+    {
+        sensor_msgs::PointCloud2::ConstPtr parent_msg, child_msg;
+        bool converged;
+        {
+            std::unique_lock<std::mutex> lock(in_child->mutex);
+            in_child->fresh_pair.wait(lock, [&] { return shutting_down_ || in_child->child_msg; });
+            if (shutting_down_)
+            {
+                return;
+            }
+            parent_msg.swap(in_child->parent_msg);
+            child_msg.swap(in_child->child_msg);
+            in_child->parent_frame = parent_msg->header.frame_id;
+            in_child->child_frame = child_msg->header.frame_id;
+            converged = in_child->converged;
+        }
 
+        if (converged)
+        {
+            CheckDrift(*in_child, *parent_msg, *child_msg);
+            continue;
+        }
 
-    PublishCloud(calibrated_cloud_publisher_, output_cloud);
+        if (keyframe_count_ <= 1)
+        {
+            // the child is only aligned at voxel_size_ and coarser, its full cloud is never needed
+            pcl::PointCloud<PointT>::Ptr child_cloud (new pcl::PointCloud<PointT>);
+            DownsampleCloud(*child_msg, child_cloud, voxel_size_);
 
-    tf::Transform t_transform;
-    MatrixToTranform(current_guess_,t_transform);
-    tf_br.sendTransform(tf::StampedTransform(t_transform, ros::Time::now(), parent_frame_, child_frame_));
+            const RegistrationBackend::TargetConstPtr parent_target = GetParentTarget(parent_msg);
+            PerformNdtOptimize(*in_child, *parent_target, child_cloud);
+            continue;
+        }
+
+        // the submaps are aligned once per keyframe, the other pairs are dropped
+        if (!AddKeyframe(*in_child, *parent_msg, *child_msg))
+        {
+            continue;
+        }
+
+        Eigen::Matrix4f current_guess;
+        {
+            std::lock_guard<std::mutex> lock(in_child->mutex);
+            current_guess = in_child->current_guess;
+        }
+        pcl::PointCloud<PointT>::Ptr parent_submap (new pcl::PointCloud<PointT>);
+        pcl::PointCloud<PointT>::Ptr child_submap (new pcl::PointCloud<PointT>);
+        BuildSubmaps(*in_child, current_guess, parent_submap, child_submap);
+
+        const RegistrationBackend::TargetConstPtr submap_target = backend_->PrepareTarget(parent_submap, levels_);
+        PerformNdtOptimize(*in_child, *submap_target, child_submap);
+    }
 }
 
-void ROSMultiLidarCalibratorApp::PointsCallback(const sensor_msgs::PointCloud2::ConstPtr &in_parent_cloud_msg,
-                                                  const sensor_msgs::PointCloud2::ConstPtr &in_child_cloud_msg)
+bool ROSMultiLidarCalibratorApp::AddKeyframe(ChildCalibration& in_child,
+                                             const sensor_msgs::PointCloud2& in_parent_cloud_msg,
+                                             const sensor_msgs::PointCloud2& in_child_cloud_msg)
 {
+    const ros::Time& stamp = in_child_cloud_msg.header.stamp;
+
+    // voxels of the coarsest level, so that the noise of the sensor is not taken for a new scene
+    std::unordered_set<int64_t> voxels;
+    OccupiedVoxels(in_parent_cloud_msg, levels_.front().voxel_size, voxels);
+
+    if (!in_child.keyframes.empty())
+    {
+        size_t shared = 0;
+        for (std::unordered_set<int64_t>::const_iterator it = voxels.begin(); it != voxels.end(); ++it)
+        {
+            shared += in_child.keyframe_voxels.count(*it);
+        }
+        const double overlap = voxels.empty() ? 0.0 : (double)shared / voxels.size();
+        if (overlap >= keyframe_overlap_
+            && stamp - in_child.last_keyframe_stamp < ros::Duration(keyframe_interval_))
+        {
+            return false;
+        }
+    }
+
+    Keyframe keyframe;
     pcl::PointCloud<PointT>::Ptr parent_cloud (new pcl::PointCloud<PointT>);
     pcl::PointCloud<PointT>::Ptr child_cloud (new pcl::PointCloud<PointT>);
-	pcl::PointCloud<PointT>::Ptr child_filtered_cloud (new pcl::PointCloud<PointT>);
+    DownsampleCloud(in_parent_cloud_msg, parent_cloud, voxel_size_);
+    DownsampleCloud(in_child_cloud_msg, child_cloud, voxel_size_);
+    keyframe.parent_cloud = parent_cloud;
+    keyframe.child_cloud = child_cloud;
+    keyframe.parent_pose = Eigen::Matrix4f::Identity();
+
+    if (!in_child.keyframes.empty())
+    {
+        // motion of the parent since the newest keyframe, against the parent submap
+        pcl::PointCloud<PointT>::Ptr parent_submap (new pcl::PointCloud<PointT>);
+        BuildSubmaps(in_child, Eigen::Matrix4f::Identity(), parent_submap, pcl::PointCloud<PointT>::Ptr());
 
-	pcl::fromROSMsg(*in_parent_cloud_msg, *parent_cloud);
-	pcl::fromROSMsg(*in_child_cloud_msg, *child_cloud);
+        AlignmentResult motion;
+        const RegistrationBackend::TargetConstPtr target = backend_->PrepareTarget(parent_submap, levels_);
+        backend_->AlignPyramid(*target, levels_, parent_cloud, Eigen::Matrix4f::Identity(), motion);
 
-	parent_frame_ = in_parent_cloud_msg->header.frame_id;
-	child_frame_ = in_child_cloud_msg->header.frame_id;
+        if (motion.converged)
+        {
+            keyframe.parent_pose = in_child.keyframes.back().parent_pose * motion.transformation;
+        }
+        else
+        {
+            ROS_WARN("[%s] Lost the motion of %s, restarting the submaps of %s", __APP_NAME__,
+                     in_child.parent_frame.c_str(), in_child.child_frame.c_str());
+            in_child.keyframes.clear();
+        }
+    }
 
-	DownsampleCloud(child_cloud, child_filtered_cloud, voxel_size_);
-	in_parent_cloud_ = parent_cloud;
-	in_child_cloud_ = child_cloud;
-    in_child_filtered_cloud_ = child_filtered_cloud;
+    in_child.keyframes.push_back(keyframe);
+    while (in_child.keyframes.size() > (size_t)keyframe_count_)
+    {
+        in_child.keyframes.pop_front();
+    }
+    in_child.keyframe_voxels.swap(voxels);
+    in_child.last_keyframe_stamp = stamp;
+    return true;
 }
 
-void ROSMultiLidarCalibratorApp::DownsampleCloud(pcl::PointCloud<PointT>::ConstPtr in_cloud_ptr,
-                                                 pcl::PointCloud<PointT>::Ptr out_cloud_ptr,
-                                                 double in_leaf_size)
+void ROSMultiLidarCalibratorApp::BuildSubmaps(const ChildCalibration& in_child, const Eigen::Matrix4f& in_guess,
+                                              pcl::PointCloud<PointT>::Ptr out_parent_submap,
+                                              pcl::PointCloud<PointT>::Ptr out_child_submap)
 {
-	pcl::VoxelGrid<PointT> voxelized;
-	voxelized.setInputCloud(in_cloud_ptr);
-	voxelized.setLeafSize((float)in_leaf_size, (float)in_leaf_size, (float)in_leaf_size);
-	voxelized.filter(*out_cloud_ptr);
+    const Eigen::Matrix4f newest_inverse = in_child.keyframes.back().parent_pose.inverse();
+    const Eigen::Matrix4f guess_inverse = in_guess.inverse();
+
+    pcl::PointCloud<PointT> moved_cloud;
+    for (size_t i = 0; i < in_child.keyframes.size(); ++i)
+    {
+        const Keyframe& keyframe = in_child.keyframes[i];
+        const Eigen::Matrix4f parent_motion = newest_inverse * keyframe.parent_pose;
+
+        pcl::transformPointCloud(*keyframe.parent_cloud, moved_cloud, parent_motion);
+        *out_parent_submap += moved_cloud;
+
+        if (out_child_submap)
+        {
+            // the child moved with the parent, seen through the guess
+            const Eigen::Matrix4f child_motion = guess_inverse * parent_motion * in_guess;
+            pcl::transformPointCloud(*keyframe.child_cloud, moved_cloud, child_motion);
+            *out_child_submap += moved_cloud;
+        }
+    }
 }
 
+void ROSMultiLidarCalibratorApp::CheckDrift(ChildCalibration& in_child,
+                                            const sensor_msgs::PointCloud2& in_parent_cloud_msg,
+                                            const sensor_msgs::PointCloud2& in_child_cloud_msg)
+{
+    Eigen::Matrix4f calibrated_transform;
+    {
+        std::lock_guard<std::mutex> lock(in_child.mutex);
+        calibrated_transform = in_child.current_guess;
+    }
+
+    std::unordered_set<int64_t> parent_voxels;
+    OccupiedVoxels(in_parent_cloud_msg, monitor_voxel_size_, parent_voxels);
+    const double consistency = VoxelOverlap(in_child_cloud_msg, calibrated_transform, parent_voxels,
+                                            monitor_voxel_size_, monitor_samples_);
+
+    std::lock_guard<std::mutex> lock(in_child.mutex);
+    in_child.last_check_time = ros::Time::now();
+    in_child.consistency = consistency;
+
+    // the lidars never overlap completely, so the score is compared to the one of the first checks
+    if (in_child.baseline_checks < convergence_window_)
+    {
+        in_child.consistency_baseline = (in_child.consistency_baseline * in_child.baseline_checks + consistency)
+                                        / (in_child.baseline_checks + 1);
+        in_child.baseline_checks++;
+        return;
+    }
+
+    if (consistency >= in_child.consistency_baseline * (1.0 - monitor_tolerance_))
+    {
+        in_child.degraded_checks = 0;
+        return;
+    }
+
+    in_child.degraded_checks++;
+    ROS_DEBUG("[%s] Consistency of %s with %s is %.3f, below its baseline %.3f for %d checks", __APP_NAME__,
+              in_child.child_frame.c_str(), in_child.parent_frame.c_str(), consistency,
+              in_child.consistency_baseline, in_child.degraded_checks);
+    if (in_child.degraded_checks < monitor_degraded_checks_)
+    {
+        return;
+    }
+
+    ROS_WARN("[%s] Consistency of %s with %s dropped to %.3f from %.3f. Calibrating again.", __APP_NAME__,
+             in_child.child_frame.c_str(), in_child.parent_frame.c_str(), consistency, in_child.consistency_baseline);
+    in_child.converged = false;
+    in_child.drifted = true;
+    in_child.recent_transforms.clear();
+    in_child.recent_fitness.clear();
+    // the submaps were built around the drifted calibration
+    in_child.keyframes.clear();
+    in_child.keyframe_voxels.clear();
+    in_child.last_keyframe_stamp = ros::Time();
+}
+
+void ROSMultiLidarCalibratorApp::ChildDiagnostics(ChildCalibration* in_child,
+                                                  diagnostic_updater::DiagnosticStatusWrapper& out_status)
+{
+    std::lock_guard<std::mutex> lock(in_child->mutex);
+
+    if (in_child->converged && in_child->degraded_checks > 0)
+    {
+        out_status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Consistency below the calibrated baseline");
+    }
+    else if (in_child->converged)
+    {
+        out_status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Calibrated");
+    }
+    else if (in_child->drifted)
+    {
+        out_status.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Drifted, calibrating again");
+    }
+    else
+    {
+        out_status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Calibrating");
+    }
+
+    out_status.add("child_frame", in_child->child_frame);
+    out_status.add("parent_frame", in_child->parent_frame);
+    out_status.add("alignments", in_child->alignment_count);
+    out_status.add("window", in_child->recent_transforms.size());
+    out_status.add("method", backend_->Name());
+    out_status.add("registration_converged", in_child->last_result.converged);
+    out_status.add("iterations", in_child->last_result.iterations);
+    out_status.add("fitness", in_child->last_result.fitness);
+    out_status.add("probability", in_child->last_result.probability);
+    out_status.add("translation_delta", in_child->translation_delta);
+    out_status.add("rotation_delta", in_child->rotation_delta);
+    out_status.add("levels", in_child->last_result.levels);
+    out_status.add("consistency", in_child->consistency);
+    out_status.add("consistency_baseline", in_child->consistency_baseline);
+    out_status.add("baseline_checks", in_child->baseline_checks);
+    out_status.add("degraded_checks", in_child->degraded_checks);
+}
+
+void ROSMultiLidarCalibratorApp::PointsCallback(ChildCalibration* in_child,
+                                                const sensor_msgs::PointCloud2::ConstPtr &in_parent_cloud_msg,
+                                                const sensor_msgs::PointCloud2::ConstPtr &in_child_cloud_msg)
+{
+    std::lock_guard<std::mutex> lock(in_child->mutex);
+
+    // once converged, only check the result every monitor_interval_
+    if (in_child->converged && (monitor_interval_ <= 0 ||
+                                ros::Time::now() - in_child->last_check_time < ros::Duration(monitor_interval_)))
+    {
+        return;
+    }
+
+    // a pair the worker has not taken yet is replaced by the newer one
+    in_child->parent_msg = in_parent_cloud_msg;
+    in_child->child_msg = in_child_cloud_msg;
+    in_child->fresh_pair.notify_one();
+}
 
 void ROSMultiLidarCalibratorApp::InitializeROSIo(ros::NodeHandle &in_private_handle)
 {
@@ -128,31 +482,46 @@ void ROSMultiLidarCalibratorApp::InitializeROSIo(ros::NodeHandle &in_private_han
 	std::string initial_pose_topic_str = "/initialpose";
 	std::string calibrated_points_topic_str = "/points_calibrated";
 
-	// x, y, z, yaw, pitch, roll
+	in_private_handle.param<std::string>("points_parent_src", points_parent_topic_str, "points_raw");
+	ROS_INFO("[%s] points_parent_src: %s",__APP_NAME__, points_parent_topic_str.c_str());
+
+	in_private_handle.param<std::string>("points_child_src", points_child_topic_str, "points_raw");
+	ROS_INFO("[%s] points_child_src: %s",__APP_NAME__, points_child_topic_str.c_str());
+
+	// every child listed in the file is calibrated: topic, then x, y, z, yaw, pitch, roll of the initial guess
     std::string init_file_path;
     in_private_handle.param<std::string>("init_params_file_path", init_file_path, " ");
     std::ifstream ifs(init_file_path);
 
-    ifs>>child_topic_num_;
+    int child_topic_num = 0;
+    ifs>>child_topic_num;
 
-    for (int j = 0; j < child_topic_num_; ++j) {
+    std::map<std::string, std::vector<double>> transfer_map;
+    std::vector<std::string> child_topics;
+    for (int j = 0; j < child_topic_num && ifs; ++j) {
         std::string child_name;
         ifs>>child_name;
         std::vector<double> tmp_transfer;
         for (int k = 0; k < 6; ++k) {
             // read xyzypr
-            double tmp_xyzypr;
+            double tmp_xyzypr = 0.0;
             ifs>>tmp_xyzypr;
             tmp_transfer.push_back(tmp_xyzypr);
         }
-        transfer_map_.insert(std::pair<std::string, std::vector<double>>(child_name, tmp_transfer));
+        if (child_name == points_parent_topic_str || transfer_map.count(child_name))
+        {
+            continue;
+        }
+        transfer_map.insert(std::pair<std::string, std::vector<double>>(child_name, tmp_transfer));
+        child_topics.push_back(child_name);
+    }
+    if (child_topics.empty())
+    {
+        ROS_WARN("[%s] No child in %s, calibrating points_child_src from the identity",__APP_NAME__,
+                 init_file_path.c_str());
+        transfer_map[points_child_topic_str] = std::vector<double>(6, 0.0);
+        child_topics.push_back(points_child_topic_str);
     }
-
-	in_private_handle.param<std::string>("points_parent_src", points_parent_topic_str, "points_raw");
-	ROS_INFO("[%s] points_parent_src: %s",__APP_NAME__, points_parent_topic_str.c_str());
-
-	in_private_handle.param<std::string>("points_child_src", points_child_topic_str, "points_raw");
-	ROS_INFO("[%s] points_child_src: %s",__APP_NAME__, points_child_topic_str.c_str());
 
 	in_private_handle.param<double>("voxel_size", voxel_size_, 0.1);
 	ROS_INFO("[%s] ndt_epsilon: %.2f",__APP_NAME__, voxel_size_);
@@ -169,24 +538,179 @@ void ROSMultiLidarCalibratorApp::InitializeROSIo(ros::NodeHandle &in_private_han
 	in_private_handle.param<int>("ndt_iterations", ndt_iterations_, 400);
 	ROS_INFO("[%s] ndt_iterations: %d",__APP_NAME__, ndt_iterations_);
 
-	//generate subscribers and synchronizer
+	in_private_handle.param<int>("ndt_num_threads", ndt_num_threads_, 0);
+	ROS_INFO("[%s] ndt_num_threads: %d",__APP_NAME__, ndt_num_threads_);
+
+	std::string ndt_search_method;
+	in_private_handle.param<std::string>("ndt_search_method", ndt_search_method, "KDTREE");
+	if (ndt_search_method == "DIRECT7")
+	{
+		ndt_search_method_ = pclomp::DIRECT7;
+	}
+	else if (ndt_search_method == "DIRECT1")
+	{
+		ndt_search_method_ = pclomp::DIRECT1;
+	}
+	else
+	{
+		if (ndt_search_method != "KDTREE")
+		{
+			ROS_WARN("[%s] Unknown ndt_search_method %s, using KDTREE",__APP_NAME__, ndt_search_method.c_str());
+			ndt_search_method = "KDTREE";
+		}
+		ndt_search_method_ = pclomp::KDTREE;
+	}
+	ROS_INFO("[%s] ndt_search_method: %s",__APP_NAME__, ndt_search_method.c_str());
+
+	// coarser levels run first, one entry per level in each list
+	std::vector<double> pyramid_voxel_sizes, pyramid_resolutions, pyramid_epsilons;
+	std::vector<int> pyramid_iterations;
+	in_private_handle.getParam("pyramid_voxel_sizes", pyramid_voxel_sizes);
+	in_private_handle.getParam("pyramid_resolutions", pyramid_resolutions);
+	in_private_handle.getParam("pyramid_iterations", pyramid_iterations);
+	in_private_handle.getParam("pyramid_epsilons", pyramid_epsilons);
+
+	size_t pyramid_size = std::min(std::min(pyramid_voxel_sizes.size(), pyramid_resolutions.size()),
+	                               std::min(pyramid_iterations.size(), pyramid_epsilons.size()));
+	if (pyramid_size != std::max(std::max(pyramid_voxel_sizes.size(), pyramid_resolutions.size()),
+	                             std::max(pyramid_iterations.size(), pyramid_epsilons.size())))
+	{
+		ROS_WARN("[%s] pyramid_ lists differ in length, using their first %zu levels",__APP_NAME__, pyramid_size);
+	}
+
+	levels_.clear();
+	for (size_t i = 0; i < pyramid_size; ++i)
+	{
+		RegistrationLevel level;
+		level.voxel_size = pyramid_voxel_sizes[i];
+		level.resolution = pyramid_resolutions[i];
+		level.iterations = pyramid_iterations[i];
+		level.epsilon = pyramid_epsilons[i];
+		levels_.push_back(level);
+	}
+
+	RegistrationLevel finest_level;
+	finest_level.voxel_size = voxel_size_;
+	finest_level.resolution = ndt_resolution_;
+	finest_level.iterations = ndt_iterations_;
+	finest_level.epsilon = ndt_epsilon_;
+	levels_.push_back(finest_level);
+
+	for (size_t i = 0; i < levels_.size(); ++i)
+	{
+		ROS_INFO("[%s] level %zu: voxel_size %.2f, resolution %.2f, iterations %d, epsilon %.3f",
+		         __APP_NAME__, i, levels_[i].voxel_size, levels_[i].resolution, levels_[i].iterations,
+		         levels_[i].epsilon);
+	}
+
+	std::string registration_method;
+	in_private_handle.param<std::string>("registration_method", registration_method, "NDT");
+	backend_ = RegistrationBackend::Create(registration_method, ndt_num_threads_, ndt_search_method_, ndt_step_size_);
+	if (!backend_)
+	{
+		ROS_WARN("[%s] Unknown registration_method %s, using NDT",__APP_NAME__, registration_method.c_str());
+		backend_ = RegistrationBackend::Create("NDT", ndt_num_threads_, ndt_search_method_, ndt_step_size_);
+	}
+	ROS_INFO("[%s] registration_method: %s",__APP_NAME__, backend_->Name().c_str());
+
+	in_private_handle.param<int>("convergence_window", convergence_window_, 5);
+	convergence_window_ = std::max(convergence_window_, 1);
+	ROS_INFO("[%s] convergence_window: %d",__APP_NAME__, convergence_window_);
+
+	in_private_handle.param<double>("convergence_translation", convergence_translation_, 0.01);
+	ROS_INFO("[%s] convergence_translation: %.4f",__APP_NAME__, convergence_translation_);
+
+	in_private_handle.param<double>("convergence_rotation", convergence_rotation_, 0.002);
+	ROS_INFO("[%s] convergence_rotation: %.4f",__APP_NAME__, convergence_rotation_);
+
+	in_private_handle.param<double>("convergence_fitness", convergence_fitness_, 0.05);
+	ROS_INFO("[%s] convergence_fitness: %.4f",__APP_NAME__, convergence_fitness_);
+
+	in_private_handle.param<double>("monitor_interval", monitor_interval_, 5.0);
+	ROS_INFO("[%s] monitor_interval: %.2f",__APP_NAME__, monitor_interval_);
+
+	in_private_handle.param<double>("monitor_voxel_size", monitor_voxel_size_, 0.2);
+	ROS_INFO("[%s] monitor_voxel_size: %.2f",__APP_NAME__, monitor_voxel_size_);
+
+	in_private_handle.param<int>("monitor_samples", monitor_samples_, 1000);
+	monitor_samples_ = std::max(monitor_samples_, 1);
+	ROS_INFO("[%s] monitor_samples: %d",__APP_NAME__, monitor_samples_);
+
+	in_private_handle.param<double>("monitor_tolerance", monitor_tolerance_, 0.1);
+	ROS_INFO("[%s] monitor_tolerance: %.2f",__APP_NAME__, monitor_tolerance_);
+
+	in_private_handle.param<int>("monitor_degraded_checks", monitor_degraded_checks_, 3);
+	monitor_degraded_checks_ = std::max(monitor_degraded_checks_, 1);
+	ROS_INFO("[%s] monitor_degraded_checks: %d",__APP_NAME__, monitor_degraded_checks_);
+
+	in_private_handle.param<int>("keyframe_count", keyframe_count_, 1);
+	keyframe_count_ = std::max(keyframe_count_, 1);
+	ROS_INFO("[%s] keyframe_count: %d",__APP_NAME__, keyframe_count_);
+
+	in_private_handle.param<double>("keyframe_overlap", keyframe_overlap_, 0.8);
+	ROS_INFO("[%s] keyframe_overlap: %.2f",__APP_NAME__, keyframe_overlap_);
+
+	in_private_handle.param<double>("keyframe_interval", keyframe_interval_, 1.0);
+	ROS_INFO("[%s] keyframe_interval: %.2f",__APP_NAME__, keyframe_interval_);
+
+	//generate subscribers and synchronizers, the parent cloud is shared by one synchronizer per child
 	cloud_parent_subscriber_ = new message_filters::Subscriber<sensor_msgs::PointCloud2>(node_handle_,
 	                                                                                     points_parent_topic_str, 1);
 	ROS_INFO("[%s] Subscribing to... %s",__APP_NAME__, points_parent_topic_str.c_str());
 
-	cloud_child_subscriber_ = new message_filters::Subscriber<sensor_msgs::PointCloud2>(node_handle_,
-	                                                                                        points_child_topic_str, 1);
-	ROS_INFO("[%s] Subscribing to... %s",__APP_NAME__, points_child_topic_str.c_str());
+	for (size_t i = 0; i < child_topics.size(); ++i)
+	{
+		std::unique_ptr<ChildCalibration> child(new ChildCalibration);
+		child->topic = child_topics[i];
+		child->current_guess = XyzyprToMatrix(transfer_map[child_topics[i]]);
+		child->calibrated = false;
+		child->converged = false;
+		child->drifted = false;
+		child->unsubscribe_pending = false;
+		child->alignment_count = 0;
+		child->last_result.converged = false;
+		child->last_result.iterations = 0;
+		child->last_result.fitness = 0.0;
+		child->last_result.probability = 0.0;
+		child->translation_delta = 0.0;
+		child->rotation_delta = 0.0;
+		child->consistency = 0.0;
+		child->consistency_baseline = 0.0;
+		child->baseline_checks = 0;
+		child->degraded_checks = 0;
+
+		child->subscriber = new message_filters::Subscriber<sensor_msgs::PointCloud2>(node_handle_, child->topic, 1);
+		ROS_INFO("[%s] Subscribing to... %s",__APP_NAME__, child->topic.c_str());
+
+		child->synchronizer =
+				new message_filters::Synchronizer<SyncPolicyT>(SyncPolicyT(100),
+				                                               *cloud_parent_subscriber_,
+				                                               *child->subscriber);
+		child->synchronizer->registerCallback(boost::bind(&ROSMultiLidarCalibratorApp::PointsCallback, this,
+		                                                  child.get(), _1, _2));
+
+		// one latched result per child, under the name of its topic
+		const std::string result_topic = "calibration_result/" +
+				(child->topic[0] == '/' ? child->topic.substr(1) : child->topic);
+		child->result_publisher = in_private_handle.advertise<geometry_msgs::TransformStamped>(result_topic, 1, true);
+		ROS_INFO("[%s] Publishing result to... %s",__APP_NAME__, child->result_publisher.getTopic().c_str());
+
+		diagnostics_.add(child->topic, boost::bind(&ROSMultiLidarCalibratorApp::ChildDiagnostics, this,
+		                                           child.get(), _1));
+
+		children_.push_back(std::move(child));
+	}
+	diagnostics_.setHardwareID(points_parent_topic_str);
 
 	calibrated_cloud_publisher_ = node_handle_.advertise<sensor_msgs::PointCloud2>(calibrated_points_topic_str, 1);
 	ROS_INFO("[%s] Publishing PointCloud to... %s",__APP_NAME__, calibrated_points_topic_str.c_str());
 
-	cloud_synchronizer_ =
-			new message_filters::Synchronizer<SyncPolicyT>(SyncPolicyT(100),
-			                                               *cloud_parent_subscriber_,
-			                                               *cloud_child_subscriber_);
-	cloud_synchronizer_->registerCallback(boost::bind(&ROSMultiLidarCalibratorApp::PointsCallback, this, _1, _2));
+	tf_timer_ = node_handle_.createTimer(ros::Duration(0.1), &ROSMultiLidarCalibratorApp::BroadcastTransform, this);
 
+	for (size_t i = 0; i < children_.size(); ++i)
+	{
+		children_[i]->worker = std::thread(&ROSMultiLidarCalibratorApp::CalibrateChild, this, children_[i].get());
+	}
 }
 
 
@@ -198,24 +722,28 @@ void ROSMultiLidarCalibratorApp::Run()
 
 	ROS_INFO("[%s] Ready. Waiting for data...",__APP_NAME__);
 
-	ros::Rate loop_rate(10);
-	while (ros::ok()){
-
-	    ros::spinOnce();
-
-	    // start NDT process here
-        PerformNdtOptimize();
+	// alignments are run by the worker of each child, once per synchronized pair
+	ros::spin();
 
-        loop_rate.sleep();
+	shutting_down_ = true;
+	for (size_t i = 0; i < children_.size(); ++i)
+	{
+		{
+			std::lock_guard<std::mutex> lock(children_[i]->mutex);
+			children_[i]->fresh_pair.notify_one();
+		}
+		children_[i]->worker.join();
 	}
 
-	ros::spin();
-
 	ROS_INFO("[%s] END",__APP_NAME__);
 }
 
 ROSMultiLidarCalibratorApp::ROSMultiLidarCalibratorApp()
 {
 	//initialpose_quaternion_ = tf::Quaternion::getIdentity();
-	current_guess_ = Eigen::Matrix4f::Identity();
+	ndt_num_threads_ = 0;
+	ndt_search_method_ = pclomp::KDTREE;
+	keyframe_count_ = 1;
+	unsubscribed_children_ = 0;
+	shutting_down_ = false;
 }
\ No newline at end of file
@@ -0,0 +1,562 @@
+/*
+ * Calibrates the children of child_topic_list from recorded clouds, without a ROS master.
+ *
+ * Usage: offline_calibrator --parent <source> --init <child_topic_list> [options]
+ *
+ * A source is a topic of the bag given by --bag, or else a directory of PCD files named by their
+ * stamp in seconds (1589262136.104335.pcd). The children and their initial guesses are read from
+ * --init in the format of cfg/child_topic_list, --child adds one from the identity.
+ *
+ * Every child frame is paired with the nearest parent frame in time, the pairs are spread over the
+ * whole recording and aligned in parallel, each from the initial guess. The extrinsic of a child is
+ * the mean of the alignments that agree with the median one.
+ *
+ * Options:
+ *   --bag <file.bag>                   read the sources from a bag
+ *   --output <file>                    write the extrinsics in the format of child_topic_list
+ *   --method <NDT|GICP|POINT_TO_PLANE> registration method, NDT
+ *   --threads <n>                      alignments run at once, 0 for every core
+ *   --max_time_diff <s>                largest stamp difference of a pair, 0.05
+ *   --max_pairs <n>                    pairs aligned per child, 200
+ *   --inlier_translation <m>           largest distance of an agreeing alignment to the median, 0.05
+ *   --inlier_rotation <rad>            largest angle of an agreeing alignment to the median, 0.01
+ *   --level <voxel_size> <resolution> <iterations> <epsilon>   one pyramid level, coarse to fine
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pcl/io/pcd_io.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include "calibration_aggregation.h"
+#include "point_cloud2_view.h"
+#include "registration_backend.h"
+
+namespace
+{
+
+typedef RegistrationBackend::PointT         PointT;
+typedef RegistrationBackend::PointCloudT    PointCloudT;
+
+struct OfflineSettings
+{
+	std::string                         bag_path;
+	std::string                         parent;
+	std::string                         init_path;
+	std::string                         output_path;
+	std::string                         method;
+	int                                 num_threads;
+	double                              max_time_diff;
+	size_t                              max_pairs;
+	double                              inlier_translation;
+	double                              inlier_rotation;
+	std::vector<RegistrationLevel>      levels;
+
+	std::vector<std::string>            children;
+	std::vector<std::vector<double> >   initial_xyzypr;
+};
+
+/*!
+ * Recorded frames of one lidar, sorted by stamp, and the clouds loaded for the pairs
+ */
+struct FrameSource
+{
+	std::string                         name;
+	std::string                         frame_id;
+	std::vector<double>                 stamps;
+	std::vector<std::string>            files;      // PCD only
+	std::map<size_t, PointCloudT::Ptr>  clouds;     // by frame index
+};
+
+bool ParseArguments(int argc, char **argv, OfflineSettings& out_settings)
+{
+	out_settings.method = "NDT";
+	out_settings.num_threads = 0;
+	out_settings.max_time_diff = 0.05;
+	out_settings.max_pairs = 200;
+	out_settings.inlier_translation = 0.05;
+	out_settings.inlier_rotation = 0.01;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string option = argv[i];
+		const int values = option == "--level" ? 4 : 1;
+		if (i + values >= argc)
+		{
+			std::cerr << option << " needs " << values << " value(s)" << std::endl;
+			return false;
+		}
+
+		if (option == "--bag")
+		{
+			out_settings.bag_path = argv[++i];
+		}
+		else if (option == "--parent")
+		{
+			out_settings.parent = argv[++i];
+		}
+		else if (option == "--init")
+		{
+			out_settings.init_path = argv[++i];
+		}
+		else if (option == "--child")
+		{
+			out_settings.children.push_back(argv[++i]);
+			out_settings.initial_xyzypr.push_back(std::vector<double>(6, 0.0));
+		}
+		else if (option == "--output")
+		{
+			out_settings.output_path = argv[++i];
+		}
+		else if (option == "--method")
+		{
+			out_settings.method = argv[++i];
+		}
+		else if (option == "--threads")
+		{
+			out_settings.num_threads = std::atoi(argv[++i]);
+		}
+		else if (option == "--max_time_diff")
+		{
+			out_settings.max_time_diff = std::atof(argv[++i]);
+		}
+		else if (option == "--max_pairs")
+		{
+			out_settings.max_pairs = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (option == "--inlier_translation")
+		{
+			out_settings.inlier_translation = std::atof(argv[++i]);
+		}
+		else if (option == "--inlier_rotation")
+		{
+			out_settings.inlier_rotation = std::atof(argv[++i]);
+		}
+		else if (option == "--level")
+		{
+			RegistrationLevel level;
+			level.voxel_size = std::atof(argv[++i]);
+			level.resolution = std::atof(argv[++i]);
+			level.iterations = std::atoi(argv[++i]);
+			level.epsilon = std::atof(argv[++i]);
+			out_settings.levels.push_back(level);
+		}
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return false;
+		}
+	}
+
+	if (out_settings.parent.empty())
+	{
+		std::cerr << "--parent is required" << std::endl;
+		return false;
+	}
+	if (out_settings.levels.empty())
+	{
+		out_settings.levels = DefaultRegistrationLevels();
+	}
+	return true;
+}
+
+/*!
+ * Reads the children of a child_topic_list file, as the calibrator node does
+ */
+bool ReadInitFile(const std::string& in_path, OfflineSettings& out_settings)
+{
+	std::ifstream ifs(in_path.c_str());
+	if (!ifs)
+	{
+		std::cerr << "Cannot open " << in_path << std::endl;
+		return false;
+	}
+
+	int child_topic_num = 0;
+	ifs >> child_topic_num;
+	for (int j = 0; j < child_topic_num && ifs; ++j)
+	{
+		std::string child_name;
+		std::vector<double> xyzypr(6, 0.0);
+		ifs >> child_name;
+		for (int k = 0; k < 6; ++k)
+		{
+			ifs >> xyzypr[k];
+		}
+		if (!ifs || child_name == out_settings.parent
+		    || std::find(out_settings.children.begin(), out_settings.children.end(), child_name)
+		       != out_settings.children.end())
+		{
+			continue;
+		}
+		out_settings.children.push_back(child_name);
+		out_settings.initial_xyzypr.push_back(xyzypr);
+	}
+	return true;
+}
+
+/*!
+ * Lists the PCD files of a directory, named by their stamp
+ */
+bool ListPcdDirectory(FrameSource& io_source)
+{
+	DIR* directory = opendir(io_source.name.c_str());
+	if (!directory)
+	{
+		std::cerr << "Cannot open the directory " << io_source.name << std::endl;
+		return false;
+	}
+
+	std::vector<std::pair<double, std::string> > frames;
+	for (dirent* entry = readdir(directory); entry; entry = readdir(directory))
+	{
+		const std::string file_name = entry->d_name;
+		if (file_name.size() <= 4 || file_name.compare(file_name.size() - 4, 4, ".pcd") != 0)
+		{
+			continue;
+		}
+		char* end = NULL;
+		const double stamp = std::strtod(file_name.c_str(), &end);
+		if (end != file_name.c_str() + file_name.size() - 4)
+		{
+			std::cerr << "Skipping " << file_name << ", not named by its stamp" << std::endl;
+			continue;
+		}
+		frames.push_back(std::make_pair(stamp, io_source.name + "/" + file_name));
+	}
+	closedir(directory);
+
+	std::sort(frames.begin(), frames.end());
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		io_source.stamps.push_back(frames[i].first);
+		io_source.files.push_back(frames[i].second);
+	}
+	io_source.frame_id = io_source.name;
+	return true;
+}
+
+/*!
+ * Reads the header stamps of every source in one pass over the bag
+ */
+void ReadBagStamps(const rosbag::Bag& in_bag, std::vector<FrameSource*>& io_sources)
+{
+	std::map<std::string, FrameSource*> by_topic;
+	std::vector<std::string> topics;
+	for (size_t i = 0; i < io_sources.size(); ++i)
+	{
+		by_topic[io_sources[i]->name] = io_sources[i];
+		topics.push_back(io_sources[i]->name);
+	}
+
+	rosbag::View view(in_bag, rosbag::TopicQuery(topics));
+	for (rosbag::View::iterator it = view.begin(); it != view.end(); ++it)
+	{
+		sensor_msgs::PointCloud2::ConstPtr msg = it->instantiate<sensor_msgs::PointCloud2>();
+		if (!msg)
+		{
+			continue;
+		}
+		FrameSource* source = by_topic[it->getTopic()];
+		source->stamps.push_back(msg->header.stamp.toSec());
+		source->frame_id = msg->header.frame_id;
+	}
+
+	// frames are indexed in bag order, which is the stamp order of a recorded lidar
+	for (size_t i = 0; i < io_sources.size(); ++i)
+	{
+		if (!std::is_sorted(io_sources[i]->stamps.begin(), io_sources[i]->stamps.end()))
+		{
+			std::cerr << "Warning: stamps of " << io_sources[i]->name << " are out of order in the bag" << std::endl;
+		}
+	}
+}
+
+/*!
+ * Converts the frames of the pairs in one more pass over the bag
+ */
+void LoadBagClouds(const rosbag::Bag& in_bag, const std::vector<FrameSource*>& in_sources,
+                   const std::map<FrameSource*, std::vector<size_t> >& in_needed)
+{
+	std::map<std::string, FrameSource*> by_topic;
+	std::map<std::string, size_t> next_index;
+	std::vector<std::string> topics;
+	for (size_t i = 0; i < in_sources.size(); ++i)
+	{
+		by_topic[in_sources[i]->name] = in_sources[i];
+		next_index[in_sources[i]->name] = 0;
+		topics.push_back(in_sources[i]->name);
+	}
+
+	rosbag::View view(in_bag, rosbag::TopicQuery(topics));
+	for (rosbag::View::iterator it = view.begin(); it != view.end(); ++it)
+	{
+		sensor_msgs::PointCloud2::ConstPtr msg = it->instantiate<sensor_msgs::PointCloud2>();
+		if (!msg)
+		{
+			continue;
+		}
+		FrameSource* source = by_topic[it->getTopic()];
+		const size_t index = next_index[it->getTopic()]++;
+		const std::vector<size_t>& needed = in_needed.at(source);
+		if (!std::binary_search(needed.begin(), needed.end(), index))
+		{
+			continue;
+		}
+		PointCloudT::Ptr cloud(new PointCloudT);
+		ConvertCloud(*msg, *cloud);
+		source->clouds[index] = cloud;
+	}
+}
+
+bool LoadPcdClouds(FrameSource& io_source, const std::vector<size_t>& in_needed)
+{
+	for (size_t i = 0; i < in_needed.size(); ++i)
+	{
+		PointCloudT::Ptr cloud(new PointCloudT);
+		if (pcl::io::loadPCDFile<PointT>(io_source.files[in_needed[i]], *cloud) < 0)
+		{
+			std::cerr << "Cannot load " << io_source.files[in_needed[i]] << std::endl;
+			return false;
+		}
+		io_source.clouds[in_needed[i]] = cloud;
+	}
+	return true;
+}
+
+/*!
+ * Runs in_job for every index below in_count on in_num_threads threads
+ */
+void RunParallel(size_t in_count, int in_num_threads, const std::function<void(size_t)>& in_job)
+{
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < in_num_threads; ++t)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			for (size_t i = next++; i < in_count; i = next++)
+			{
+				in_job(i);
+			}
+		}));
+	}
+	for (size_t t = 0; t < workers.size(); ++t)
+	{
+		workers[t].join();
+	}
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	OfflineSettings settings;
+	if (!ParseArguments(argc, argv, settings)
+	    || (!settings.init_path.empty() && !ReadInitFile(settings.init_path, settings)))
+	{
+		std::cerr << "Usage: " << argv[0] << " --parent <source> --init <child_topic_list> [--bag <file.bag>]"
+		          << " [--child <source>] [--output <file>] [--method <method>] [--threads <n>]"
+		          << " [--max_time_diff <s>] [--max_pairs <n>] [--inlier_translation <m>]"
+		          << " [--inlier_rotation <rad>] [--level <voxel_size> <resolution> <iterations> <epsilon>]"
+		          << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (settings.children.empty())
+	{
+		std::cerr << "No child to calibrate, give --init or --child" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const int num_threads = settings.num_threads > 0 ? settings.num_threads
+	                                                 : std::max(1, (int)std::thread::hardware_concurrency());
+	// the pairs are the parallelism, each alignment runs on one thread
+	const RegistrationBackend::ConstPtr backend =
+			RegistrationBackend::Create(settings.method, 1, pclomp::KDTREE, 0.1);
+	if (!backend)
+	{
+		std::cerr << "Unknown method " << settings.method << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	FrameSource parent;
+	parent.name = settings.parent;
+	std::vector<FrameSource> child_sources(settings.children.size());
+	std::vector<FrameSource*> sources(1, &parent);
+	for (size_t i = 0; i < child_sources.size(); ++i)
+	{
+		child_sources[i].name = settings.children[i];
+		sources.push_back(&child_sources[i]);
+	}
+
+	rosbag::Bag bag;
+	try
+	{
+		if (!settings.bag_path.empty())
+		{
+			bag.open(settings.bag_path, rosbag::bagmode::Read);
+			ReadBagStamps(bag, sources);
+		}
+		else
+		{
+			for (size_t i = 0; i < sources.size(); ++i)
+			{
+				if (!ListPcdDirectory(*sources[i]))
+				{
+					return EXIT_FAILURE;
+				}
+			}
+		}
+	}
+	catch (const rosbag::BagException& e)
+	{
+		std::cerr << "Cannot read " << settings.bag_path << ": " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<FramePair> pairs;
+	std::map<FrameSource*, std::vector<size_t> > needed;
+	for (size_t i = 0; i < child_sources.size(); ++i)
+	{
+		const std::vector<FramePair> child_pairs =
+				PairFrames(i, parent.stamps, child_sources[i].stamps, settings.max_time_diff,
+				           settings.max_pairs);
+		std::cout << child_sources[i].name << ": " << child_sources[i].stamps.size() << " frames, "
+		          << child_pairs.size() << " pairs with " << parent.name << std::endl;
+		for (size_t p = 0; p < child_pairs.size(); ++p)
+		{
+			needed[&parent].push_back(child_pairs[p].parent_frame);
+			needed[&child_sources[i]].push_back(child_pairs[p].child_frame);
+		}
+		pairs.insert(pairs.end(), child_pairs.begin(), child_pairs.end());
+	}
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		std::vector<size_t>& indices = needed[sources[i]];
+		std::sort(indices.begin(), indices.end());
+		indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+	}
+
+	try
+	{
+		if (!settings.bag_path.empty())
+		{
+			LoadBagClouds(bag, sources, needed);
+		}
+		else
+		{
+			for (size_t i = 0; i < sources.size(); ++i)
+			{
+				if (!LoadPcdClouds(*sources[i], needed[sources[i]]))
+				{
+					return EXIT_FAILURE;
+				}
+			}
+		}
+	}
+	catch (const rosbag::BagException& e)
+	{
+		std::cerr << "Cannot read " << settings.bag_path << ": " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// one target per parent frame, shared by every child paired with it
+	const std::vector<size_t>& parent_frames = needed[&parent];
+	std::vector<RegistrationBackend::TargetConstPtr> targets(parent_frames.size());
+	RunParallel(parent_frames.size(), num_threads, [&](size_t i)
+	{
+		targets[i] = backend->PrepareTarget(parent.clouds.at(parent_frames[i]), settings.levels);
+	});
+
+	std::vector<AlignmentResult, Eigen::aligned_allocator<AlignmentResult> > results(pairs.size());
+	RunParallel(pairs.size(), num_threads, [&](size_t i)
+	{
+		const FramePair& pair = pairs[i];
+		const size_t target = std::lower_bound(parent_frames.begin(), parent_frames.end(), pair.parent_frame)
+		                      - parent_frames.begin();
+		backend->AlignPyramid(*targets[target], settings.levels,
+		                      child_sources[pair.child].clouds.at(pair.child_frame),
+		                      XyzyprToMatrix(settings.initial_xyzypr[pair.child]), results[i]);
+	});
+
+	const double elapsed_s =
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << pairs.size() << " pairs aligned with " << backend->Name() << " on " << num_threads
+	          << " threads in " << std::fixed << std::setprecision(1) << elapsed_s << " s" << std::endl;
+
+	// a child left uncalibrated keeps its initial guess in the output
+	bool all_calibrated = true;
+	std::ostringstream output;
+	output << std::setprecision(6) << std::fixed << child_sources.size() << std::endl;
+	for (size_t c = 0; c < child_sources.size(); ++c)
+	{
+		TransformVector converged;
+		for (size_t i = 0; i < pairs.size(); ++i)
+		{
+			if (pairs[i].child == c && results[i].converged)
+			{
+				converged.push_back(results[i].transformation);
+			}
+		}
+
+		Eigen::Matrix4f extrinsic = XyzyprToMatrix(settings.initial_xyzypr[c]);
+		double translation_spread = 0.0, rotation_spread = 0.0;
+		const size_t inliers = AggregateTransforms(converged, settings.inlier_translation, settings.inlier_rotation,
+		                                           extrinsic, translation_spread, rotation_spread);
+		const size_t pair_count = needed[&child_sources[c]].size();
+
+		const std::vector<double> xyzypr = MatrixToXyzypr(extrinsic);
+		output << child_sources[c].name;
+		for (size_t k = 0; k < xyzypr.size(); ++k)
+		{
+			output << " " << xyzypr[k];
+		}
+		output << std::endl;
+
+		if (!inliers)
+		{
+			std::cout << child_sources[c].name << ": not calibrated, " << converged.size() << "/" << pair_count
+			          << " pairs converged, none within the inlier thresholds" << std::endl;
+			all_calibrated = false;
+			continue;
+		}
+		std::cout << child_sources[c].name << " (" << child_sources[c].frame_id << " to " << parent.frame_id
+		          << "): " << inliers << "/" << pair_count << " pairs agree within "
+		          << std::setprecision(4) << translation_spread << " m and " << rotation_spread << " rad" << std::endl
+		          << "  x y z yaw pitch roll:";
+		for (size_t k = 0; k < xyzypr.size(); ++k)
+		{
+			std::cout << " " << xyzypr[k];
+		}
+		std::cout << std::endl;
+	}
+
+	if (!settings.output_path.empty())
+	{
+		std::ofstream file(settings.output_path.c_str());
+		file << output.str();
+		if (!file)
+		{
+			std::cerr << "Cannot write " << settings.output_path << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	return all_calibrated ? EXIT_SUCCESS : EXIT_FAILURE;
+}
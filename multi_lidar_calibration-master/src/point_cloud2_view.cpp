@@ -0,0 +1,161 @@
+#include "point_cloud2_view.h"
+
+#include <unordered_map>
+#include <pcl_conversions/pcl_conversions.h>
+
+#include "registration_backend.h"
+
+namespace
+{
+
+// 21 bits per axis, enough for 200 km at 0.1 m
+int64_t VoxelKey(int64_t in_x, int64_t in_y, int64_t in_z)
+{
+	return ((in_x & 0x1FFFFF) << 42) | ((in_y & 0x1FFFFF) << 21) | (in_z & 0x1FFFFF);
+}
+
+int64_t VoxelKey(float in_x, float in_y, float in_z, double in_inverse_leaf_size)
+{
+	return VoxelKey((int64_t)std::floor(in_x * in_inverse_leaf_size), (int64_t)std::floor(in_y * in_inverse_leaf_size),
+	                (int64_t)std::floor(in_z * in_inverse_leaf_size));
+}
+
+struct Centroid
+{
+	double                              x, y, z;
+	size_t                              count;
+};
+
+}
+
+void ConvertCloud(const sensor_msgs::PointCloud2& in_msg, pcl::PointCloud<pcl::PointXYZ>& out_cloud)
+{
+	const PointCloud2XYZView view(in_msg);
+	if (!view.IsValid())
+	{
+		pcl::fromROSMsg(in_msg, out_cloud);
+		return;
+	}
+
+	out_cloud.clear();
+	out_cloud.reserve(view.Size());
+	view.ForEachPoint([&](float x, float y, float z) { out_cloud.push_back(pcl::PointXYZ(x, y, z)); });
+	out_cloud.header = pcl_conversions::toPCL(in_msg.header);
+	out_cloud.width = out_cloud.size();
+	out_cloud.height = 1;
+	out_cloud.is_dense = true;
+}
+
+void DownsampleCloud(const sensor_msgs::PointCloud2& in_msg, pcl::PointCloud<pcl::PointXYZ>::Ptr out_cloud_ptr,
+                     double in_leaf_size)
+{
+	const PointCloud2XYZView view(in_msg);
+	if (!view.IsValid())
+	{
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
+		pcl::fromROSMsg(in_msg, *cloud);
+		DownsampleCloud(cloud, out_cloud_ptr, in_leaf_size);
+		return;
+	}
+
+	// same grid as pcl::VoxelGrid, aligned on the origin
+	const double inverse_leaf_size = 1.0 / in_leaf_size;
+	std::unordered_map<int64_t, Centroid> voxels;
+	voxels.reserve(view.Size() / 4);
+	view.ForEachPoint([&](float x, float y, float z)
+	{
+		Centroid& centroid = voxels[VoxelKey(x, y, z, inverse_leaf_size)];
+		centroid.x += x;
+		centroid.y += y;
+		centroid.z += z;
+		centroid.count++;
+	});
+
+	out_cloud_ptr->clear();
+	out_cloud_ptr->reserve(voxels.size());
+	for (std::unordered_map<int64_t, Centroid>::const_iterator it = voxels.begin(); it != voxels.end(); ++it)
+	{
+		const Centroid& centroid = it->second;
+		out_cloud_ptr->push_back(pcl::PointXYZ(centroid.x / centroid.count, centroid.y / centroid.count,
+		                                       centroid.z / centroid.count));
+	}
+	out_cloud_ptr->header = pcl_conversions::toPCL(in_msg.header);
+	out_cloud_ptr->width = out_cloud_ptr->size();
+	out_cloud_ptr->height = 1;
+	out_cloud_ptr->is_dense = true;
+}
+
+void OccupiedVoxels(const sensor_msgs::PointCloud2& in_msg, double in_voxel_size,
+                    std::unordered_set<int64_t>& out_voxels)
+{
+	const double inverse_voxel_size = 1.0 / in_voxel_size;
+	out_voxels.clear();
+
+	const PointCloud2XYZView view(in_msg);
+	if (view.IsValid())
+	{
+		view.ForEachPoint([&](float x, float y, float z) { out_voxels.insert(VoxelKey(x, y, z, inverse_voxel_size)); });
+		return;
+	}
+
+	pcl::PointCloud<pcl::PointXYZ> cloud;
+	ConvertCloud(in_msg, cloud);
+	for (size_t i = 0; i < cloud.size(); ++i)
+	{
+		if (std::isfinite(cloud[i].x) && std::isfinite(cloud[i].y) && std::isfinite(cloud[i].z))
+		{
+			out_voxels.insert(VoxelKey(cloud[i].x, cloud[i].y, cloud[i].z, inverse_voxel_size));
+		}
+	}
+}
+
+double VoxelOverlap(const sensor_msgs::PointCloud2& in_msg, const Eigen::Matrix4f& in_transform,
+                    const std::unordered_set<int64_t>& in_voxels, double in_voxel_size, size_t in_max_samples)
+{
+	const double inverse_voxel_size = 1.0 / in_voxel_size;
+	size_t sampled = 0, overlapping = 0;
+
+	auto check = [&](float x, float y, float z)
+	{
+		const Eigen::Vector4f point = in_transform * Eigen::Vector4f(x, y, z, 1.0f);
+		const int64_t voxel_x = (int64_t)std::floor(point[0] * inverse_voxel_size);
+		const int64_t voxel_y = (int64_t)std::floor(point[1] * inverse_voxel_size);
+		const int64_t voxel_z = (int64_t)std::floor(point[2] * inverse_voxel_size);
+
+		// the neighbors too, so that a point near a voxel border is not counted out
+		bool found = false;
+		for (int dx = -1; dx <= 1 && !found; ++dx)
+		{
+			for (int dy = -1; dy <= 1 && !found; ++dy)
+			{
+				for (int dz = -1; dz <= 1 && !found; ++dz)
+				{
+					found = in_voxels.count(VoxelKey(voxel_x + dx, voxel_y + dy, voxel_z + dz)) > 0;
+				}
+			}
+		}
+		sampled++;
+		overlapping += found ? 1 : 0;
+	};
+
+	const PointCloud2XYZView view(in_msg);
+	if (view.IsValid())
+	{
+		view.ForEachPoint(check, std::max<size_t>(1, view.Size() / std::max<size_t>(1, in_max_samples)));
+	}
+	else
+	{
+		pcl::PointCloud<pcl::PointXYZ> cloud;
+		ConvertCloud(in_msg, cloud);
+		const size_t stride = std::max<size_t>(1, cloud.size() / std::max<size_t>(1, in_max_samples));
+		for (size_t i = 0; i < cloud.size(); i += stride)
+		{
+			if (std::isfinite(cloud[i].x) && std::isfinite(cloud[i].y) && std::isfinite(cloud[i].z))
+			{
+				check(cloud[i].x, cloud[i].y, cloud[i].z);
+			}
+		}
+	}
+
+	return sampled ? (double)overlapping / sampled : 0.0;
+}
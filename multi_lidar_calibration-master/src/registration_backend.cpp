@@ -0,0 +1,390 @@
+#include "registration_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <pcl/common/io.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/filters/filter.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/registration/gicp.h>
+#include <pcl/registration/icp.h>
+#include <pcl/search/kdtree.h>
+#include <pclomp/ndt_omp.h>
+
+namespace
+{
+
+typedef RegistrationBackend::PointT         PointT;
+typedef RegistrationBackend::PointCloudT    PointCloudT;
+typedef pcl::PointNormal                    PointNormalT;
+typedef pcl::PointCloud<PointNormalT>       PointNormalCloudT;
+
+// neighbors of the GICP covariances and of the plane normals
+const int NEIGHBORS = 20;
+
+/*!
+ * NDT with shared target cells, one set of cells per level
+ */
+class NdtBackend : public RegistrationBackend
+{
+public:
+	struct NdtTarget : public Target
+	{
+		std::vector<pclomp::VoxelGridCovariance<PointT>::ConstPtr>  cells;
+		pcl::search::KdTree<PointT>::Ptr                            tree;   // for the fitness score
+	};
+
+	NdtBackend(int in_num_threads, pclomp::NeighborSearchMethod in_search_method, double in_step_size) :
+		num_threads_(in_num_threads), search_method_(in_search_method), step_size_(in_step_size)
+	{
+	}
+
+	std::string Name() const { return "NDT"; }
+
+	TargetConstPtr PrepareTarget(PointCloudT::ConstPtr in_cloud, const std::vector<RegistrationLevel>& in_levels) const
+	{
+		std::shared_ptr<NdtTarget> target = std::make_shared<NdtTarget>();
+		target->cloud = in_cloud;
+
+		// levels of the same resolution share their cells
+		for (size_t level = 0; level < in_levels.size(); ++level)
+		{
+			if (level && in_levels[level].resolution == in_levels[level - 1].resolution)
+			{
+				target->cells.push_back(target->cells.back());
+				continue;
+			}
+			pclomp::VoxelGridCovariance<PointT>::Ptr cells (new pclomp::VoxelGridCovariance<PointT>);
+			cells->setLeafSize(in_levels[level].resolution);
+			cells->setInputCloud(in_cloud);
+			cells->filter(search_method_ == pclomp::KDTREE);
+			target->cells.push_back(cells);
+		}
+
+		target->tree.reset(new pcl::search::KdTree<PointT>);
+		target->tree->setInputCloud(in_cloud);
+		return target;
+	}
+
+	void Align(const Target& in_target, size_t in_level, const RegistrationLevel& in_settings,
+	           PointCloudT::ConstPtr in_source, const Eigen::Matrix4f& in_guess,
+	           bool in_compute_fitness, AlignmentResult& out_result) const
+	{
+		const NdtTarget& target = static_cast<const NdtTarget&>(in_target);
+
+		// Initializing Normal Distributions Transform (NDT).
+		pclomp::NormalDistributionsTransform<PointT, PointT> ndt;
+
+		ndt.setNumThreads(num_threads_);
+		ndt.setNeighborhoodSearchMethod(search_method_);
+
+		ndt.setTransformationEpsilon(in_settings.epsilon);
+		ndt.setStepSize(step_size_);
+		ndt.setResolution(in_settings.resolution);
+
+		ndt.setMaximumIterations(in_settings.iterations);
+
+		ndt.setInputSource(in_source);
+
+		// the target cells and search tree are shared, nothing of the target is rebuilt here
+		ndt.setInputTarget(target.cloud, target.cells[in_level]);
+		ndt.setSearchMethodTarget(target.tree, true);
+
+		PointCloudT output_cloud;
+		ndt.align(output_cloud, in_guess);
+
+		out_result.transformation = ndt.getFinalTransformation();
+		out_result.converged = ndt.hasConverged();
+		out_result.iterations = ndt.getFinalNumIteration();
+		out_result.probability = ndt.getTransformationProbability();
+		out_result.fitness = in_compute_fitness ? ndt.getFitnessScore() : 0.0;
+	}
+
+private:
+	int                                 num_threads_;
+	pclomp::NeighborSearchMethod        search_method_;
+	double                              step_size_;
+};
+
+/*!
+ * Generalized ICP [Segal 2009] with the target covariances computed once
+ */
+class GicpBackend : public RegistrationBackend
+{
+	class Gicp : public pcl::GeneralizedIterativeClosestPoint<PointT, PointT>
+	{
+	public:
+		typedef pcl::GeneralizedIterativeClosestPoint<PointT, PointT>::MatricesVector     MatricesVector;
+		typedef pcl::GeneralizedIterativeClosestPoint<PointT, PointT>::MatricesVectorPtr  MatricesVectorPtr;
+
+		void ComputeCovariances(PointCloudT::ConstPtr in_cloud, const pcl::search::KdTree<PointT>::Ptr& in_tree,
+		                        MatricesVector& out_covariances)
+		{
+			computeCovariances<PointT>(in_cloud, in_tree, out_covariances);
+		}
+
+		int getFinalNumIteration() const { return nr_iterations_; }
+	};
+
+public:
+	struct GicpTarget : public Target
+	{
+		pcl::search::KdTree<PointT>::Ptr    tree;
+		Gicp::MatricesVectorPtr             covariances;
+	};
+
+	std::string Name() const { return "GICP"; }
+
+	TargetConstPtr PrepareTarget(PointCloudT::ConstPtr in_cloud, const std::vector<RegistrationLevel>&) const
+	{
+		std::shared_ptr<GicpTarget> target = std::make_shared<GicpTarget>();
+		target->cloud = in_cloud;
+		target->tree.reset(new pcl::search::KdTree<PointT>);
+		target->tree->setInputCloud(in_cloud);
+
+		Gicp gicp;
+		gicp.setCorrespondenceRandomness(NEIGHBORS);
+		target->covariances.reset(new Gicp::MatricesVector);
+		gicp.ComputeCovariances(in_cloud, target->tree, *target->covariances);
+		return target;
+	}
+
+	void Align(const Target& in_target, size_t, const RegistrationLevel& in_settings,
+	           PointCloudT::ConstPtr in_source, const Eigen::Matrix4f& in_guess,
+	           bool in_compute_fitness, AlignmentResult& out_result) const
+	{
+		const GicpTarget& target = static_cast<const GicpTarget&>(in_target);
+
+		Gicp gicp;
+		gicp.setCorrespondenceRandomness(NEIGHBORS);
+		gicp.setMaxCorrespondenceDistance(in_settings.resolution);
+		gicp.setMaximumIterations(in_settings.iterations);
+		gicp.setTransformationEpsilon(in_settings.epsilon * in_settings.epsilon);
+
+		gicp.setInputSource(in_source);
+		gicp.setInputTarget(target.cloud);
+		// set after the target, which resets them
+		gicp.setTargetCovariances(target.covariances);
+		gicp.setSearchMethodTarget(target.tree, true);
+
+		PointCloudT output_cloud;
+		gicp.align(output_cloud, in_guess);
+
+		out_result.transformation = gicp.getFinalTransformation();
+		out_result.converged = gicp.hasConverged();
+		out_result.iterations = gicp.getFinalNumIteration();
+		out_result.probability = 0.0;
+		out_result.fitness = in_compute_fitness ? gicp.getFitnessScore() : 0.0;
+	}
+};
+
+/*!
+ * Point to plane ICP, with the normals of the target estimated once
+ */
+class PointToPlaneBackend : public RegistrationBackend
+{
+	class Icp : public pcl::IterativeClosestPointWithNormals<PointNormalT, PointNormalT>
+	{
+	public:
+		int getFinalNumIteration() const { return nr_iterations_; }
+	};
+
+public:
+	struct PointToPlaneTarget : public Target
+	{
+		PointNormalCloudT::ConstPtr                 normals;
+		pcl::search::KdTree<PointNormalT>::Ptr      tree;
+	};
+
+	explicit PointToPlaneBackend(int in_num_threads) : num_threads_(in_num_threads)
+	{
+	}
+
+	std::string Name() const { return "POINT_TO_PLANE"; }
+
+	TargetConstPtr PrepareTarget(PointCloudT::ConstPtr in_cloud, const std::vector<RegistrationLevel>&) const
+	{
+		pcl::search::KdTree<PointT>::Ptr tree (new pcl::search::KdTree<PointT>);
+		tree->setInputCloud(in_cloud);
+
+		pcl::PointCloud<pcl::Normal> normals;
+		pcl::NormalEstimationOMP<PointT, pcl::Normal> estimation(num_threads_);
+		estimation.setInputCloud(in_cloud);
+		estimation.setSearchMethod(tree);
+		estimation.setKSearch(NEIGHBORS);
+		estimation.compute(normals);
+
+		// points without a plane are left out
+		PointNormalCloudT::Ptr with_normals (new PointNormalCloudT);
+		pcl::concatenateFields(*in_cloud, normals, *with_normals);
+		std::vector<int> valid;
+		pcl::removeNaNNormalsFromPointCloud(*with_normals, *with_normals, valid);
+
+		std::shared_ptr<PointToPlaneTarget> target = std::make_shared<PointToPlaneTarget>();
+		target->cloud = in_cloud;
+		target->normals = with_normals;
+		target->tree.reset(new pcl::search::KdTree<PointNormalT>);
+		target->tree->setInputCloud(with_normals);
+		return target;
+	}
+
+	void Align(const Target& in_target, size_t, const RegistrationLevel& in_settings,
+	           PointCloudT::ConstPtr in_source, const Eigen::Matrix4f& in_guess,
+	           bool in_compute_fitness, AlignmentResult& out_result) const
+	{
+		const PointToPlaneTarget& target = static_cast<const PointToPlaneTarget&>(in_target);
+
+		// the normals of the source are not used by the point to plane error
+		PointNormalCloudT::Ptr source (new PointNormalCloudT);
+		pcl::copyPointCloud(*in_source, *source);
+
+		Icp icp;
+		icp.setMaxCorrespondenceDistance(in_settings.resolution);
+		icp.setMaximumIterations(in_settings.iterations);
+		icp.setTransformationEpsilon(in_settings.epsilon * in_settings.epsilon);
+
+		icp.setInputSource(source);
+		icp.setInputTarget(target.normals);
+		icp.setSearchMethodTarget(target.tree, true);
+
+		PointNormalCloudT output_cloud;
+		icp.align(output_cloud, in_guess);
+
+		out_result.transformation = icp.getFinalTransformation();
+		out_result.converged = icp.hasConverged();
+		out_result.iterations = icp.getFinalNumIteration();
+		out_result.probability = 0.0;
+		out_result.fitness = in_compute_fitness ? icp.getFitnessScore() : 0.0;
+	}
+
+private:
+	int                                 num_threads_;
+};
+
+}  // namespace
+
+void RegistrationBackend::AlignPyramid(const Target& in_target, const std::vector<RegistrationLevel>& in_levels,
+                                       PointCloudT::ConstPtr in_source, const Eigen::Matrix4f& in_guess,
+                                       AlignmentResult& out_result) const
+{
+	std::ostringstream levels;
+	levels << std::fixed << std::setprecision(1);
+
+	out_result.transformation = in_guess;
+	out_result.converged = false;
+	out_result.iterations = 0;
+	out_result.fitness = 0.0;
+	out_result.probability = 0.0;
+
+	PointCloudT::Ptr filtered_source;
+	double filtered_voxel_size = 0.0;
+
+	for (size_t level = 0; level < in_levels.size(); ++level)
+	{
+		const RegistrationLevel& settings = in_levels[level];
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		if (!filtered_source || settings.voxel_size != filtered_voxel_size)
+		{
+			filtered_source.reset(new PointCloudT);
+			DownsampleCloud(in_source, filtered_source, settings.voxel_size);
+			filtered_voxel_size = settings.voxel_size;
+		}
+
+		AlignmentResult level_result;
+		Align(in_target, level, settings, filtered_source, out_result.transformation,
+		      level + 1 == in_levels.size(), level_result);
+
+		out_result.transformation = level_result.transformation;
+		out_result.converged = level_result.converged;
+		out_result.iterations += level_result.iterations;
+		out_result.probability = level_result.probability;
+		out_result.fitness = level_result.fitness;
+
+		levels << (level ? "; " : "") << "resolution " << settings.resolution << " m: "
+		       << level_result.iterations << " iterations in "
+		       << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+		       << " ms";
+	}
+
+	out_result.levels = levels.str();
+}
+
+std::vector<std::string> RegistrationBackend::Methods()
+{
+	std::vector<std::string> methods;
+	methods.push_back("NDT");
+	methods.push_back("GICP");
+	methods.push_back("POINT_TO_PLANE");
+	return methods;
+}
+
+RegistrationBackend::ConstPtr RegistrationBackend::Create(const std::string& in_method, int in_num_threads,
+                                                          pclomp::NeighborSearchMethod in_search_method,
+                                                          double in_ndt_step_size)
+{
+	if (in_method == "NDT")
+	{
+		return std::make_shared<NdtBackend>(in_num_threads, in_search_method, in_ndt_step_size);
+	}
+	if (in_method == "GICP")
+	{
+		return std::make_shared<GicpBackend>();
+	}
+	if (in_method == "POINT_TO_PLANE")
+	{
+		return std::make_shared<PointToPlaneBackend>(in_num_threads);
+	}
+	return ConstPtr();
+}
+
+std::vector<RegistrationLevel> DefaultRegistrationLevels()
+{
+	const RegistrationLevel levels[] = {{0.4, 1.6, 30, 0.05},
+	                                    {0.2, 0.8, 30, 0.05},
+	                                    {0.1, 0.2, 200, 0.05}};
+	return std::vector<RegistrationLevel>(levels, levels + 3);
+}
+
+void DownsampleCloud(RegistrationBackend::PointCloudT::ConstPtr in_cloud_ptr,
+                     RegistrationBackend::PointCloudT::Ptr out_cloud_ptr, double in_leaf_size)
+{
+	pcl::VoxelGrid<PointT> voxelized;
+	voxelized.setInputCloud(in_cloud_ptr);
+	voxelized.setLeafSize((float)in_leaf_size, (float)in_leaf_size, (float)in_leaf_size);
+	voxelized.filter(*out_cloud_ptr);
+}
+
+Eigen::Matrix4f XyzyprToMatrix(const std::vector<double>& in_xyzypr)
+{
+	Eigen::Translation3f translation(in_xyzypr[0], in_xyzypr[1], in_xyzypr[2]);
+	Eigen::AngleAxisf rotation_x(in_xyzypr[5], Eigen::Vector3f::UnitX());
+	Eigen::AngleAxisf rotation_y(in_xyzypr[4], Eigen::Vector3f::UnitY());
+	Eigen::AngleAxisf rotation_z(in_xyzypr[3], Eigen::Vector3f::UnitZ());
+
+	return (translation * rotation_z * rotation_y * rotation_x).matrix();
+}
+
+std::vector<double> MatrixToXyzypr(const Eigen::Matrix4f& in_transform)
+{
+	std::vector<double> xyzypr(6);
+	xyzypr[0] = in_transform(0, 3);
+	xyzypr[1] = in_transform(1, 3);
+	xyzypr[2] = in_transform(2, 3);
+	xyzypr[3] = std::atan2(in_transform(1, 0), in_transform(0, 0));
+	xyzypr[4] = std::asin(std::max(-1.0f, std::min(1.0f, -in_transform(2, 0))));
+	xyzypr[5] = std::atan2(in_transform(2, 1), in_transform(2, 2));
+	return xyzypr;
+}
+
+void TransformDelta(const Eigen::Matrix4f& in_a, const Eigen::Matrix4f& in_b,
+                    double& out_translation, double& out_rotation)
+{
+	out_translation = (in_a.block<3, 1>(0, 3) - in_b.block<3, 1>(0, 3)).norm();
+
+	const Eigen::Matrix3f rotation = in_a.block<3, 3>(0, 0).transpose() * in_b.block<3, 3>(0, 0);
+	out_rotation = Eigen::AngleAxisf(rotation).angle();
+}
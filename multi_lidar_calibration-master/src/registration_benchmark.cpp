@@ -0,0 +1,238 @@
+/*
+ * Compares the registration backends on recorded parent/child cloud pairs.
+ *
+ * Usage: registration_benchmark <pairs_file> [num_threads]
+ *
+ * The pairs file holds one entry per line, # starts a comment:
+ *   reference x y z yaw pitch roll             known transformation of the child to the parent
+ *   guess x y z yaw pitch roll                 initial guess of every alignment
+ *   level voxel_size resolution iterations epsilon   one pyramid level, coarse to fine
+ *   pair parent.pcd child.pcd                  relative to the directory of the pairs file
+ * Without level lines the pyramid of multi_lidar_calibrator.launch is used.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pcl/io/pcd_io.h>
+
+#include "registration_backend.h"
+
+namespace
+{
+
+struct BenchmarkSettings
+{
+	Eigen::Matrix4f                     reference;
+	Eigen::Matrix4f                     guess;
+	std::vector<RegistrationLevel>      levels;
+	std::vector<std::pair<std::string, std::string> > pairs;
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+bool ReadXyzypr(std::istringstream& in_line, Eigen::Matrix4f& out_transform)
+{
+	std::vector<double> xyzypr(6);
+	for (size_t i = 0; i < xyzypr.size(); ++i)
+	{
+		if (!(in_line >> xyzypr[i]))
+		{
+			return false;
+		}
+	}
+	out_transform = XyzyprToMatrix(xyzypr);
+	return true;
+}
+
+std::string ResolvePath(const std::string& in_directory, const std::string& in_path)
+{
+	if (in_path.empty() || in_path[0] == '/' || in_directory.empty())
+	{
+		return in_path;
+	}
+	return in_directory + "/" + in_path;
+}
+
+bool ReadSettings(const std::string& in_path, BenchmarkSettings& out_settings)
+{
+	std::ifstream file(in_path.c_str());
+	if (!file)
+	{
+		std::cerr << "Cannot open " << in_path << std::endl;
+		return false;
+	}
+
+	const size_t slash = in_path.rfind('/');
+	const std::string directory = slash == std::string::npos ? std::string() : in_path.substr(0, slash);
+
+	out_settings.reference = Eigen::Matrix4f::Identity();
+	out_settings.guess = Eigen::Matrix4f::Identity();
+	bool has_reference = false;
+
+	std::string line;
+	for (int line_number = 1; std::getline(file, line); ++line_number)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream line_stream(line);
+		std::string key;
+		if (!(line_stream >> key))
+		{
+			continue;
+		}
+
+		bool valid = true;
+		if (key == "reference")
+		{
+			valid = ReadXyzypr(line_stream, out_settings.reference);
+			has_reference = valid;
+		}
+		else if (key == "guess")
+		{
+			valid = ReadXyzypr(line_stream, out_settings.guess);
+		}
+		else if (key == "level")
+		{
+			RegistrationLevel level;
+			valid = static_cast<bool>(line_stream >> level.voxel_size >> level.resolution >> level.iterations
+			                                      >> level.epsilon);
+			if (valid)
+			{
+				out_settings.levels.push_back(level);
+			}
+		}
+		else if (key == "pair")
+		{
+			std::string parent, child;
+			valid = static_cast<bool>(line_stream >> parent >> child);
+			if (valid)
+			{
+				out_settings.pairs.push_back(std::make_pair(ResolvePath(directory, parent),
+				                                            ResolvePath(directory, child)));
+			}
+		}
+		else
+		{
+			valid = false;
+		}
+
+		if (!valid)
+		{
+			std::cerr << in_path << ":" << line_number << ": cannot parse \"" << line << "\"" << std::endl;
+			return false;
+		}
+	}
+
+	if (!has_reference)
+	{
+		std::cerr << in_path << ": no reference transformation" << std::endl;
+		return false;
+	}
+	if (out_settings.pairs.empty())
+	{
+		std::cerr << in_path << ": no pair" << std::endl;
+		return false;
+	}
+	if (out_settings.levels.empty())
+	{
+		out_settings.levels = DefaultRegistrationLevels();
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <pairs_file> [num_threads]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	BenchmarkSettings settings;
+	if (!ReadSettings(argv[1], settings))
+	{
+		return EXIT_FAILURE;
+	}
+	const int num_threads = argc > 2 ? std::atoi(argv[2]) : 0;
+
+	typedef RegistrationBackend::PointCloudT PointCloudT;
+	std::vector<PointCloudT::Ptr> parent_clouds, child_clouds;
+	for (size_t i = 0; i < settings.pairs.size(); ++i)
+	{
+		PointCloudT::Ptr parent_cloud(new PointCloudT), child_cloud(new PointCloudT);
+		if (pcl::io::loadPCDFile<RegistrationBackend::PointT>(settings.pairs[i].first, *parent_cloud) < 0
+		    || pcl::io::loadPCDFile<RegistrationBackend::PointT>(settings.pairs[i].second, *child_cloud) < 0)
+		{
+			std::cerr << "Cannot load the pair " << settings.pairs[i].first << " "
+			          << settings.pairs[i].second << std::endl;
+			return EXIT_FAILURE;
+		}
+		parent_clouds.push_back(parent_cloud);
+		child_clouds.push_back(child_cloud);
+	}
+
+	std::cout << settings.pairs.size() << " pairs, " << settings.levels.size() << " levels, "
+	          << (num_threads > 0 ? std::to_string(num_threads) : std::string("all")) << " threads" << std::endl;
+	std::cout << std::left << std::setw(16) << "method"
+	          << std::right << std::setw(10) << "mean ms" << std::setw(10) << "max ms"
+	          << std::setw(12) << "iterations" << std::setw(12) << "mean t m" << std::setw(12) << "max t m"
+	          << std::setw(12) << "mean r rad" << std::setw(12) << "max r rad"
+	          << std::setw(11) << "converged" << std::endl;
+
+	const std::vector<std::string> methods = RegistrationBackend::Methods();
+	for (size_t m = 0; m < methods.size(); ++m)
+	{
+		const RegistrationBackend::ConstPtr backend =
+				RegistrationBackend::Create(methods[m], num_threads, pclomp::KDTREE, 0.1);
+
+		double total_ms = 0., max_ms = 0.;
+		double total_translation = 0., max_translation = 0.;
+		double total_rotation = 0., max_rotation = 0.;
+		int total_iterations = 0, converged_count = 0;
+
+		for (size_t i = 0; i < settings.pairs.size(); ++i)
+		{
+			// the target is built once per parent cloud by the calibrator too, so it is part of the runtime
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			const RegistrationBackend::TargetConstPtr target =
+					backend->PrepareTarget(parent_clouds[i], settings.levels);
+			AlignmentResult result;
+			backend->AlignPyramid(*target, settings.levels, child_clouds[i], settings.guess, result);
+
+			const double elapsed_ms =
+					std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			double translation_error, rotation_error;
+			TransformDelta(settings.reference, result.transformation, translation_error, rotation_error);
+
+			total_ms += elapsed_ms;
+			max_ms = std::max(max_ms, elapsed_ms);
+			total_translation += translation_error;
+			max_translation = std::max(max_translation, translation_error);
+			total_rotation += rotation_error;
+			max_rotation = std::max(max_rotation, rotation_error);
+			total_iterations += result.iterations;
+			converged_count += result.converged ? 1 : 0;
+		}
+
+		const double pair_count = static_cast<double>(settings.pairs.size());
+		std::cout << std::left << std::setw(16) << backend->Name() << std::right << std::fixed
+		          << std::setprecision(1) << std::setw(10) << total_ms / pair_count << std::setw(10) << max_ms
+		          << std::setw(12) << total_iterations / pair_count
+		          << std::setprecision(4) << std::setw(12) << total_translation / pair_count
+		          << std::setw(12) << max_translation
+		          << std::setw(12) << total_rotation / pair_count << std::setw(12) << max_rotation
+		          << std::setw(7) << converged_count << "/" << settings.pairs.size() << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
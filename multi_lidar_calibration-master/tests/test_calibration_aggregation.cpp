@@ -0,0 +1,136 @@
+#include <cmath>
+#include <gtest/gtest.h>
+
+#include "calibration_aggregation.h"
+#include "registration_backend.h"
+
+namespace
+{
+
+Eigen::Matrix4f Transform(double in_x, double in_y, double in_z, double in_yaw)
+{
+	std::vector<double> xyzypr(6, 0.0);
+	xyzypr[0] = in_x;
+	xyzypr[1] = in_y;
+	xyzypr[2] = in_z;
+	xyzypr[3] = in_yaw;
+	return XyzyprToMatrix(xyzypr);
+}
+
+}
+
+TEST(PairFrames, nearestParentWithinMaxTimeDiff)
+{
+	std::vector<double> parent_stamps;
+	parent_stamps.push_back(10.0);
+	parent_stamps.push_back(10.1);
+	parent_stamps.push_back(10.2);
+	parent_stamps.push_back(10.3);
+
+	std::vector<double> child_stamps;
+	child_stamps.push_back(9.8);    // before the parent recording
+	child_stamps.push_back(10.01);
+	child_stamps.push_back(10.14);
+	child_stamps.push_back(10.26);
+	child_stamps.push_back(10.5);   // after it
+
+	const std::vector<FramePair> pairs = PairFrames(2, parent_stamps, child_stamps, 0.05, 100);
+	ASSERT_EQ(3u, pairs.size());
+	EXPECT_EQ(2u, pairs[0].child);
+	EXPECT_EQ(1u, pairs[0].child_frame);
+	EXPECT_EQ(0u, pairs[0].parent_frame);
+	EXPECT_EQ(2u, pairs[1].child_frame);
+	EXPECT_EQ(1u, pairs[1].parent_frame);
+	EXPECT_EQ(3u, pairs[2].child_frame);
+	EXPECT_EQ(3u, pairs[2].parent_frame);
+
+	// halfway between two parent frames, both too far
+	EXPECT_TRUE(PairFrames(0, parent_stamps, std::vector<double>(1, 10.15), 0.04, 100).empty());
+	EXPECT_TRUE(PairFrames(0, std::vector<double>(), child_stamps, 1.0, 100).empty());
+}
+
+TEST(PairFrames, spreadOverTheRecording)
+{
+	std::vector<double> stamps;
+	for (int i = 0; i < 100; ++i)
+	{
+		stamps.push_back(i * 0.1);
+	}
+
+	const std::vector<FramePair> pairs = PairFrames(0, stamps, stamps, 0.01, 10);
+	ASSERT_EQ(10u, pairs.size());
+	for (size_t k = 0; k < pairs.size(); ++k)
+	{
+		EXPECT_EQ(k * 10, pairs[k].child_frame);
+		EXPECT_EQ(k * 10, pairs[k].parent_frame);
+	}
+}
+
+TEST(AggregateTransforms, outliersRejected)
+{
+	TransformVector transforms;
+	transforms.push_back(Transform(1.00, 2.0, 0.5, 0.100));
+	transforms.push_back(Transform(1.01, 2.0, 0.5, 0.102));
+	transforms.push_back(Transform(0.99, 2.0, 0.5, 0.098));
+	transforms.push_back(Transform(3.00, 2.0, 0.5, 0.100));
+	transforms.push_back(Transform(1.00, 2.0, 0.5, 0.500));
+
+	Eigen::Matrix4f extrinsic = Eigen::Matrix4f::Identity();
+	double translation_spread, rotation_spread;
+	EXPECT_EQ(3u, AggregateTransforms(transforms, 0.05, 0.01, extrinsic, translation_spread, rotation_spread));
+
+	double translation, rotation;
+	TransformDelta(Transform(1.0, 2.0, 0.5, 0.1), extrinsic, translation, rotation);
+	EXPECT_LT(translation, 1e-4);
+	EXPECT_LT(rotation, 1e-4);
+	EXPECT_NEAR(0.01, translation_spread, 1e-4);
+	EXPECT_NEAR(0.002, rotation_spread, 1e-4);
+}
+
+TEST(AggregateTransforms, quaternionSignWrap)
+{
+	// the quaternions of a matrix change sign when its trace crosses 0, at a yaw of -2 pi / 3 about z
+	const double yaw = -2.0 * M_PI / 3.0;
+	TransformVector transforms;
+	transforms.push_back(Transform(1.0, 2.0, 0.5, yaw - 0.002));
+	transforms.push_back(Transform(1.0, 2.0, 0.5, yaw + 0.002));
+	transforms.push_back(Transform(1.0, 2.0, 0.5, yaw - 0.001));
+	transforms.push_back(Transform(1.0, 2.0, 0.5, yaw + 0.001));
+
+	Eigen::Matrix4f extrinsic = Eigen::Matrix4f::Identity();
+	double translation_spread, rotation_spread;
+	EXPECT_EQ(4u, AggregateTransforms(transforms, 0.05, 0.01, extrinsic, translation_spread, rotation_spread));
+
+	double translation, rotation;
+	TransformDelta(Transform(1.0, 2.0, 0.5, yaw), extrinsic, translation, rotation);
+	EXPECT_LT(translation, 1e-4);
+	EXPECT_LT(rotation, 1e-3);
+	EXPECT_NEAR(0.002, rotation_spread, 1e-3);
+}
+
+TEST(AggregateTransforms, emptyInlierSet)
+{
+	const Eigen::Matrix4f guess = Transform(0.1, 0.2, 0.3, 0.4);
+	Eigen::Matrix4f extrinsic = guess;
+	double translation_spread = 1.0, rotation_spread = 1.0;
+
+	// every alignment is far from the median translation (1, 0, 0)
+	TransformVector transforms;
+	transforms.push_back(Transform(0.0, 0.0, 0.0, 0.0));
+	transforms.push_back(Transform(1.0, 1.0, 0.0, 0.0));
+	transforms.push_back(Transform(2.0, 0.0, 1.0, 0.0));
+	EXPECT_EQ(0u, AggregateTransforms(transforms, 0.05, 0.01, extrinsic, translation_spread, rotation_spread));
+	EXPECT_TRUE(extrinsic == guess);
+	EXPECT_EQ(0.0, translation_spread);
+	EXPECT_EQ(0.0, rotation_spread);
+
+	EXPECT_EQ(0u, AggregateTransforms(TransformVector(), 0.05, 0.01, extrinsic, translation_spread,
+	                                  rotation_spread));
+	EXPECT_TRUE(extrinsic == guess);
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -40,6 +40,7 @@
 #include <dynamic_reconfigure/server.h>
 
 #include <velodyne_driver/input.h>
+#include <velodyne_driver/view_culling.h>
 #include <velodyne_driver/VelodyneNodeConfig.h>
 
 namespace velodyne_driver
@@ -61,6 +62,8 @@ private:
               uint32_t level);
   // Callback for diagnostics update for lost communication with vlp
   void diagTimerCallback(const ros::TimerEvent&event);
+  // true unless every block of the packet is outside the view
+  bool packetInView(const velodyne_msgs::VelodynePacket &packet) const;
 
   // Pointer to dynamic reconfigure service srv_
   boost::shared_ptr<dynamic_reconfigure::Server<velodyne_driver::
@@ -77,12 +80,16 @@ private:
     double time_offset;              // time in seconds added to each velodyne time stamp
     bool enabled;                    // polling is enabled
     bool timestamp_first_packet;
+    bool cull_view;                  // drop packets outside the view
+    int view_min_angle;              // start of the view in 1/100°
+    int view_max_angle;              // end of the view in 1/100°
   }
   config_;
 
   boost::shared_ptr<Input> input_;
   ros::Publisher output_;
   int last_azimuth_;
+  uint64_t culled_scans_;            // scans with every packet outside the view
 
   /* diagnostics updater */
   ros::Timer diag_timer_;
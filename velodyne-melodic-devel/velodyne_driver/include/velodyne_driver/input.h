@@ -87,7 +87,9 @@ public:
                         const double time_offset) = 0;
 
 protected:
-  ros::NodeHandle private_nh_;
+  /** @brief Constructor without the parameter server. */
+  Input(uint16_t port, const std::string& devip, bool gps_time);
+
   uint16_t port_;
   std::string devip_str_;
   bool gps_time_;
@@ -126,6 +128,19 @@ public:
             bool read_once = false,
             bool read_fast = false,
             double repeat_delay = 0.0);
+
+  /** @brief Offline reader configured without the parameter server.
+   *
+   *  Needs neither a ROS node nor a master, for tools that read
+   *  captures in-process. Only ros::Time::init() must have been called.
+   */
+  InputPCAP(const std::string& filename,
+            uint16_t port,
+            double packet_rate,
+            bool read_once,
+            bool read_fast,
+            double repeat_delay = 0.0,
+            const std::string& devip = "");
   virtual ~InputPCAP();
 
   virtual int getPacket(velodyne_msgs::VelodynePacket *pkt,
@@ -133,6 +148,8 @@ public:
   void setDeviceIP(const std::string& ip);
 
 private:
+  void openFile(uint16_t port);
+
   ros::Rate packet_rate_;
   std::string filename_;
   pcap_t *pcap_;
@@ -0,0 +1,94 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Culling of the packets outside the view of the point cloud nodes.
+ */
+
+#ifndef VELODYNE_DRIVER_VIEW_CULLING_H
+#define VELODYNE_DRIVER_VIEW_CULLING_H
+
+#include <cmath>
+#include <velodyne_msgs/VelodynePacket.h>
+
+namespace velodyne_driver
+{
+
+/** @brief convert a view to packet rotations
+ *
+ *  Uses the view definition of the velodyne_pointcloud nodes, in
+ *  radians, and gives its first and last rotation in 1/100°.
+ *
+ *  @returns false when the view is the whole revolution
+ */
+inline bool packetView(double view_direction, double view_width,
+                       int *view_min_angle, int *view_max_angle)
+{
+  if (view_width <= 0.0 || view_width >= 2*M_PI)
+    return false;
+
+  double min_angle = fmod(fmod(view_direction + view_width/2, 2*M_PI) + 2*M_PI, 2*M_PI);
+  double max_angle = fmod(fmod(view_direction - view_width/2, 2*M_PI) + 2*M_PI, 2*M_PI);
+  *view_min_angle = int(100 * (2*M_PI - min_angle) * 180 / M_PI + 0.5) % 36000;
+  *view_max_angle = int(100 * (2*M_PI - max_angle) * 180 / M_PI + 0.5) % 36000;
+  return true;
+}
+
+/** @brief check a packet against a view of packetView()
+ *
+ *  The blocks of a packet cover the arc from the rotation of the first
+ *  block to about one block step past the last one.
+ *
+ *  @returns true unless every block of the packet is outside the view
+ */
+inline bool packetInView(const velodyne_msgs::VelodynePacket &packet,
+                         int view_min_angle, int view_max_angle)
+{
+  // rotation of the first and last of the 12 blocks of 100 bytes
+  const int first = packet.data[2] | (packet.data[3] << 8);
+  const int last = packet.data[1102] | (packet.data[1103] << 8);
+  const int span = ((last - first) % 36000 + 36000) % 36000;
+  if (span >= 18000)                    // not a regular packet
+    return true;
+  const int length = span + span / 11 + 1;
+
+  // two arcs intersect if either contains the start of the other
+  const int view_length = ((view_max_angle - view_min_angle) % 36000 + 36000) % 36000;
+  const int first_in_view = ((first - view_min_angle) % 36000 + 36000) % 36000;
+  const int view_in_packet = ((view_min_angle - first) % 36000 + 36000) % 36000;
+  return first_in_view <= view_length || view_in_packet <= length;
+}
+
+}  // namespace velodyne_driver
+
+#endif  // VELODYNE_DRIVER_VIEW_CULLING_H
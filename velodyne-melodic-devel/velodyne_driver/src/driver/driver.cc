@@ -140,6 +140,20 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
   // which is used in velodyne packets
   config_.cut_angle = int((cut_angle*360/(2*M_PI))*100);
 
+  // Packets entirely outside this view are dropped before publishing,
+  // using the same view definition as the velodyne_pointcloud nodes.
+  double view_direction, view_width;
+  private_nh.param("view_direction", view_direction, 0.0);
+  private_nh.param("view_width", view_width, 2*M_PI);
+  config_.cull_view = packetView(view_direction, view_width,
+                                 &config_.view_min_angle,
+                                 &config_.view_max_angle);
+  if (config_.cull_view)
+  {
+    ROS_INFO_STREAM("Dropping packets outside a view of " << view_width
+                    << " rad around " << view_direction << " rad.");
+  }
+
   int udp_port;
   private_nh.param("port", udp_port, (int) DATA_PORT_NUMBER);
 
@@ -186,6 +200,7 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
     node.advertise<velodyne_msgs::VelodyneScan>("velodyne_packets", 10);
 
   last_azimuth_ = -1;
+  culled_scans_ = 0;
 }
 
 /** poll the device
@@ -216,7 +231,8 @@ bool VelodyneDriver::poll(void)
         if (rc == 0) break;       // got a full packet?
         if (rc < 0) return false; // end of file reached?
       }
-      scan->packets.push_back(tmp_packet);
+      if (packetInView(tmp_packet))
+        scan->packets.push_back(tmp_packet);
 
       // Extract base rotation of first block in packet
       std::size_t azimuth_data_pos = 100*0+2;
@@ -242,16 +258,28 @@ bool VelodyneDriver::poll(void)
   // Since the velodyne delivers data at a very high rate, keep
   // reading and publishing scans as fast as possible.
     scan->packets.resize(config_.npackets);
+    int kept = 0;
     for (int i = 0; i < config_.npackets; ++i)
     {
       while (true)
         {
           // keep reading until full packet received
-          int rc = input_->getPacket(&scan->packets[i], config_.time_offset);
+          int rc = input_->getPacket(&scan->packets[kept], config_.time_offset);
           if (rc == 0) break;       // got a full packet?
           if (rc < 0) return false; // end of file reached?
         }
+      if (packetInView(scan->packets[kept]))
+        ++kept;
     }
+    scan->packets.resize(kept);
+  }
+
+  if (scan->packets.empty())            // whole scan outside the view
+  {
+    ++culled_scans_;
+    ROS_DEBUG_THROTTLE(1.0, "Dropped a scan with no packet in the view"
+                       " (%lu so far).", (unsigned long) culled_scans_);
+    return true;
   }
 
   // publish message using time of last packet read
@@ -287,6 +315,15 @@ void VelodyneDriver::callback(velodyne_driver::VelodyneNodeConfig &config,
   }
 }
 
+/** @brief check the packet against the view, see packetInView() */
+bool VelodyneDriver::packetInView(const velodyne_msgs::VelodynePacket &packet) const
+{
+  if (!config_.cull_view)
+    return true;
+  return velodyne_driver::packetInView(packet, config_.view_min_angle,
+                                       config_.view_max_angle);
+}
+
 void VelodyneDriver::diagTimerCallback(const ros::TimerEvent &event)
 {
   (void)event;
@@ -71,7 +71,6 @@ namespace velodyne_driver
    *  @param port UDP port number.
    */
   Input::Input(ros::NodeHandle private_nh, uint16_t port):
-    private_nh_(private_nh),
     port_(port)
   {
     private_nh.param("device_ip", devip_str_, std::string(""));
@@ -81,6 +80,22 @@ namespace velodyne_driver
                       << devip_str_);
   }
 
+  /** @brief constructor
+   *
+   *  @param port UDP port number.
+   *  @param devip only accept packets from this IP address, if not empty.
+   *  @param gps_time use the GPS time of the packets.
+   */
+  Input::Input(uint16_t port, const std::string& devip, bool gps_time):
+    port_(port),
+    devip_str_(devip),
+    gps_time_(gps_time)
+  {
+    if (!devip_str_.empty())
+      ROS_INFO_STREAM("Only accepting packets from IP address: "
+                      << devip_str_);
+  }
+
   ////////////////////////////////////////////////////////////////////////
   // InputSocket class implementation
   ////////////////////////////////////////////////////////////////////////
@@ -263,6 +278,37 @@ namespace velodyne_driver
     private_nh.param("read_fast", read_fast_, false);
     private_nh.param("repeat_delay", repeat_delay_, 0.0);
 
+    openFile(port);
+  }
+
+  /** @brief constructor
+   *
+   *  @param filename PCAP dump file name
+   *  @param port UDP port number
+   *  @param packet_rate expected device packet frequency (Hz)
+   *  @param read_once stop at the end of the file
+   *  @param read_fast do not pace packets at packet_rate
+   *  @param repeat_delay seconds to wait before repeating the file
+   *  @param devip only accept packets from this IP address, if not empty
+   */
+  InputPCAP::InputPCAP(const std::string& filename, uint16_t port,
+                       double packet_rate, bool read_once, bool read_fast,
+                       double repeat_delay, const std::string& devip):
+    Input(port, devip, false),
+    packet_rate_(packet_rate),
+    filename_(filename),
+    read_once_(read_once),
+    read_fast_(read_fast),
+    repeat_delay_(repeat_delay)
+  {
+    pcap_ = NULL;
+    empty_ = true;
+    openFile(port);
+  }
+
+  /** @brief Open the dump file and compile the packet filter. */
+  void InputPCAP::openFile(uint16_t port)
+  {
     if (read_once_)
       ROS_INFO("Read input file only once.");
     if (read_fast_)
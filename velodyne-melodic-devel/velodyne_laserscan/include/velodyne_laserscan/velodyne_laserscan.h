@@ -37,6 +37,8 @@
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/LaserScan.h>
 
+#include <vector>
+
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
 
@@ -55,11 +57,17 @@ private:
   boost::mutex connect_mutex_;
   void connectCb();
   void recvCallback(const sensor_msgs::PointCloud2ConstPtr& msg);
+  uint16_t selectRing() const;
+  bool subscribed() const;
 
   ros::NodeHandle nh_;
   ros::Subscriber sub_;
   ros::Publisher pub_;
 
+  // rings published together on per-ring topics, instead of 'scan'
+  std::vector<int> rings_;
+  std::vector<ros::Publisher> ring_pubs_;
+
   VelodyneLaserScanConfig cfg_;
   dynamic_reconfigure::Server<VelodyneLaserScanConfig> srv_;
   void reconfig(VelodyneLaserScanConfig& config, uint32_t level);
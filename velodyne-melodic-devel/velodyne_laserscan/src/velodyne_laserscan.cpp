@@ -33,6 +33,10 @@
 #include "velodyne_laserscan/velodyne_laserscan.h"
 #include <sensor_msgs/point_cloud2_iterator.h>
 
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
 namespace velodyne_laserscan
 {
 
@@ -40,15 +44,49 @@ VelodyneLaserScan::VelodyneLaserScan(ros::NodeHandle &nh, ros::NodeHandle &nh_pr
     nh_(nh), srv_(nh_priv), ring_count_(0)
 {
   ros::SubscriberStatusCallback connect_cb = boost::bind(&VelodyneLaserScan::connectCb, this);
-  pub_ = nh.advertise<sensor_msgs::LaserScan>("scan", 10, connect_cb, connect_cb);
+
+  std::vector<int> rings;
+  nh_priv.getParam("rings", rings);
+  for (size_t i = 0; i < rings.size(); i++)
+  {
+    if ((rings[i] < 0) || (std::find(rings_.begin(), rings_.end(), rings[i]) != rings_.end()))
+    {
+      ROS_WARN("VelodyneLaserScan: Ignoring ring %d in parameter 'rings'", rings[i]);
+      continue;
+    }
+    std::ostringstream topic;
+    topic << "scan_ring_" << rings[i];
+    rings_.push_back(rings[i]);
+    ring_pubs_.push_back(nh.advertise<sensor_msgs::LaserScan>(topic.str(), 10, connect_cb, connect_cb));
+  }
+  if (rings_.empty())
+  {
+    pub_ = nh.advertise<sensor_msgs::LaserScan>("scan", 10, connect_cb, connect_cb);
+  }
 
   srv_.setCallback(boost::bind(&VelodyneLaserScan::reconfig, this, _1, _2));
 }
 
+bool VelodyneLaserScan::subscribed() const
+{
+  if (pub_.getNumSubscribers())
+  {
+    return true;
+  }
+  for (size_t i = 0; i < ring_pubs_.size(); i++)
+  {
+    if (ring_pubs_[i].getNumSubscribers())
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
 void VelodyneLaserScan::connectCb()
 {
   boost::lock_guard<boost::mutex> lock(connect_mutex_);
-  if (!pub_.getNumSubscribers())
+  if (!subscribed())
   {
     sub_.shutdown();
   }
@@ -58,6 +96,59 @@ void VelodyneLaserScan::connectCb()
   }
 }
 
+uint16_t VelodyneLaserScan::selectRing() const
+{
+  uint16_t ring;
+
+  if ((cfg_.ring < 0) || (cfg_.ring >= ring_count_))
+  {
+    // Default to ring closest to being level for each known sensor
+    if (ring_count_ > 32)
+    {
+      ring = 57;  // HDL-64E
+    }
+    else if (ring_count_ > 16)
+    {
+      ring = 23;  // HDL-32E
+    }
+    else
+    {
+      ring = 8;  // VLP-16
+    }
+  }
+  else
+  {
+    ring = cfg_.ring;
+  }
+
+  ROS_INFO_ONCE("VelodyneLaserScan: Extracting ring %u", ring);
+  return ring;
+}
+
+// Bin one point of the PointCloud2 into a LaserScan
+static inline void addPoint(sensor_msgs::LaserScan &scan, const uint8_t *point,
+                            int offset_x, int offset_y, int offset_i)
+{
+  float x, y;
+  memcpy(&x, point + offset_x, sizeof(x));
+  memcpy(&y, point + offset_y, sizeof(y));
+  if (!std::isfinite(x) || !std::isfinite(y))
+  {
+    return;
+  }
+
+  const int bin = (atan2f(y, x) + static_cast<float>(M_PI)) / scan.angle_increment;
+
+  if ((bin >= 0) && (bin < static_cast<int>(scan.ranges.size())))
+  {
+    scan.ranges[bin] = sqrtf(x * x + y * y);
+    if (offset_i >= 0)
+    {
+      memcpy(&scan.intensities[bin], point + offset_i, sizeof(float));
+    }
+  }
+}
+
 void VelodyneLaserScan::recvCallback(const sensor_msgs::PointCloud2ConstPtr& msg)
 {
   // Latch ring count
@@ -101,36 +192,35 @@ void VelodyneLaserScan::recvCallback(const sensor_msgs::PointCloud2ConstPtr& msg
     }
   }
 
-  // Select ring to use
-  uint16_t ring;
+  // Select rings to use, and where to publish them
+  std::vector<uint16_t> rings;
+  std::vector<ros::Publisher*> pubs;
 
-  if ((cfg_.ring < 0) || (cfg_.ring >= ring_count_))
+  if (rings_.empty())
   {
-    // Default to ring closest to being level for each known sensor
-    if (ring_count_ > 32)
-    {
-      ring = 57;  // HDL-64E
-    }
-    else if (ring_count_ > 16)
-    {
-      ring = 23;  // HDL-32E
-    }
-    else
+    rings.push_back(selectRing());
+    pubs.push_back(&pub_);
+  }
+  else
+  {
+    for (size_t i = 0; i < rings_.size(); i++)
     {
-      ring = 8;  // VLP-16
+      if ((rings_[i] < static_cast<int>(ring_count_)) && ring_pubs_[i].getNumSubscribers())
+      {
+        rings.push_back(rings_[i]);
+        pubs.push_back(&ring_pubs_[i]);
+      }
     }
+    ROS_INFO_ONCE("VelodyneLaserScan: Extracting %zu rings", rings_.size());
   }
-  else
+  if (rings.empty())
   {
-    ring = cfg_.ring;
+    return;
   }
 
-  ROS_INFO_ONCE("VelodyneLaserScan: Extracting ring %u", ring);
-
   // Load structure of PointCloud2
   int offset_x = -1;
   int offset_y = -1;
-  int offset_z = -1;
   int offset_i = -1;
   int offset_r = -1;
 
@@ -146,10 +236,6 @@ void VelodyneLaserScan::recvCallback(const sensor_msgs::PointCloud2ConstPtr& msg
       {
         offset_y = msg->fields[i].offset;
       }
-      else if (msg->fields[i].name == "z")
-      {
-        offset_z = msg->fields[i].offset;
-      }
       else if (msg->fields[i].name == "intensity")
       {
         offset_i = msg->fields[i].offset;
@@ -164,11 +250,30 @@ void VelodyneLaserScan::recvCallback(const sensor_msgs::PointCloud2ConstPtr& msg
     }
   }
 
-  // Construct LaserScan message
-  if ((offset_x >= 0) && (offset_y >= 0) && (offset_r >= 0))
+  if ((offset_x < 0) || (offset_y < 0) || (offset_r < 0))
+  {
+    ROS_ERROR("VelodyneLaserScan: PointCloud2 missing one or more required fields! (x,y,ring)");
+    return;
+  }
+
+  const size_t point_step = msg->point_step;
+  const size_t row_step = msg->row_step;
+  if ((msg->height > 0) && (msg->width > 0) &&
+      ((row_step < msg->width * point_step) ||
+       (msg->data.size() < (msg->height - 1) * row_step + msg->width * point_step)))
+  {
+    ROS_ERROR("VelodyneLaserScan: PointCloud2 data does not match its size");
+    return;
+  }
+
+  // Construct LaserScan messages
+  const float RESOLUTION = std::abs(cfg_.resolution);
+  const size_t SIZE = 2.0 * M_PI / RESOLUTION;
+  std::vector<sensor_msgs::LaserScanPtr> scans(rings.size());
+  std::vector<int> ring_scans(ring_count_, -1);
+
+  for (size_t i = 0; i < rings.size(); i++)
   {
-    const float RESOLUTION = std::abs(cfg_.resolution);
-    const size_t SIZE = 2.0 * M_PI / RESOLUTION;
     sensor_msgs::LaserScanPtr scan(new sensor_msgs::LaserScan());
     scan->header = msg->header;
     scan->angle_increment = RESOLUTION;
@@ -178,97 +283,93 @@ void VelodyneLaserScan::recvCallback(const sensor_msgs::PointCloud2ConstPtr& msg
     scan->range_max = 200.0;
     scan->time_increment = 0.0;
     scan->ranges.resize(SIZE, INFINITY);
-
-    if ((offset_x == 0) &&
-        (offset_y == 4) &&
-        (offset_i % 4 == 0) &&
-        (offset_r % 4 == 0))
+    if (offset_i >= 0)
     {
       scan->intensities.resize(SIZE);
+    }
+    scans[i] = scan;
+    if (rings[i] < ring_count_)
+    {
+      ring_scans[rings[i]] = i;
+    }
+  }
 
-      const size_t X = 0;
-      const size_t Y = 1;
-      const size_t I = offset_i / 4;
-      const size_t R = offset_r / 4;
-      for (sensor_msgs::PointCloud2ConstIterator<float> it(*msg, "x"); it != it.end(); ++it)
-      {
-        const uint16_t r = *((const uint16_t*)(&it[R]));  // ring
+  const uint8_t *data = msg->data.data();
 
-        if (r == ring)
-        {
-          const float x = it[X];  // x
-          const float y = it[Y];  // y
-          const float i = it[I];  // intensity
-          const int bin = (atan2f(y, x) + static_cast<float>(M_PI)) / RESOLUTION;
+  // Organized clouds of velodyne_pointcloud hold one ring per row
+  // (azimuth bins) or per column (one row per firing). The default ring
+  // of the single scan may not exist, then fall back to the search.
+  const bool organized = rings[0] < ring_count_;
+  bool ring_rows = organized && (msg->height > 1) && (msg->height == ring_count_) && (msg->width > 0);
+  for (uint32_t row = 0; ring_rows && (row < msg->height); row++)
+  {
+    uint16_t r;
+    memcpy(&r, data + row * row_step + offset_r, sizeof(r));
+    ring_rows = (r == row);
+  }
+  bool ring_columns = organized && !ring_rows && (msg->height > 1) && (msg->width == ring_count_);
+  for (uint32_t column = 0; ring_columns && (column < msg->width); column++)
+  {
+    uint16_t r;
+    memcpy(&r, data + column * point_step + offset_r, sizeof(r));
+    ring_columns = (r == column) || (r == 0);
+  }
 
-          if ((bin >= 0) && (bin < static_cast<int>(SIZE)))
-          {
-            scan->ranges[bin] = sqrtf(x * x + y * y);
-            scan->intensities[bin] = i;
-          }
-        }
+  if (ring_rows)
+  {
+    for (size_t i = 0; i < rings.size(); i++)
+    {
+      const uint8_t *point = data + rings[i] * row_step;
+      for (uint32_t column = 0; column < msg->width; column++, point += point_step)
+      {
+        addPoint(*scans[i], point, offset_x, offset_y, offset_i);
       }
     }
-    else
+  }
+  else if (ring_columns)
+  {
+    for (uint32_t row = 0; row < msg->height; row++)
     {
-      ROS_WARN_ONCE("VelodyneLaserScan: PointCloud2 fields in unexpected order. Using slower generic method.");
-
-      if (offset_i >= 0)
+      for (size_t i = 0; i < rings.size(); i++)
       {
-        scan->intensities.resize(SIZE);
-        sensor_msgs::PointCloud2ConstIterator<uint16_t> iter_r(*msg, "ring");
-        sensor_msgs::PointCloud2ConstIterator<float> iter_x(*msg, "x");
-        sensor_msgs::PointCloud2ConstIterator<float> iter_y(*msg, "y");
-        sensor_msgs::PointCloud2ConstIterator<float> iter_i(*msg, "intensity");
-        for ( ; iter_r != iter_r.end(); ++iter_x, ++iter_y, ++iter_r, ++iter_i)
+        // cells the sensor did not fire in this row are left zero
+        const uint8_t *point = data + row * row_step + rings[i] * point_step;
+        uint16_t r;
+        memcpy(&r, point + offset_r, sizeof(r));
+        if (r == rings[i])
         {
-          const uint16_t r = *iter_r;  // ring
-
-          if (r == ring)
-          {
-            const float x = *iter_x;  // x
-            const float y = *iter_y;  // y
-            const float i = *iter_i;  // intensity
-            const int bin = (atan2f(y, x) + static_cast<float>(M_PI)) / RESOLUTION;
-
-            if ((bin >= 0) && (bin < static_cast<int>(SIZE)))
-            {
-              scan->ranges[bin] = sqrtf(x * x + y * y);
-              scan->intensities[bin] = i;
-            }
-          }
+          addPoint(*scans[i], point, offset_x, offset_y, offset_i);
         }
       }
-      else
+    }
+  }
+  else
+  {
+    const uint16_t first = rings[0];
+    const bool multiple = rings.size() > 1;
+    for (uint32_t row = 0; row < msg->height; row++)
+    {
+      const uint8_t *point = data + row * row_step;
+      const uint8_t *end = point + msg->width * point_step;
+      for (; point < end; point += point_step)
       {
-        sensor_msgs::PointCloud2ConstIterator<uint16_t> iter_r(*msg, "ring");
-        sensor_msgs::PointCloud2ConstIterator<float> iter_x(*msg, "x");
-        sensor_msgs::PointCloud2ConstIterator<float> iter_y(*msg, "y");
-
-        for (; iter_r != iter_r.end(); ++iter_x, ++iter_y, ++iter_r)
+        uint16_t r;
+        memcpy(&r, point + offset_r, sizeof(r));
+        if (r == first)
         {
-          const uint16_t r = *iter_r;  // ring
-
-          if (r == ring)
-          {
-            const float x = *iter_x;  // x
-            const float y = *iter_y;  // y
-            const int bin = (atan2f(y, x) + static_cast<float>(M_PI)) / RESOLUTION;
-
-            if ((bin >= 0) && (bin < static_cast<int>(SIZE)))
-            {
-              scan->ranges[bin] = sqrtf(x * x + y * y);
-            }
-          }
+          addPoint(*scans[0], point, offset_x, offset_y, offset_i);
+        }
+        else if (multiple && (r < ring_count_) && (ring_scans[r] > 0))
+        {
+          addPoint(*scans[ring_scans[r]], point, offset_x, offset_y, offset_i);
         }
       }
     }
-
-    pub_.publish(scan);
   }
-  else
+
+  for (size_t i = 0; i < scans.size(); i++)
   {
-    ROS_ERROR("VelodyneLaserScan: PointCloud2 missing one or more required fields! (x,y,ring)");
+    pubs[i]->publish(scans[i]);
   }
 }
 
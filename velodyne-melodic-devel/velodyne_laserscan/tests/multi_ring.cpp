@@ -0,0 +1,267 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+// Rings published by the node under test, see multi_ring_node.test
+const uint16_t RINGS[] = {2, 5};
+const size_t RING_TOPICS = sizeof(RINGS) / sizeof(RINGS[0]);
+const uint16_t RING_COUNT = 16;
+const size_t RANGE_COUNT = 500;
+
+typedef struct
+{
+  float x;  // x
+  float y;  // y
+  float i;  // intensity
+  uint16_t r;  // ring
+}
+Point;
+
+// Global variables
+ros::Publisher g_pub;
+ros::Subscriber g_sub[RING_TOPICS];
+sensor_msgs::LaserScan g_scan[RING_TOPICS];
+volatile bool g_scan_new[RING_TOPICS];
+
+// Convert WallTime to Time
+static inline ros::Time rosTime(const ros::WallTime &stamp)
+{
+  return ros::Time(stamp.sec, stamp.nsec);
+}
+
+// Subscriber receive callbacks
+void recv(const sensor_msgs::LaserScanConstPtr& msg, size_t index)
+{
+  g_scan[index] = *msg;
+  g_scan_new[index] = true;
+}
+
+// Wait for incoming LaserScan messages on all ring topics
+bool waitForScans(ros::WallDuration dur)
+{
+  const ros::WallTime start = ros::WallTime::now();
+
+  for (size_t i = 0; i < RING_TOPICS; i++)
+  {
+    while (!g_scan_new[i])
+    {
+      if ((ros::WallTime::now() - start) > dur)
+      {
+        return false;
+      }
+
+      ros::WallDuration(0.001).sleep();
+      ros::spinOnce();
+    }
+  }
+
+  return true;
+}
+
+// Random points, RANGE_COUNT firings of RING_COUNT rings
+std::vector<Point> randomPoints()
+{
+  std::vector<Point> points;
+
+  for (size_t i = 0; i < RANGE_COUNT; i++)
+  {
+    double angle_y = i * 1.99 * M_PI / RANGE_COUNT;  // yaw
+
+    for (size_t j = 0; j < RING_COUNT; j++)
+    {
+      double range = 1.0 + std::rand() * (20.0 / RAND_MAX);
+      Point point;
+      point.x = range * cos(angle_y);
+      point.y = range * sin(angle_y);
+      point.i = std::rand() * (1.0 / RAND_MAX);
+      point.r = j;
+      points.push_back(point);
+    }
+  }
+
+  return points;
+}
+
+// Publish the points as a PointCloud2 of the given size, point (i, j)
+// of the firings is stored at row/column (i, j), or (j, i) if transposed
+void publish(const std::vector<Point> &points, uint32_t height, uint32_t width, bool transposed)
+{
+  const uint32_t POINT_STEP = 16;
+  sensor_msgs::PointCloud2 msg;
+  msg.header.frame_id = "velodyne";
+  msg.header.stamp = rosTime(ros::WallTime::now());
+  msg.fields.resize(4);
+  msg.fields[0].name = "x";
+  msg.fields[0].offset = 0;
+  msg.fields[0].datatype = sensor_msgs::PointField::FLOAT32;
+  msg.fields[0].count = 1;
+  msg.fields[1].name = "y";
+  msg.fields[1].offset = 4;
+  msg.fields[1].datatype = sensor_msgs::PointField::FLOAT32;
+  msg.fields[1].count = 1;
+  msg.fields[2].name = "intensity";
+  msg.fields[2].offset = 8;
+  msg.fields[2].datatype = sensor_msgs::PointField::FLOAT32;
+  msg.fields[2].count = 1;
+  msg.fields[3].name = "ring";
+  msg.fields[3].offset = 12;
+  msg.fields[3].datatype = sensor_msgs::PointField::UINT16;
+  msg.fields[3].count = 1;
+  msg.point_step = POINT_STEP;
+  msg.height = height;
+  msg.width = width;
+  msg.row_step = width * POINT_STEP;
+  msg.data.resize(msg.row_step * height, 0x00);
+  msg.is_bigendian = false;
+  msg.is_dense = true;
+
+  for (size_t k = 0; k < points.size(); k++)
+  {
+    const size_t i = k / RING_COUNT;
+    const size_t j = k % RING_COUNT;
+    const size_t cell = transposed ? j * RANGE_COUNT + i : k;
+    uint8_t *ptr = msg.data.data() + cell * POINT_STEP;
+    *(reinterpret_cast<float*>(ptr + 0)) = points[k].x;
+    *(reinterpret_cast<float*>(ptr + 4)) = points[k].y;
+    *(reinterpret_cast<float*>(ptr + 8)) = points[k].i;
+    *(reinterpret_cast<uint16_t*>(ptr + 12)) = points[k].r;
+  }
+
+  for (size_t i = 0; i < RING_TOPICS; i++)
+  {
+    g_scan_new[i] = false;
+  }
+  g_pub.publish(msg);
+}
+
+// Verify that each ring topic got exactly the points of its ring
+void verifyScans(const std::vector<Point> &points)
+{
+  for (size_t t = 0; t < RING_TOPICS; t++)
+  {
+    const sensor_msgs::LaserScan &scan = g_scan[t];
+    ASSERT_EQ(scan.ranges.size(), scan.intensities.size());
+    size_t count = 0;
+
+    for (size_t i = 0; i < scan.ranges.size(); i++)
+    {
+      if (std::isfinite(scan.ranges[i]))
+      {
+        count++;
+      }
+    }
+    EXPECT_EQ(RANGE_COUNT, count);
+
+    for (size_t k = 0; k < points.size(); k++)
+    {
+      if (points[k].r != RINGS[t])
+      {
+        continue;
+      }
+      const int bin = (atan2f(points[k].y, points[k].x) + static_cast<float>(M_PI)) / scan.angle_increment;
+      ASSERT_LT(bin, static_cast<int>(scan.ranges.size()));
+      EXPECT_FLOAT_EQ(sqrtf(points[k].x * points[k].x + points[k].y * points[k].y), scan.ranges[bin]);
+      EXPECT_EQ(points[k].i, scan.intensities[bin]);
+    }
+  }
+}
+
+// Verify that every configured ring is published on its own topic
+TEST(MultiRing, flat)
+{
+  // Make sure system is connected
+  for (size_t i = 0; i < RING_TOPICS; i++)
+  {
+    ASSERT_EQ(1, g_sub[i].getNumPublishers());
+  }
+  ASSERT_EQ(1, g_pub.getNumSubscribers());
+
+  std::vector<Point> points = randomPoints();
+  publish(points, 1, points.size(), false);
+  ASSERT_TRUE(waitForScans(ros::WallDuration(1.0)));
+  verifyScans(points);
+}
+
+// Verify organized clouds with one row per firing, and one row per ring
+TEST(MultiRing, organized)
+{
+  // Make sure system is connected
+  for (size_t i = 0; i < RING_TOPICS; i++)
+  {
+    ASSERT_EQ(1, g_sub[i].getNumPublishers());
+  }
+  ASSERT_EQ(1, g_pub.getNumSubscribers());
+
+  std::vector<Point> points = randomPoints();
+  publish(points, RANGE_COUNT, RING_COUNT, false);
+  ASSERT_TRUE(waitForScans(ros::WallDuration(1.0)));
+  verifyScans(points);
+
+  points = randomPoints();
+  publish(points, RING_COUNT, RANGE_COUNT, true);
+  ASSERT_TRUE(waitForScans(ros::WallDuration(1.0)));
+  verifyScans(points);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+
+  // Initialize ROS
+  ros::init(argc, argv, "test_multi_ring");
+  ros::NodeHandle nh;
+
+  // Setup publisher and subscribers
+  g_pub = nh.advertise<sensor_msgs::PointCloud2>("velodyne_points", 2);
+  for (size_t i = 0; i < RING_TOPICS; i++)
+  {
+    std::ostringstream topic;
+    topic << "scan_ring_" << RINGS[i];
+    g_sub[i] = nh.subscribe<sensor_msgs::LaserScan>(topic.str(), 2, boost::bind(recv, _1, i));
+  }
+
+  // Wait for other nodes to startup
+  ros::WallDuration(1.0).sleep();
+  ros::spinOnce();
+
+  // Run all the tests that were declared with TEST()
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,375 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    End-to-end throughput of the driver and cloud conversion pipeline.
+
+    Reads a PCAP capture as fast as possible through the driver's
+    InputPCAP, batches packets into scans as VelodyneDriver does and
+    converts every scan to a point cloud as the cloud nodelet does, all
+    in one process and without a ROS master. Reports sustained packets
+    and scans per second, per-scan latency percentiles and peak RSS,
+    and compares them against a baseline file.
+
+    The DriverNodelet and CloudNodelet themselves need a master, so the
+    harness links the libraries they are built from (velodyne_input,
+    velodyne_rawdata and velodyne_containers) and repeats the few lines
+    around them. Compared with the nodelet chain it leaves out:
+
+      - the callback queue hand-off of the scan between the nodelets;
+        in a manager the scan is passed by shared pointer as well,
+      - the driver's diagnostics, time_offset and dynamic reconfigure,
+      - the cloud nodelet's diagnostics, decimated output and publish;
+        the cloud is still moved into a pooled message as for publishing.
+
+    benchmarks/synthetic_capture.py writes captures that give the same
+    packets on every machine.
+
+    Usage:
+
+      velodyne_pipeline_throughput --pcap FILE --model MODEL
+          --calibration FILE [--rpm 600] [--repeat 1] [--threads 1]
+          [--organized] [--baseline FILE [--update-baseline]]
+
+*/
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <velodyne_driver/input.h>
+
+#include "velodyne_pointcloud/calibration.h"
+#include "velodyne_pointcloud/organized_cloudXYZIR.h"
+#include "velodyne_pointcloud/parallel_unpack.h"
+#include "velodyne_pointcloud/pointcloudXYZIR.h"
+#include "velodyne_pointcloud/rawdata.h"
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+  std::string pcap;
+  std::string model;
+  std::string calibration;
+  std::string baseline;
+  double rpm;
+  int repeat;
+  unsigned int threads;
+  bool organized;
+  bool update_baseline;
+
+  Options() : rpm(600.0), repeat(1), threads(1), organized(false), update_baseline(false) {}
+};
+
+/** @brief Measured or baseline figures of one configuration. */
+struct Figures
+{
+  double packets_per_s;
+  double scans_per_s;
+  double p50_ms;
+  double p99_ms;
+  double peak_rss_mb;
+};
+
+/** @brief Packet rate of each model, as in VelodyneDriver. */
+double packetRate(const std::string& model)
+{
+  if (model == "64E_S2" || model == "64E_S2.1")
+    return 3472.17;
+  if (model == "64E")
+    return 2600.0;
+  if (model == "64E_S3")
+    return 5787.03;
+  if (model == "32E")
+    return 1808.0;
+  if (model == "32C")
+    return 1507.0;
+  if (model == "VLP16")
+    return 754;
+  return 0.0;
+}
+
+void usage(const char* name)
+{
+  fprintf(stderr,
+          "usage: %s --pcap FILE --model MODEL --calibration FILE [--rpm 600]\n"
+          "          [--repeat 1] [--threads 1] [--organized]\n"
+          "          [--baseline FILE [--update-baseline]]\n",
+          name);
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--pcap" && has_value)
+      options.pcap = argv[++i];
+    else if (arg == "--model" && has_value)
+      options.model = argv[++i];
+    else if (arg == "--calibration" && has_value)
+      options.calibration = argv[++i];
+    else if (arg == "--baseline" && has_value)
+      options.baseline = argv[++i];
+    else if (arg == "--rpm" && has_value)
+      options.rpm = atof(argv[++i]);
+    else if (arg == "--repeat" && has_value)
+      options.repeat = std::max(1, atoi(argv[++i]));
+    else if (arg == "--threads" && has_value)
+      options.threads = std::max(1, atoi(argv[++i]));
+    else if (arg == "--organized")
+      options.organized = true;
+    else if (arg == "--update-baseline")
+      options.update_baseline = true;
+    else
+      return false;
+  }
+  return !options.pcap.empty() && !options.model.empty() && !options.calibration.empty();
+}
+
+/** @brief Baseline key: capture, model and conversion settings. */
+std::string configurationKey(const Options& options)
+{
+  std::string capture = options.pcap.substr(options.pcap.find_last_of('/') + 1);
+  std::ostringstream key;
+  key << capture << ":" << options.model << ":" << options.rpm << "rpm:"
+      << (options.organized ? "organized" : "flat") << ":" << options.threads << "t";
+  return key.str();
+}
+
+double percentile(std::vector<double> values, const double fraction)
+{
+  if (values.empty())
+    return 0.0;
+  std::sort(values.begin(), values.end());
+  const size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+  return values[index];
+}
+
+/** @brief Read "key packets/s scans/s p50_ms p99_ms peak_rss_mb" lines. */
+std::map<std::string, Figures> readBaseline(const std::string& filename)
+{
+  std::map<std::string, Figures> baseline;
+  std::ifstream in(filename.c_str());
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    std::string key;
+    Figures figures;
+    if (fields >> key >> figures.packets_per_s >> figures.scans_per_s >> figures.p50_ms >> figures.p99_ms >>
+        figures.peak_rss_mb)
+      baseline[key] = figures;
+  }
+  return baseline;
+}
+
+/** @brief Replace or add the line of key, keeping comments and order. */
+void writeBaseline(const std::string& filename, const std::string& key, const Figures& figures)
+{
+  std::vector<std::string> lines;
+  {
+    std::ifstream in(filename.c_str());
+    std::string line;
+    while (std::getline(in, line))
+      lines.push_back(line);
+  }
+
+  char entry[256];
+  snprintf(entry, sizeof(entry), "%s %.0f %.1f %.2f %.2f %.1f", key.c_str(), figures.packets_per_s,
+           figures.scans_per_s, figures.p50_ms, figures.p99_ms, figures.peak_rss_mb);
+  bool replaced = false;
+  for (size_t i = 0; i < lines.size(); ++i)
+  {
+    if (lines[i].compare(0, key.size() + 1, key + " ") == 0)
+    {
+      lines[i] = entry;
+      replaced = true;
+    }
+  }
+  if (!replaced)
+    lines.push_back(entry);
+
+  std::ofstream out(filename.c_str());
+  for (size_t i = 0; i < lines.size(); ++i)
+    out << lines[i] << "\n";
+}
+
+void printFigure(const char* name, const double value, const double* baseline, const bool higher_is_better)
+{
+  printf("  %-14s %12.2f", name, value);
+  if (baseline && *baseline > 0)
+  {
+    const double change = 100.0 * (value - *baseline) / *baseline;
+    const bool worse = higher_is_better ? change < 0 : change > 0;
+    printf("   baseline %12.2f  %+6.1f%%%s", *baseline, change, worse && std::fabs(change) > 10 ? "  <--" : "");
+  }
+  printf("\n");
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, options))
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  const double packet_rate = packetRate(options.model);
+  if (packet_rate <= 0)
+  {
+    fprintf(stderr, "unknown Velodyne LIDAR model: %s\n", options.model.c_str());
+    return 2;
+  }
+  if (access(options.pcap.c_str(), R_OK) != 0)
+  {
+    fprintf(stderr, "cannot read %s\n", options.pcap.c_str());
+    return 2;
+  }
+
+  // only the clock is needed, not a node or master
+  ros::Time::init();
+
+  const double max_range = 130.0;
+  const double min_range = 0.4;
+  boost::shared_ptr<velodyne_rawdata::RawData> data(new velodyne_rawdata::RawData());
+  if (data->setupOffline(options.calibration, max_range, min_range) != 0)
+  {
+    fprintf(stderr, "cannot load calibration %s\n", options.calibration.c_str());
+    return 2;
+  }
+  data->setParameters(min_range, max_range, 0.0, 2 * M_PI);
+  const unsigned int num_lasers = velodyne_pointcloud::Calibration(options.calibration, false).num_lasers;
+
+  boost::function<velodyne_rawdata::DataContainerBase*()> factory;
+  if (options.organized)
+    factory = [&]() -> velodyne_rawdata::DataContainerBase* {
+      return new velodyne_pointcloud::OrganizedCloudXYZIR(max_range, min_range, "", "", num_lasers,
+                                                          data->scansPerPacket());
+    };
+  else
+    factory = [&]() -> velodyne_rawdata::DataContainerBase* {
+      return new velodyne_pointcloud::PointcloudXYZIR(max_range, min_range, "", "", data->scansPerPacket());
+    };
+  boost::shared_ptr<velodyne_rawdata::DataContainerBase> container(factory());
+
+  boost::shared_ptr<velodyne_pointcloud::ParallelUnpacker> unpacker;
+  if (options.threads > 1)
+  {
+    unpacker.reset(new velodyne_pointcloud::ParallelUnpacker(data, options.threads, false));
+    unpacker->resetContainers([&]() {
+      return boost::shared_ptr<velodyne_rawdata::DataContainerBase>(factory());
+    });
+  }
+
+  // packets per scan, as VelodyneDriver computes it
+  const int npackets = static_cast<int>(ceil(packet_rate / (options.rpm / 60.0)));
+
+  size_t total_packets = 0;
+  size_t total_points = 0;
+  std::vector<double> latencies_ms;
+  const Clock::time_point start = Clock::now();
+
+  for (int pass = 0; pass < options.repeat; ++pass)
+  {
+    velodyne_driver::InputPCAP input(options.pcap, velodyne_driver::DATA_PORT_NUMBER, packet_rate,
+                                     true, true);
+    bool done = false;
+    while (!done)
+    {
+      const Clock::time_point scan_start = Clock::now();
+      velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+      scan->packets.resize(npackets);
+      int count = 0;
+      while (count < npackets)
+      {
+        if (input.getPacket(&scan->packets[count], 0.0) != 0)
+        {
+          done = true;
+          break;
+        }
+        ++count;
+      }
+      if (count < npackets)                     // partial scan at the end
+        break;
+      scan->header.stamp = scan->packets[npackets - 1].stamp;
+      scan->header.frame_id = "velodyne";
+
+      container->setup(scan);
+      if (unpacker)
+      {
+        unpacker->unpack(scan, *container);
+      }
+      else
+      {
+        for (size_t i = 0; i < scan->packets.size(); ++i)
+          data->unpack(scan->packets[i], *container, scan->header.stamp);
+      }
+      // the message Convert::processScan() publishes
+      const sensor_msgs::PointCloud2Ptr cloud = container->finishCloudPtr();
+
+      latencies_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - scan_start).count());
+      total_packets += npackets;
+      total_points += static_cast<size_t>(cloud->width) * cloud->height;
+    }
+  }
+
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  if (latencies_ms.empty() || seconds <= 0)
+  {
+    fprintf(stderr, "no complete scan in %s\n", options.pcap.c_str());
+    return 1;
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  Figures figures;
+  figures.packets_per_s = total_packets / seconds;
+  figures.scans_per_s = latencies_ms.size() / seconds;
+  figures.p50_ms = percentile(latencies_ms, 0.50);
+  figures.p99_ms = percentile(latencies_ms, 0.99);
+  figures.peak_rss_mb = usage.ru_maxrss / 1024.0;        // kilobytes on Linux
+
+  const std::string key = configurationKey(options);
+  std::map<std::string, Figures> baseline;
+  if (!options.baseline.empty())
+    baseline = readBaseline(options.baseline);
+  const std::map<std::string, Figures>::const_iterator entry = baseline.find(key);
+  const Figures* reference = entry != baseline.end() ? &entry->second : NULL;
+
+  printf("%s: %zu scans, %zu packets, %zu points in %.2f s\n", key.c_str(), latencies_ms.size(), total_packets,
+         total_points, seconds);
+  printFigure("packets/s", figures.packets_per_s, reference ? &reference->packets_per_s : NULL, true);
+  printFigure("scans/s", figures.scans_per_s, reference ? &reference->scans_per_s : NULL, true);
+  printFigure("p50 [ms]", figures.p50_ms, reference ? &reference->p50_ms : NULL, false);
+  printFigure("p99 [ms]", figures.p99_ms, reference ? &reference->p99_ms : NULL, false);
+  printFigure("peak RSS [MB]", figures.peak_rss_mb, reference ? &reference->peak_rss_mb : NULL, false);
+  if (!options.baseline.empty() && !reference)
+    printf("  no baseline for this configuration\n");
+
+  if (options.update_baseline && !options.baseline.empty())
+    writeBaseline(options.baseline, key, figures);
+  return 0;
+}
@@ -0,0 +1,118 @@
+#!/usr/bin/python
+# Software License Agreement (BSD License)
+#
+# Copyright (C) 2019, Austin Robot Technology
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above
+#    copyright notice, this list of conditions and the following
+#    disclaimer in the documentation and/or other materials provided
+#    with the distribution.
+#  * Neither the name of Austin Robot Technology, Inc. nor the names
+#    of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written
+#    permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+"""
+Write a deterministic PCAP capture of synthetic Velodyne packets.
+
+The captures feed velodyne_pipeline_throughput where the recorded test
+captures are not at hand, and give the same bytes on every machine.
+Ranges vary smoothly with azimuth and laser, one return in 16 is
+missing.
+
+"""
+
+from __future__ import print_function
+
+import math
+import optparse
+import struct
+import sys
+
+# packets per second and lasers of each model, as in VelodyneDriver
+MODELS = {
+    '64E': (2600.0, 64),
+    '64E_S2': (3472.17, 64),
+    '64E_S2.1': (3472.17, 64),
+    '64E_S3': (5787.03, 64),
+    '32E': (1808.0, 32),
+    '32C': (1507.0, 32),
+    'VLP16': (754.0, 16),
+}
+
+BLOCKS_PER_PACKET = 12
+SCANS_PER_BLOCK = 32
+UPPER_BANK = 0xeeff
+LOWER_BANK = 0xddff
+DATA_PORT_NUMBER = 2368
+
+usage = """usage: %prog [options] MODEL outfile.pcap"""
+parser = optparse.OptionParser(usage=usage)
+parser.add_option('--rpm', type='float', default=600.0,
+                  help='rotation speed [default: %default]')
+parser.add_option('--seconds', type='float', default=10.0,
+                  help='length of the capture [default: %default]')
+options, args = parser.parse_args()
+if len(args) != 2 or args[0] not in MODELS:
+    parser.error('MODEL must be one of ' + ', '.join(sorted(MODELS)))
+model, outfile = args
+packet_rate, num_lasers = MODELS[model]
+
+# two blocks of 32 lasers fire together on the 64 laser models
+blocks_per_rotation = BLOCKS_PER_PACKET // 2 if num_lasers == 64 else BLOCKS_PER_PACKET
+step = options.rpm / 60.0 * 36000.0 / (packet_rate * blocks_per_rotation)
+
+# Ethernet, IPv4 and UDP headers; InputPCAP skips the first 42 bytes
+udp_header = (b'\xff' * 6 + b'\x60\x76\x88\x00\x00\x00' + b'\x08\x00'
+              + struct.pack('!BBHHHBBH4s4s', 0x45, 0, 20 + 8 + 1206, 0, 0x4000,
+                            64, 17, 0, b'\xc0\xa8\x01\xc9', b'\xff\xff\xff\xff')
+              + struct.pack('!HHHH', DATA_PORT_NUMBER, DATA_PORT_NUMBER, 8 + 1206, 0))
+
+out = open(outfile, 'wb')
+out.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+
+noise = 12345
+rotation = 0.0
+npackets = int(options.seconds * packet_rate)
+for p in range(npackets):
+    payload = bytearray()
+    for b in range(BLOCKS_PER_PACKET):
+        lower = num_lasers == 64 and b % 2 == 1
+        azimuth = int(rotation) % 36000
+        payload += struct.pack('<HH', LOWER_BANK if lower else UPPER_BANK, azimuth)
+        for k in range(SCANS_PER_BLOCK):
+            noise = (noise * 1103515245 + 12345) & 0xffffffff
+            distance = int(5000 + 3000 * math.sin(azimuth * 0.0005 + k * 0.4))
+            if (noise >> 8) % 16 == 0:
+                distance = 0                    # no return
+            payload += struct.pack('<HB', distance, 20 + (noise >> 20) % 80)
+        if num_lasers != 64 or lower:
+            rotation = (rotation + step) % 36000.0
+    stamp_us = int(p * 1e6 / packet_rate)
+    payload += struct.pack('<IBB', stamp_us % 3600000000, 0x37, 0x22)
+    frame = udp_header + bytes(payload)
+    seconds, microseconds = divmod(stamp_us, 1000000)
+    out.write(struct.pack('<IIII', seconds, microseconds, len(frame), len(frame)))
+    out.write(frame)
+out.close()
+print('wrote %d packets of %s to %s' % (npackets, model, outfile), file=sys.stderr)
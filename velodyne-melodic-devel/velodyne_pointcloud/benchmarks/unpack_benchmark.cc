@@ -0,0 +1,234 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    Microbenchmarks of RawData::unpack into the point cloud containers.
+
+    Every calibration in params/ is run against one synthetic scan of
+    its model (a full revolution of packets at 10 Hz). Each benchmark
+    iteration converts one scan, and reports points/s and heap
+    allocations per scan. No ROS master is needed.
+
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+#include "velodyne_pointcloud/calibration.h"
+#include "velodyne_pointcloud/organized_cloudXYZIR.h"
+#include "velodyne_pointcloud/pointcloudXYZIR.h"
+#include "velodyne_pointcloud/rawdata.h"
+
+namespace
+{
+boost::atomic<size_t> g_allocations(0);
+}
+
+// count heap allocations of the whole process
+void* operator new(std::size_t size)
+{
+  ++g_allocations;
+  void* ptr = std::malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace
+{
+const double MAX_RANGE = 130.0;
+const double MIN_RANGE = 0.4;
+
+/** @brief One revolution of packets, with smooth ranges and some misses. */
+velodyne_msgs::VelodyneScanPtr makeScan(const unsigned int num_lasers)
+{
+  using namespace velodyne_rawdata;
+
+  // packets per revolution at 10 Hz and azimuth step per block
+  const bool vlp16 = num_lasers == 16;
+  const bool hdl64 = num_lasers == 64;
+  const unsigned int npackets = vlp16 ? 76 : (hdl64 ? 348 : 181);
+  const unsigned int blocks_per_rotation = hdl64 ? BLOCKS_PER_PACKET / 2 : BLOCKS_PER_PACKET;
+  const unsigned int step = 36000 / (npackets * blocks_per_rotation);
+
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.stamp = ros::Time(1000.0);
+  scan->header.frame_id = "velodyne";
+  scan->packets.resize(npackets);
+
+  unsigned int rotation = 0;
+  unsigned int noise = 12345;
+  for (unsigned int p = 0; p < npackets; ++p)
+  {
+    velodyne_msgs::VelodynePacket& packet = scan->packets[p];
+    packet.stamp = ros::Time(1000.0 + p * 0.1 / npackets);
+    raw_packet_t* raw = reinterpret_cast<raw_packet_t*>(&packet.data[0]);
+    for (int b = 0; b < BLOCKS_PER_PACKET; ++b)
+    {
+      const bool lower = hdl64 && (b % 2) == 1;
+      raw->blocks[b].header = lower ? LOWER_BANK : UPPER_BANK;
+      raw->blocks[b].rotation = rotation;
+      for (int k = 0; k < SCANS_PER_BLOCK; ++k)
+      {
+        noise = noise * 1103515245 + 12345;
+        const int laser = k % 16 + (lower ? 32 : 0);
+        int distance = static_cast<int>(5000 + 3000 * std::sin(rotation * 0.0005 + laser * 0.4)) +
+                       static_cast<int>((noise >> 16) % 8);
+        if ((noise >> 8) % 16 == 0)
+          distance = 0;                           // no return
+        uint8_t* data = &raw->blocks[b].data[k * RAW_SCAN_SIZE];
+        data[0] = distance & 0xff;
+        data[1] = (distance >> 8) & 0xff;
+        data[2] = static_cast<uint8_t>(20 + (noise >> 20) % 80);
+      }
+      if (!hdl64 || lower)
+        rotation = (rotation + step) % 36000;
+    }
+  }
+  return scan;
+}
+
+/** @brief Shared setup of one calibration file. */
+struct Fixture
+{
+  velodyne_rawdata::RawData raw;
+  unsigned int num_lasers;
+  velodyne_msgs::VelodyneScanPtr scan;
+
+  explicit Fixture(const std::string& calibration)
+    : num_lasers(0)
+  {
+    if (raw.setupOffline(calibration, MAX_RANGE, MIN_RANGE) != 0)
+      return;
+    raw.setParameters(MIN_RANGE, MAX_RANGE, 0.0, 2 * M_PI);
+    num_lasers = velodyne_pointcloud::Calibration(calibration, false).num_lasers;
+    scan = makeScan(num_lasers);
+  }
+};
+
+enum ContainerType
+{
+  FLAT,
+  ORGANIZED,
+  ORGANIZED_BINNED
+};
+
+void BM_Unpack(benchmark::State& state, const std::string& calibration, const ContainerType type)
+{
+  Fixture fixture(calibration);
+  if (!fixture.scan)
+  {
+    state.SkipWithError("cannot load calibration");
+    return;
+  }
+
+  boost::shared_ptr<velodyne_rawdata::DataContainerBase> container;
+  switch (type)
+  {
+    case FLAT:
+      container.reset(new velodyne_pointcloud::PointcloudXYZIR(
+          MAX_RANGE, MIN_RANGE, "", "", fixture.raw.scansPerPacket()));
+      break;
+    case ORGANIZED:
+      container.reset(new velodyne_pointcloud::OrganizedCloudXYZIR(
+          MAX_RANGE, MIN_RANGE, "", "", fixture.num_lasers, fixture.raw.scansPerPacket()));
+      break;
+    case ORGANIZED_BINNED:
+      container.reset(new velodyne_pointcloud::OrganizedCloudXYZIR(
+          MAX_RANGE, MIN_RANGE, "", "", fixture.num_lasers, fixture.raw.scansPerPacket(),
+          boost::shared_ptr<tf::TransformListener>(), 2048));
+      break;
+  }
+
+  const velodyne_msgs::VelodyneScan& scan = *fixture.scan;
+  size_t points = 0;
+  size_t allocations = 0;
+  for (auto _ : state)
+  {
+    const size_t before = g_allocations;
+    container->setup(fixture.scan);
+    for (size_t i = 0; i < scan.packets.size(); ++i)
+      fixture.raw.unpack(scan.packets[i], *container, scan.header.stamp);
+    const sensor_msgs::PointCloud2& cloud = container->finishCloud();
+    allocations += g_allocations - before;
+    points += static_cast<size_t>(cloud.width) * cloud.height;
+    benchmark::DoNotOptimize(cloud.data.data());
+  }
+
+  state.SetItemsProcessed(points);
+  state.counters["points/s"] = benchmark::Counter(static_cast<double>(points), benchmark::Counter::kIsRate);
+  state.counters["points/scan"] = benchmark::Counter(static_cast<double>(points), benchmark::Counter::kAvgIterations);
+  state.counters["allocs/scan"] =
+      benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+
+/** @brief YAML calibrations in the params directory, sorted. */
+std::vector<std::string> calibrationFiles(const std::string& directory)
+{
+  std::vector<std::string> files;
+  DIR* dir = opendir(directory.c_str());
+  if (!dir)
+    return files;
+  while (struct dirent* entry = readdir(dir))
+  {
+    const std::string name = entry->d_name;
+    if (name.size() > 5 && name.compare(name.size() - 5, 5, ".yaml") == 0)
+      files.push_back(name);
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  // calibration directory, overridden by the first non-benchmark argument
+  std::string params = VELODYNE_POINTCLOUD_PARAMS_DIR;
+  benchmark::Initialize(&argc, argv);
+  if (argc > 1)
+    params = argv[1];
+
+  const std::vector<std::string> files = calibrationFiles(params);
+  if (files.empty())
+  {
+    fprintf(stderr, "no calibration files in %s\n", params.c_str());
+    return 1;
+  }
+
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    const std::string path = params + "/" + files[i];
+    benchmark::RegisterBenchmark(("Unpack/" + files[i] + "/flat").c_str(), BM_Unpack, path, FLAT)
+        ->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(("Unpack/" + files[i] + "/organized").c_str(), BM_Unpack, path, ORGANIZED)
+        ->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(("Unpack/" + files[i] + "/binned").c_str(), BM_Unpack, path, ORGANIZED_BINNED)
+        ->Unit(benchmark::kMicrosecond);
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,79 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file
+
+    Binary cache of a parsed calibration file and the rotation tables
+    derived from it, for fast startup.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_CALIBRATION_CACHE_H
+#define VELODYNE_POINTCLOUD_CALIBRATION_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include <velodyne_pointcloud/calibration.h>
+
+namespace velodyne_pointcloud
+{
+/** \brief Checksum of the contents of a calibration file.
+ *  \return false if the file cannot be read
+ */
+bool calibrationChecksum(const std::string& calibration_file, uint64_t& checksum);
+
+/** \brief Load a calibration and its rotation tables from a cache file.
+ *
+ *  The file is memory-mapped and only accepted if it was written by
+ *  this version for the same host layout, is intact and was made from
+ *  a calibration file with the given checksum.
+ *
+ *  \param source_checksum calibrationChecksum() of the calibration file
+ *  \param table_size number of entries of each rotation table
+ *  \return false if the cache is missing or stale; outputs are unchanged then
+ */
+bool readCalibrationCache(const std::string& cache_file, const uint64_t source_checksum,
+                          Calibration& calibration, float* cos_table, float* sin_table,
+                          const size_t table_size);
+
+/** \brief Store a calibration and its rotation tables, replacing the file atomically.
+ *  \return false if the file cannot be written
+ */
+bool writeCalibrationCache(const std::string& cache_file, const uint64_t source_checksum,
+                           const Calibration& calibration, const float* cos_table,
+                           const float* sin_table, const size_t table_size);
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_CALIBRATION_CACHE_H
@@ -0,0 +1,90 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file
+
+    Compact encoding of Velodyne PointCloud2 messages for recording
+    and remote transport.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_CLOUD_CODEC_H
+#define VELODYNE_POINTCLOUD_CLOUD_CODEC_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <sensor_msgs/PointCloud2.h>
+
+namespace velodyne_pointcloud
+{
+/** \brief Compresses PointCloud2 messages along the laser rings.
+ *
+ *  Float32 x, y and z are quantized to a fixed resolution, every other
+ *  field is kept bit-exact: integer fields and integral float fields
+ *  (e.g. raw intensities) as integers, other float32 fields by their bit
+ *  pattern and remaining types byte by byte. Each value is predicted from
+ *  the previous point of the same ring (field "ring" or "laserid") and
+ *  the residual is written with an adaptive Golomb-Rice code, so the
+ *  organized or ring-interleaved Velodyne layouts need a few bits per
+ *  value. Points with a NaN x coordinate only cost one bit.
+ *
+ *  With a resolution of zero, x, y and z are kept bit-exact as well.
+ *  Padding bytes between fields are not preserved.
+ */
+class CloudCodec
+{
+public:
+  /// identifier of the encoding, stored with the data
+  static const std::string FORMAT;
+
+  /** \param resolution quantization step of x, y and z [m], 0 for lossless */
+  explicit CloudCodec(const double resolution = 0.001);
+
+  /** \brief Encode a cloud, without its header.
+   *  \return false if the fields or the data do not match the cloud layout
+   */
+  bool encode(const sensor_msgs::PointCloud2& cloud, std::vector<uint8_t>& data) const;
+
+  /** \brief Decode data produced by encode(); the header is left unchanged.
+   *  \return false if the data is truncated or not in this format
+   */
+  bool decode(const std::vector<uint8_t>& data, sensor_msgs::PointCloud2& cloud) const;
+
+private:
+  double resolution_;
+};
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_CLOUD_CODEC_H
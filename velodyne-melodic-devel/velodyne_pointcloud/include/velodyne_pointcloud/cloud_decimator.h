@@ -0,0 +1,114 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file
+
+    Decimation of Velodyne point clouds by ring, azimuth and voxel.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_CLOUD_DECIMATOR_H
+#define VELODYNE_POINTCLOUD_CLOUD_DECIMATOR_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <sensor_msgs/PointCloud2.h>
+
+namespace velodyne_pointcloud
+{
+/** \brief Reduces a converted scan in a single linear pass.
+ *
+ *  Keeps the rings whose number is a multiple of the ring stride and
+ *  every n-th firing of each kept ring, then merges the remaining
+ *  points of each voxel into their centroid, as pcl::VoxelGrid does
+ *  for x, y, z and intensity. Other fields (ring, time) are those of
+ *  the first point of the voxel. The voxels live in a hash table, so
+ *  nothing is sorted and, after the first scans, nothing allocated.
+ *
+ *  The output is an unorganized, dense cloud with the fields of the
+ *  input, in the order of the first point of each voxel.
+ */
+class CloudDecimator
+{
+public:
+  CloudDecimator();
+
+  /** \param ring_stride keep every n-th ring, 1 for all
+   *  \param azimuth_stride keep every n-th point of each ring, 1 for all
+   *  \param voxel_size voxel edge [m], 0 for no voxel grid
+   */
+  void configure(const int ring_stride, const int azimuth_stride, const double voxel_size);
+
+  /// true if any option reduces the cloud
+  bool enabled() const
+  {
+    return ring_stride_ > 1 || azimuth_stride_ > 1 || voxel_size_ > 0;
+  }
+
+  /** \brief Decimate cloud into reduced, which keeps its allocation.
+   *  \return false if cloud has no float32 x, y and z, or no ring
+   *          field while a stride is set
+   */
+  bool decimate(const sensor_msgs::PointCloud2& cloud, sensor_msgs::PointCloud2& reduced);
+
+private:
+  struct Voxel
+  {
+    uint64_t key;
+    uint32_t index;       ///< output point
+    uint32_t generation;  ///< scan that last used the slot
+  };
+
+  /// accumulated x, y, z, intensity and count of an output point
+  struct Sum
+  {
+    double x, y, z, intensity;
+    uint32_t count;
+  };
+
+  uint32_t voxelIndex(const float x, const float y, const float z, const uint32_t next);
+
+  int ring_stride_;
+  int azimuth_stride_;
+  double voxel_size_;
+  double inverse_voxel_size_;
+
+  std::vector<uint32_t> ring_counts_;
+  std::vector<Voxel> voxels_;
+  std::vector<Sum> sums_;
+  uint32_t generation_;
+};
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_CLOUD_DECIMATOR_H
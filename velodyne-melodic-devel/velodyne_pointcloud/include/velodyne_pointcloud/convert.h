@@ -47,6 +47,8 @@
 
 #include <sensor_msgs/PointCloud2.h>
 #include <velodyne_pointcloud/rawdata.h>
+#include <velodyne_pointcloud/parallel_unpack.h>
+#include <velodyne_pointcloud/cloud_decimator.h>
 
 #include <dynamic_reconfigure/server.h>
 #include <velodyne_pointcloud/CloudNodeConfig.h>
@@ -65,14 +67,20 @@ class Convert
   private:
     void callback(velodyne_pointcloud::CloudNodeConfig &config, uint32_t level);
     void processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg);
+    boost::shared_ptr<velodyne_rawdata::DataContainerBase> createContainer();
 
     boost::shared_ptr<dynamic_reconfigure::Server<velodyne_pointcloud::CloudNodeConfig> > srv_;
 
     boost::shared_ptr<velodyne_rawdata::RawData> data_;
     ros::Subscriber velodyne_scan_;
     ros::Publisher output_;
+    ros::Publisher decimated_output_;
 
     boost::shared_ptr<velodyne_rawdata::DataContainerBase> container_ptr_;
+    boost::shared_ptr<ParallelUnpacker> unpacker_;
+
+    CloudDecimator decimator_;
+    sensor_msgs::PointCloud2Ptr decimated_msg_;
 
     boost::mutex reconfigure_mtx_;
 
@@ -82,10 +90,12 @@ class Convert
       std::string target_frame;      ///< target frame
       std::string fixed_frame;       ///< fixed frame
       bool organize_cloud;           ///< enable/disable organized cloud structure
+      int azimuth_bins;              ///< organized cloud columns, 0 for one line per block
       double max_range;              ///< maximum range to publish
       double min_range;              ///< minimum range to publish
       uint16_t num_lasers;           ///< number of lasers
       int npackets;                  ///< number of packets to combine
+      int num_threads;               ///< threads used to unpack a scan
     }
     Config;
     Config config_;
@@ -35,8 +35,10 @@
 #include <tf/transform_listener.h>
 #include <velodyne_msgs/VelodyneScan.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <boost/make_shared.hpp>
 #include <Eigen/Dense>
 #include <string>
+#include <vector>
 #include <algorithm>
 #include <cstdarg>
 
@@ -117,6 +119,23 @@ public:
 
   virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth, const float distance,
                         const float intensity, const float time) = 0;
+  /** \brief Add a batch of returns given as parallel arrays.
+   *
+   *  The arrays hold count entries in the same order addPoint() would
+   *  receive them, typically one block or firing of a packet. The default
+   *  implementation forwards each return to addPoint(); containers
+   *  override it to fill the cloud in a single pass.
+   */
+  virtual void addPoints(const float* x, const float* y, const float* z, const uint16_t* ring,
+                         const uint16_t* azimuth, const float* distance, const float* intensity,
+                         const float* time, const size_t count)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      addPoint(x[i], y[i], z[i], ring[i], azimuth[i], distance[i], intensity[i], time[i]);
+    }
+  }
+
   virtual void newLine() = 0;
 
   const sensor_msgs::PointCloud2& finishCloud()
@@ -133,6 +152,72 @@ public:
     return cloud;
   }
 
+  /** \brief Finish the cloud and hand it out as a shared message.
+   *
+   *  The point data is moved into a pooled message, which can be published
+   *  without a copy. A pooled message is only reused after every subscriber
+   *  released it; its old buffer then becomes the next scan's storage.
+   */
+  sensor_msgs::PointCloud2Ptr finishCloudPtr()
+  {
+    finishCloud();
+
+    sensor_msgs::PointCloud2Ptr msg;
+    for (size_t i = 0; i < cloud_pool_.size(); ++i)
+    {
+      if (cloud_pool_[i].use_count() == 1)
+      {
+        msg = cloud_pool_[i];
+        break;
+      }
+    }
+    if (!msg)
+    {
+      msg = boost::make_shared<sensor_msgs::PointCloud2>();
+      if (cloud_pool_.size() < CLOUD_POOL_SIZE)
+      {
+        cloud_pool_.push_back(msg);
+      }
+    }
+
+    msg->header = cloud.header;
+    msg->height = cloud.height;
+    msg->width = cloud.width;
+    msg->fields = cloud.fields;
+    msg->is_bigendian = cloud.is_bigendian;
+    msg->point_step = cloud.point_step;
+    msg->row_step = cloud.row_step;
+    msg->is_dense = cloud.is_dense;
+    msg->data.swap(cloud.data);
+    return msg;
+  }
+
+  /** \brief Append the points of a container that unpacked the following packets.
+   *
+   *  Used to merge clouds unpacked in parallel, in packet order. Unorganized
+   *  clouds grow in width, organized clouds by whole lines. Only
+   *  finishCloud() may be called afterwards.
+   */
+  virtual void append(const DataContainerBase& other)
+  {
+    const size_t offset = static_cast<size_t>(cloud.width) * cloud.height * cloud.point_step;
+    const size_t size = static_cast<size_t>(other.cloud.width) * other.cloud.height * other.cloud.point_step;
+    if (cloud.data.size() < offset + size)
+    {
+      cloud.data.resize(offset + size);
+    }
+    std::copy(other.cloud.data.begin(), other.cloud.data.begin() + size, cloud.data.begin() + offset);
+
+    if (config_.init_width == 0)
+    {
+      cloud.width += other.cloud.width;
+    }
+    else
+    {
+      cloud.height += other.cloud.height;
+    }
+  }
+
   void configure(const double max_range, const double min_range, const std::string fixed_frame,
                  const std::string target_frame)
   {
@@ -157,7 +242,11 @@ public:
     eigen_vec(2) = tf_vec[2];
   }
 
-  inline bool computeTransformation(const ros::Time& time)
+  /** \brief Pose of the cloud frame in the target frame at a stamp, from tf.
+   *
+   *  Virtual, so that the unit tests can provide known poses.
+   */
+  virtual bool lookupTransformation(const ros::Time& time, Eigen::Quaternionf& rotation, Eigen::Vector3f& origin)
   {
     tf::StampedTransform transform;
     try
@@ -176,15 +265,89 @@ public:
     }
 
     tf::Quaternion quaternion = transform.getRotation();
-    Eigen::Quaternionf rotation(quaternion.w(), quaternion.x(), quaternion.y(), quaternion.z());
+    rotation = Eigen::Quaternionf(quaternion.w(), quaternion.x(), quaternion.y(), quaternion.z());
+    vectorTfToEigen(transform.getOrigin(), origin);
+    return true;
+  }
 
+  inline bool computeTransformation(const ros::Time& time)
+  {
+    Eigen::Quaternionf rotation;
     Eigen::Vector3f eigen_origin;
-    vectorTfToEigen(transform.getOrigin(), eigen_origin);
+    if (!lookupTransformation(time, rotation, eigen_origin))
+    {
+      return false;
+    }
+
     Eigen::Translation3f translation(eigen_origin);
     transformation = translation * rotation;
     return true;
   }
 
+  /** \brief Look up the transformation at num_knots stamps spread evenly over [start, end].
+   *
+   *  Afterwards updateTransformation() interpolates between these poses
+   *  instead of querying tf. On failure the cache is cleared, so every
+   *  update falls back to a lookup.
+   */
+  bool cacheTransformations(const ros::Time& start, const ros::Time& end, const unsigned int num_knots)
+  {
+    const unsigned int knots = std::max(num_knots, 2u);
+    const double span = (end - start).toSec();
+    transform_cache_.resize(knots);
+    for (unsigned int i = 0; i < knots; ++i)
+    {
+      TransformKnot& knot = transform_cache_[i];
+      knot.stamp = (i + 1 < knots) ? start + ros::Duration(span * i / (knots - 1)) : end;
+      if (!lookupTransformation(knot.stamp, knot.rotation, knot.origin))
+      {
+        transform_cache_.clear();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** \brief Use the cached transformations of another container. */
+  void shareTransformations(const DataContainerBase& other)
+  {
+    transform_cache_ = other.transform_cache_;
+  }
+
+  void clearTransformations()
+  {
+    transform_cache_.clear();
+  }
+
+  /** \brief Set the transformation for a packet stamp.
+   *
+   *  Rotation is interpolated by SLERP and translation linearly between the
+   *  cached knots; without a cache this is computeTransformation().
+   */
+  bool updateTransformation(const ros::Time& time)
+  {
+    if (transform_cache_.empty())
+    {
+      return computeTransformation(time);
+    }
+
+    // knots are evenly spaced, so the segment follows from the stamp
+    const TransformKnot& first = transform_cache_.front();
+    const double span = (transform_cache_.back().stamp - first.stamp).toSec();
+    const size_t segments = transform_cache_.size() - 1;
+    double position = span > 0 ? (time - first.stamp).toSec() / span * segments : 0;
+    position = std::min(std::max(position, 0.0), static_cast<double>(segments));
+    const size_t index = std::min(static_cast<size_t>(position), segments - 1);
+    const float alpha = static_cast<float>(position - index);
+
+    const TransformKnot& from = transform_cache_[index];
+    const TransformKnot& to = transform_cache_[index + 1];
+    Eigen::Quaternionf rotation = from.rotation.slerp(alpha, to.rotation);
+    Eigen::Translation3f translation((1 - alpha) * from.origin + alpha * to.origin);
+    transformation = translation * rotation;
+    return true;
+  }
+
   inline void transformPoint(float& x, float& y, float& z)
   {
     Eigen::Vector3f p = transformation * Eigen::Vector3f(x, y, z);
@@ -199,9 +362,35 @@ public:
   }
 
 protected:
+  /** \brief Byte offset of a field within one point, -1 if missing. */
+  int fieldOffset(const std::string& name) const
+  {
+    for (size_t i = 0; i < cloud.fields.size(); ++i)
+    {
+      if (cloud.fields[i].name == name)
+      {
+        return cloud.fields[i].offset;
+      }
+    }
+    return -1;
+  }
+
+  /// pose looked up for one stamp of the scan
+  struct TransformKnot
+  {
+    ros::Time stamp;
+    Eigen::Quaternionf rotation;
+    Eigen::Vector3f origin;
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  static const size_t CLOUD_POOL_SIZE = 3;  ///< messages kept for reuse
+
   Config config_;
   boost::shared_ptr<tf::TransformListener> tf_ptr;  ///< transform listener
+  std::vector<sensor_msgs::PointCloud2Ptr> cloud_pool_;
   Eigen::Affine3f transformation;
+  std::vector<TransformKnot, Eigen::aligned_allocator<TransformKnot> > transform_cache_;
 };
 } /* namespace velodyne_rawdata */
 #endif  // VELODYNE_POINTCLOUD_DATACONTAINERBASE_H
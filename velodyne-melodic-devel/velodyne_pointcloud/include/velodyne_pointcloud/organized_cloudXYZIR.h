@@ -36,15 +36,27 @@
 #include <velodyne_pointcloud/datacontainerbase.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
 #include <string>
+#include <vector>
 
 namespace velodyne_pointcloud
 {
+/** \brief Organized cloud, one point per ring and line.
+ *
+ *  By default each block (or VLP-16 firing) starts a new line, so the
+ *  cloud is num_lasers wide and its height varies with the packets of a
+ *  scan. With azimuth_bins > 0 the cloud instead has one row per ring and
+ *  azimuth_bins columns covering 360 degrees; each return is stored at its
+ *  azimuth bin and the dimensions are the same for every scan. The last
+ *  valid return of a bin wins; missing or out of range returns only fill
+ *  a bin without a valid one. Cells without a return are NaN.
+ */
 class OrganizedCloudXYZIR : public velodyne_rawdata::DataContainerBase
 {
 public:
   OrganizedCloudXYZIR(const double max_range, const double min_range, const std::string& target_frame,
                       const std::string& fixed_frame, const unsigned int num_lasers, const unsigned int scans_per_block,
-                      boost::shared_ptr<tf::TransformListener> tf_ptr = boost::shared_ptr<tf::TransformListener>());
+                      boost::shared_ptr<tf::TransformListener> tf_ptr = boost::shared_ptr<tf::TransformListener>(),
+                      const unsigned int azimuth_bins = 0);
 
   virtual void newLine();
 
@@ -53,9 +65,25 @@ public:
   virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth, const float distance,
                         const float intensity, const float time);
 
+  virtual void addPoints(const float* x, const float* y, const float* z, const uint16_t* ring,
+                         const uint16_t* azimuth, const float* distance, const float* intensity,
+                         const float* time, const size_t count);
+
+  virtual void append(const velodyne_rawdata::DataContainerBase& other);
+
 private:
-  sensor_msgs::PointCloud2Iterator<float> iter_x, iter_y, iter_z, iter_intensity, iter_time;
-  sensor_msgs::PointCloud2Iterator<uint16_t> iter_ring;
+  /// state of a cell of the binned layout
+  enum CellState
+  {
+    CELL_EMPTY = 0,     ///< no return in this scan
+    CELL_FILTERED = 1,  ///< only missing or out of range returns, NaN
+    CELL_VALID = 2      ///< holds a valid return
+  };
+
+  const unsigned int num_lasers_;
+  const unsigned int azimuth_bins_;  ///< columns of the binned layout, 0 for one line per block
+  std::vector<uint8_t> filled_;      ///< CellState of each cell during this scan (binned layout)
+  int offset_x_, offset_y_, offset_z_, offset_intensity_, offset_ring_, offset_time_;
 };
 } /* namespace velodyne_pointcloud */
 #endif  // VELODYNE_POINTCLOUD_ORGANIZED_CLOUDXYZIR_H
@@ -0,0 +1,105 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file
+
+    This class unpacks the packets of one scan on several threads.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_PARALLEL_UNPACK_H
+#define VELODYNE_POINTCLOUD_PARALLEL_UNPACK_H
+
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <velodyne_pointcloud/datacontainerbase.h>
+#include <velodyne_pointcloud/rawdata.h>
+
+namespace velodyne_pointcloud
+{
+/** \brief Unpacks a scan in contiguous packet ranges on a pool of threads.
+ *
+ *  The first range is unpacked on the calling thread directly into the
+ *  output container, every other range into a container owned by its
+ *  worker thread. The partial clouds are appended in packet order, so the
+ *  result is byte-identical to unpacking the packets one after another.
+ */
+class ParallelUnpacker
+{
+public:
+  typedef boost::function<boost::shared_ptr<velodyne_rawdata::DataContainerBase>()> ContainerFactory;
+
+  /** \param data raw data converter shared by all threads
+   *  \param num_threads total number of threads, including the caller
+   *  \param transform_per_packet update the transformation at each packet stamp,
+   *         using the transformations cached in the output container if any
+   */
+  ParallelUnpacker(const boost::shared_ptr<velodyne_rawdata::RawData>& data, const unsigned int num_threads,
+                   const bool transform_per_packet);
+  ~ParallelUnpacker();
+
+  /** \brief Create the worker containers, e.g. after the cloud format changed. */
+  void resetContainers(const ContainerFactory& factory);
+
+  /** \brief Forward a range or frame change to the worker containers. */
+  void configure(const double max_range, const double min_range, const std::string& fixed_frame,
+                 const std::string& target_frame);
+
+  /** \brief Unpack all packets of a scan into an already set up container. */
+  void unpack(const velodyne_msgs::VelodyneScan::ConstPtr& scan_msg, velodyne_rawdata::DataContainerBase& container);
+
+private:
+  void workerLoop(const unsigned int index);
+  void unpackRange(const unsigned int index, velodyne_rawdata::DataContainerBase& container);
+
+  boost::shared_ptr<velodyne_rawdata::RawData> data_;
+  const unsigned int num_threads_;
+  const bool transform_per_packet_;
+
+  /// containers of the worker threads, index 0 (the caller) is unused
+  std::vector<boost::shared_ptr<velodyne_rawdata::DataContainerBase> > containers_;
+
+  boost::thread_group threads_;
+  boost::barrier start_barrier_;
+  boost::barrier done_barrier_;
+  velodyne_msgs::VelodyneScan::ConstPtr scan_msg_;  ///< scan being unpacked
+  bool stop_;
+};
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_PARALLEL_UNPACK_H
@@ -52,8 +52,15 @@ public:
   virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth,
                         const float distance, const float intensity, const float time);
 
+  virtual void addPoints(const float* x, const float* y, const float* z, const uint16_t* ring,
+                         const uint16_t* azimuth, const float* distance, const float* intensity,
+                         const float* time, const size_t count);
+
   sensor_msgs::PointCloud2Iterator<float> iter_x, iter_y, iter_z, iter_intensity, iter_time;
   sensor_msgs::PointCloud2Iterator<uint16_t> iter_ring;
+
+private:
+  int offset_x_, offset_y_, offset_z_, offset_intensity_, offset_ring_, offset_time_;
 };
 }  // namespace velodyne_pointcloud
 
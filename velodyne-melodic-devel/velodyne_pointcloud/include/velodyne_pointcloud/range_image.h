@@ -0,0 +1,110 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef VELODYNE_POINTCLOUD_RANGE_IMAGE_H
+#define VELODYNE_POINTCLOUD_RANGE_IMAGE_H
+
+#include <velodyne_pointcloud/calibration.h>
+#include <velodyne_pointcloud/datacontainerbase.h>
+#include <sensor_msgs/Image.h>
+#include <string>
+#include <vector>
+
+namespace velodyne_pointcloud
+{
+/** \brief Range and intensity images instead of a point cloud.
+ *
+ *  Both images have one row per ring and a fixed number of columns
+ *  covering 360 degrees of azimuth. Zero marks cells without a return in
+ *  range; the last return of a cell wins. Points are never transformed.
+ *
+ *  The range image (16UC1) holds the raw distance of the packet, in
+ *  multiples of the calibration's distance_resolution_m and before
+ *  dist_correction. A column c holds the firings whose encoder azimuth,
+ *  before the rot_correction of the laser, lies in
+ *  [c, c + 1) * 36000 / columns hundredths of a degree. Consumers reproject
+ *  a cell like RawData::unpack() does: with the calibration of the ring,
+ *  add its dist_correction (and two point correction), and subtract its
+ *  rot_correction from the azimuth of the column.
+ *
+ *  The intensity image (mono8) holds the intensity the container is
+ *  given, clamped to [0, 255]. The range image nodelet unpacks with
+ *  RawData::setRawIntensity(), so that is the raw intensity byte of the
+ *  packet, without the focal correction and intensity limits of the
+ *  calibration.
+ */
+class RangeImage : public velodyne_rawdata::DataContainerBase
+{
+public:
+  RangeImage(const double max_range, const double min_range, const Calibration& calibration,
+             const unsigned int columns, const unsigned int scans_per_block, const bool intensity,
+             boost::shared_ptr<tf::TransformListener> tf_ptr = boost::shared_ptr<tf::TransformListener>());
+
+  virtual void newLine();
+
+  virtual void setup(const velodyne_msgs::VelodyneScan::ConstPtr& scan_msg);
+
+  virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth,
+                        const float distance, const float intensity, const float time);
+
+  virtual void addPoints(const float* x, const float* y, const float* z, const uint16_t* ring,
+                         const uint16_t* azimuth, const float* distance, const float* intensity,
+                         const float* time, const size_t count);
+
+  /** \brief Range image of the last scan, reallocated once a subscriber holds it. */
+  const sensor_msgs::ImagePtr& rangeImage() const
+  {
+    return range_image_;
+  }
+
+  /** \brief Intensity image of the last scan, null if disabled. */
+  const sensor_msgs::ImagePtr& intensityImage() const
+  {
+    return intensity_image_;
+  }
+
+private:
+  void setupImage(sensor_msgs::ImagePtr& image, const std::string& encoding, const unsigned int pixel_size,
+                  const std_msgs::Header& header);
+
+  const unsigned int num_lasers_;
+  const unsigned int columns_;
+  const float range_scale_;                ///< 1 / distance_resolution_m
+  std::vector<float> dist_corrections_;    ///< dist_correction of each ring, removed again
+  const bool intensity_;
+  sensor_msgs::ImagePtr range_image_;
+  sensor_msgs::ImagePtr intensity_image_;
+};
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_RANGE_IMAGE_H
@@ -0,0 +1,83 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file
+
+    This class converts raw Velodyne 3D LIDAR packets to range and
+    intensity images.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_RANGE_IMAGE_CONVERT_H
+#define VELODYNE_POINTCLOUD_RANGE_IMAGE_CONVERT_H
+
+#include <string>
+
+#include <ros/ros.h>
+
+#include <velodyne_pointcloud/rawdata.h>
+#include <velodyne_pointcloud/range_image.h>
+
+namespace velodyne_pointcloud
+{
+class RangeImageConvert
+{
+  public:
+    RangeImageConvert(ros::NodeHandle node, ros::NodeHandle private_nh);
+    ~RangeImageConvert() {}
+
+  private:
+    void processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg);
+
+    boost::shared_ptr<velodyne_rawdata::RawData> data_;
+    boost::shared_ptr<RangeImage> container_ptr_;
+    ros::Subscriber velodyne_scan_;
+    ros::Publisher range_output_;
+    ros::Publisher intensity_output_;
+
+    /// configuration parameters
+    typedef struct
+    {
+      double max_range;              ///< maximum range to publish
+      double min_range;              ///< minimum range to publish
+      double view_direction;         ///< center of the published view
+      double view_width;             ///< width of the published view
+      int columns;                   ///< image columns over 360 degrees
+      bool intensity_image;          ///< also publish the intensity image
+    }
+    Config;
+    Config config_;
+};
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_RANGE_IMAGE_CONVERT_H
@@ -129,6 +129,43 @@ typedef struct raw_packet
 }
 raw_packet_t;
 
+/** \brief Per-laser constants derived from the calibration.
+ *
+ *  Built once by RawData::setup() so that the unpack loops only load
+ *  these values instead of re-deriving them for every return.
+ */
+typedef struct laser_constants
+{
+  float dist_correction;
+  float cos_vert_correction;
+  float sin_vert_correction;
+  float rot_correction;        ///< [rad]
+  float cos_rot_correction;
+  float sin_rot_correction;
+  float horiz_offset_correction;
+  float vert_offset_sin_vert;  ///< vert_offset_correction * sin_vert_correction
+  float vert_offset_cos_vert;  ///< vert_offset_correction * cos_vert_correction
+  float dist_correction_x;     ///< two point X value, dist_correction if unavailable
+  float dist_correction_y;     ///< two point Y value, dist_correction if unavailable
+  double two_pt_slope_x;       ///< X interpolation slope, 0 if unavailable
+  double two_pt_slope_y;       ///< Y interpolation slope, 0 if unavailable
+  float focal_offset;          ///< 256 * (1 - focal_distance / 13100)^2
+  float focal_slope;
+  float min_intensity;
+  float max_intensity;
+  uint16_t laser_ring;
+}
+laser_constants_t;
+
+/** \brief One return of a single ring, projected on the horizontal plane. */
+typedef struct ring_return
+{
+  float angle;      ///< bearing in the sensor frame [rad], in [-pi, pi)
+  float range;      ///< distance in the horizontal plane [m]
+  float intensity;
+}
+ring_return_t;
+
 /** \brief Velodyne data conversion class */
 class RawData
 {
@@ -159,16 +196,41 @@ public:
    * @param calibration_file path to the calibration file
    * @param max_range_ cutoff for maximum range
    * @param min_range_ cutoff for minimum range
+   * @param calibration_cache binary cache of the calibration, regenerated
+   *        when missing or stale; not used if empty
    * @returns 0 if successful;
    *           errno value for failure
    */
-  int setupOffline(std::string calibration_file, double max_range_, double min_range_);
+  int setupOffline(std::string calibration_file, double max_range_, double min_range_,
+                   const std::string& calibration_cache = "");
 
   void unpack(const velodyne_msgs::VelodynePacket& pkt, DataContainerBase& data,
               const ros::Time& scan_start_time);
 
+  /** \brief Decode the returns of one ring only.
+   *
+   *  Reads just the lasers of that ring and takes their bearings from
+   *  the block rotation and the laser's rot_correction, without
+   *  computing 3D points, e.g. to publish a laser scan straight from
+   *  the packets. Returns outside the range limits or the view are
+   *  skipped.
+   *
+   *  @param ring laser ring, as in the ring field of the point cloud
+   *  @param returns the ring's returns are appended here
+   */
+  void unpackRing(const velodyne_msgs::VelodynePacket& pkt, uint16_t ring,
+                  std::vector<ring_return_t>& returns) const;
+
   void setParameters(double min_range, double max_range, double view_direction, double view_width);
 
+  /** \brief Report the intensity byte of the packet instead of the corrected intensity.
+   *
+   *  Skips the focal distance correction and the min_intensity /
+   *  max_intensity limits of the calibration, in unpack() and
+   *  unpackRing(). Off by default.
+   */
+  void setRawIntensity(bool raw_intensity);
+
   int scansPerPacket() const;
 
 private:
@@ -177,10 +239,13 @@ private:
   {
     std::string model;
     std::string calibrationFile;  ///< calibration file name
+    std::string calibrationCache; ///< binary calibration cache, empty if unused
     double max_range;             ///< maximum range to publish
     double min_range;             ///< minimum range to publish
     int min_angle;                ///< minimum angle to publish
     int max_angle;                ///< maximum angle to publish
+    bool full_view;               ///< min_angle to max_angle is the whole revolution
+    bool raw_intensity;           ///< no intensity correction, see setRawIntensity()
 
     double tmp_min_angle;
     double tmp_max_angle;
@@ -195,6 +260,51 @@ private:
   float sin_rot_table_[ROTATION_MAX_UNITS];
   float cos_rot_table_[ROTATION_MAX_UNITS];
 
+  /** per-laser constants, indexed by laser number */
+  std::vector<laser_constants_t> laser_constants_;
+
+  /** laser number of each ring, -1 if the calibration has none */
+  std::vector<int> ring_lasers_;
+
+  /** unpack variant selected for the loaded calibration */
+  typedef void (RawData::*UnpackFn)(const velodyne_msgs::VelodynePacket& pkt, DataContainerBase& data,
+                                    const ros::Time& scan_start_time);
+  UnpackFn unpack_fn_;
+
+  /** \brief read the calibration and build the rotation tables
+   *
+   *  Both are loaded from the calibration cache when it matches the
+   *  calibration file, and the cache is rewritten otherwise.
+   *
+   *  @returns false if the calibration file cannot be read
+   */
+  bool loadCalibration();
+
+  /** \brief true if a rotation [1/100 deg] is inside the view */
+  bool rotationInView(int rotation) const;
+
+  /** \brief true if any rotation of an arc is inside the view
+   *
+   *  @param first start of the arc [1/100 deg]
+   *  @param last end of the arc, reached turning forward from first
+   */
+  bool arcInView(int first, int last) const;
+
+  /** \brief append one return of unpackRing(), if it is valid and in view
+   *
+   *  @param data the laser's three bytes of the block
+   *  @param rotation corrected rotation of the firing [1/100 deg]
+   */
+  void addRingReturn(const laser_constants_t& constants, const uint8_t* data, int rotation,
+                     std::vector<ring_return_t>& returns) const;
+
+  /** \brief build the per-laser constants
+   *
+   *  Runs once the calibration has been read, and picks the unpack
+   *  variant matching the features the calibration actually uses.
+   */
+  void buildCorrectionTables();
+
   // timing offset lookup table
   std::vector< std::vector<float> > timing_offsets;
 
@@ -206,7 +316,18 @@ private:
    */
   bool buildTimings();
 
+  /** unpack a packet of 32-laser blocks (HDL-32E, HDL-64E, VLP-32C)
+   *
+   *  Instantiated for each combination of two point distance correction
+   *  and focal intensity correction, so calibrations that do not use
+   *  them skip that math entirely.
+   */
+  template <bool TWO_PT_CORRECTION, bool INTENSITY_CORRECTION>
+  void unpack_blocks(const velodyne_msgs::VelodynePacket& pkt, DataContainerBase& data,
+                     const ros::Time& scan_start_time);
+
   /** add private function to handle the VLP16 **/
+  template <bool TWO_PT_CORRECTION, bool INTENSITY_CORRECTION>
   void unpack_vlp16(const velodyne_msgs::VelodynePacket& pkt, DataContainerBase& data,
                     const ros::Time& scan_start_time);
 };
@@ -50,6 +50,8 @@
 
 #include <velodyne_pointcloud/rawdata.h>
 #include <velodyne_pointcloud/pointcloudXYZIR.h>
+#include <velodyne_pointcloud/parallel_unpack.h>
+#include <velodyne_pointcloud/cloud_decimator.h>
 
 #include <dynamic_reconfigure/server.h>
 #include <velodyne_pointcloud/TransformNodeConfig.h>
@@ -71,6 +73,7 @@ public:
 
 private:
   void processScan(const velodyne_msgs::VelodyneScan::ConstPtr& scanMsg);
+  boost::shared_ptr<velodyne_rawdata::DataContainerBase> createContainer();
 
   // Pointer to dynamic reconfigure service srv_
   boost::shared_ptr<dynamic_reconfigure::Server<velodyne_pointcloud::TransformNodeConfig>> srv_;
@@ -80,6 +83,7 @@ private:
   boost::shared_ptr<velodyne_rawdata::RawData> data_;
   message_filters::Subscriber<velodyne_msgs::VelodyneScan> velodyne_scan_;
   ros::Publisher output_;
+  ros::Publisher decimated_output_;
   boost::shared_ptr<tf::MessageFilter<velodyne_msgs::VelodyneScan>> tf_filter_ptr_;
   boost::shared_ptr<tf::TransformListener> tf_ptr_;
 
@@ -89,9 +93,12 @@ private:
     std::string target_frame;  ///< target frame
     std::string fixed_frame;   ///< fixed frame
     bool organize_cloud;       ///< enable/disable organized cloud structure
+    int azimuth_bins;          ///< organized cloud columns, 0 for one line per block
     double max_range;          ///< maximum range to publish
     double min_range;          ///< minimum range to publish
     uint16_t num_lasers;       ///< number of lasers
+    int num_threads;           ///< threads used to unpack a scan
+    int transform_knots;       ///< poses looked up per scan, 0 for every packet
   }
   Config;
   Config config_;
@@ -99,6 +106,10 @@ private:
   bool first_rcfg_call;
 
   boost::shared_ptr<velodyne_rawdata::DataContainerBase> container_ptr;
+  boost::shared_ptr<ParallelUnpacker> unpacker_;
+
+  CloudDecimator decimator_;
+  sensor_msgs::PointCloud2Ptr decimated_msg_;
 
   // diagnostics updater
   diagnostic_updater::Updater diagnostics_;
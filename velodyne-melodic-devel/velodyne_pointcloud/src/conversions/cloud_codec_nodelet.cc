@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    These ROS nodelets compress Velodyne point clouds for recording or
+    remote transport, and restore them.
+
+*/
+
+#include <ros/ros.h>
+#include <pluginlib/class_list_macros.h>
+#include <nodelet/nodelet.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <velodyne_msgs/VelodyneCompressedCloud.h>
+
+#include "velodyne_pointcloud/cloud_codec.h"
+
+namespace velodyne_pointcloud
+{
+  class CloudEncodeNodelet: public nodelet::Nodelet
+  {
+  public:
+
+    CloudEncodeNodelet() {}
+    ~CloudEncodeNodelet() {}
+
+  private:
+
+    virtual void onInit();
+    void processCloud(const sensor_msgs::PointCloud2::ConstPtr &cloud);
+
+    boost::shared_ptr<CloudCodec> codec_;
+    ros::Subscriber cloud_;
+    ros::Publisher output_;
+  };
+
+  /** @brief Nodelet initialization. */
+  void CloudEncodeNodelet::onInit()
+  {
+    ros::NodeHandle node = getNodeHandle();
+    ros::NodeHandle private_nh = getPrivateNodeHandle();
+
+    double resolution;
+    private_nh.param("resolution", resolution, 0.001);
+    ROS_INFO_STREAM("Compressing clouds at resolution " << resolution << " m");
+    codec_.reset(new CloudCodec(resolution));
+
+    output_ =
+      node.advertise<velodyne_msgs::VelodyneCompressedCloud>("velodyne_points/compressed", 10);
+    cloud_ =
+      node.subscribe("velodyne_points", 10,
+                     &CloudEncodeNodelet::processCloud, this,
+                     ros::TransportHints().tcpNoDelay(true));
+  }
+
+  /** @brief Callback for point clouds. */
+  void CloudEncodeNodelet::processCloud(const sensor_msgs::PointCloud2::ConstPtr &cloud)
+  {
+    if (output_.getNumSubscribers() == 0)         // no one listening?
+      return;                                     // avoid much work
+
+    velodyne_msgs::VelodyneCompressedCloudPtr msg(new velodyne_msgs::VelodyneCompressedCloud);
+    msg->header = cloud->header;
+    msg->format = CloudCodec::FORMAT;
+    if (!codec_->encode(*cloud, msg->data))
+    {
+      ROS_WARN_STREAM_THROTTLE(10, "Skipping cloud whose data does not match its fields");
+      return;
+    }
+    output_.publish(msg);
+  }
+
+  class CloudDecodeNodelet: public nodelet::Nodelet
+  {
+  public:
+
+    CloudDecodeNodelet() {}
+    ~CloudDecodeNodelet() {}
+
+  private:
+
+    virtual void onInit();
+    void processCompressed(const velodyne_msgs::VelodyneCompressedCloud::ConstPtr &msg);
+
+    CloudCodec codec_;
+    ros::Subscriber compressed_;
+    ros::Publisher output_;
+  };
+
+  /** @brief Nodelet initialization. */
+  void CloudDecodeNodelet::onInit()
+  {
+    ros::NodeHandle node = getNodeHandle();
+
+    output_ =
+      node.advertise<sensor_msgs::PointCloud2>("velodyne_points", 10);
+    compressed_ =
+      node.subscribe("velodyne_points/compressed", 10,
+                     &CloudDecodeNodelet::processCompressed, this,
+                     ros::TransportHints().tcpNoDelay(true));
+  }
+
+  /** @brief Callback for compressed clouds. */
+  void CloudDecodeNodelet::processCompressed(const velodyne_msgs::VelodyneCompressedCloud::ConstPtr &msg)
+  {
+    if (output_.getNumSubscribers() == 0)         // no one listening?
+      return;                                     // avoid much work
+
+    if (msg->format != CloudCodec::FORMAT)
+    {
+      ROS_WARN_STREAM_THROTTLE(10, "Unknown compressed cloud format \"" << msg->format << "\"");
+      return;
+    }
+
+    sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2);
+    if (!codec_.decode(msg->data, *cloud))
+    {
+      ROS_WARN_STREAM_THROTTLE(10, "Dropping corrupt compressed cloud");
+      return;
+    }
+    cloud->header = msg->header;
+    output_.publish(cloud);
+  }
+
+} // namespace velodyne_pointcloud
+
+
+PLUGINLIB_EXPORT_CLASS(velodyne_pointcloud::CloudEncodeNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(velodyne_pointcloud::CloudDecodeNodelet, nodelet::Nodelet)
@@ -31,6 +31,15 @@ namespace velodyne_pointcloud
     private_nh.param<double>("min_range", config_.min_range, 10.0);
     private_nh.param<double>("max_range", config_.max_range, 200.0);
     private_nh.param<bool>("organize_cloud", config_.organize_cloud, false);
+    private_nh.param<int>("azimuth_bins", config_.azimuth_bins, 0);
+    private_nh.param<int>("num_threads", config_.num_threads, 1);
+
+    int ring_stride, azimuth_stride;
+    double voxel_size;
+    private_nh.param<int>("decimate_ring_stride", ring_stride, 1);
+    private_nh.param<int>("decimate_azimuth_stride", azimuth_stride, 1);
+    private_nh.param<double>("decimate_voxel_size", voxel_size, 0.0);
+    decimator_.configure(ring_stride, azimuth_stride, voxel_size);
 
     boost::optional<velodyne_pointcloud::Calibration> calibration = data_->setup(private_nh);
     if(calibration)
@@ -43,25 +52,20 @@ namespace velodyne_pointcloud
         ROS_ERROR_STREAM("Could not load calibration file!");
     }
 
-    if(config_.organize_cloud)
-    {
-      container_ptr_ = boost::shared_ptr<OrganizedCloudXYZIR>(
-          new OrganizedCloudXYZIR(config_.max_range, config_.min_range,
-              config_.target_frame, config_.fixed_frame,
-              config_.num_lasers, data_->scansPerPacket()));
-    }
-    else
+    container_ptr_ = createContainer();
+
+    if(config_.num_threads > 1)
     {
-      container_ptr_ = boost::shared_ptr<PointcloudXYZIR>(
-          new PointcloudXYZIR(config_.max_range, config_.min_range,
-              config_.target_frame, config_.fixed_frame,
-              data_->scansPerPacket()));
+      unpacker_.reset(new ParallelUnpacker(data_, config_.num_threads, false));
+      unpacker_->resetContainers(boost::bind(&Convert::createContainer, this));
     }
 
-
     // advertise output point cloud (before subscribing to input data)
     output_ =
       node.advertise<sensor_msgs::PointCloud2>("velodyne_points", 10);
+    if (decimator_.enabled())
+      decimated_output_ =
+        node.advertise<sensor_msgs::PointCloud2>("velodyne_points/decimated", 10);
 
     srv_ = boost::make_shared <dynamic_reconfigure::Server<velodyne_pointcloud::
       CloudNodeConfig> > (private_nh);
@@ -94,6 +98,7 @@ namespace velodyne_pointcloud
                 uint32_t level)
   {
     ROS_INFO("Reconfigure Request");
+    boost::lock_guard<boost::mutex> guard(reconfigure_mtx_);
     data_->setParameters(config.min_range, config.max_range, config.view_direction,
                          config.view_width);
     config_.fixed_frame = config.fixed_frame;
@@ -101,34 +106,48 @@ namespace velodyne_pointcloud
     config_.min_range = config.min_range;
     config_.max_range = config.max_range;
 
-    if(first_rcfg_call || config.organize_cloud != config_.organize_cloud){
+    if(first_rcfg_call || config.organize_cloud != config_.organize_cloud
+       || config.azimuth_bins != config_.azimuth_bins){
         first_rcfg_call = false;
         config_.organize_cloud = config.organize_cloud;
+        config_.azimuth_bins = config.azimuth_bins;
         if(config_.organize_cloud) // TODO only on change
         {
             ROS_INFO_STREAM("Using the organized cloud format...");
-            container_ptr_ = boost::shared_ptr<OrganizedCloudXYZIR>(
-                new OrganizedCloudXYZIR(config_.max_range, config_.min_range,
-                    config_.target_frame, config_.fixed_frame,
-                    config_.num_lasers, data_->scansPerPacket()));
-        }
-        else
-        {
-            container_ptr_ = boost::shared_ptr<PointcloudXYZIR>(
-                new PointcloudXYZIR(config_.max_range, config_.min_range,
-                    config_.target_frame, config_.fixed_frame,
-                    data_->scansPerPacket()));
         }
+        container_ptr_ = createContainer();
+        if(unpacker_)
+            unpacker_->resetContainers(boost::bind(&Convert::createContainer, this));
     }
 
     container_ptr_->configure(config_.max_range, config_.min_range, config_.fixed_frame, config_.target_frame);
+    if(unpacker_)
+        unpacker_->configure(config_.max_range, config_.min_range, config_.fixed_frame, config_.target_frame);
 
   }
 
+  /** @brief Create an empty container for the configured cloud format. */
+  boost::shared_ptr<velodyne_rawdata::DataContainerBase> Convert::createContainer()
+  {
+    if(config_.organize_cloud)
+    {
+      return boost::shared_ptr<OrganizedCloudXYZIR>(
+          new OrganizedCloudXYZIR(config_.max_range, config_.min_range,
+              config_.target_frame, config_.fixed_frame,
+              config_.num_lasers, data_->scansPerPacket(),
+              boost::shared_ptr<tf::TransformListener>(), config_.azimuth_bins));
+    }
+    return boost::shared_ptr<PointcloudXYZIR>(
+        new PointcloudXYZIR(config_.max_range, config_.min_range,
+            config_.target_frame, config_.fixed_frame,
+            data_->scansPerPacket()));
+  }
+
   /** @brief Callback for raw scan messages. */
   void Convert::processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg)
   {
-    if (output_.getNumSubscribers() == 0)         // no one listening?
+    const bool decimate = decimator_.enabled() && decimated_output_.getNumSubscribers() > 0;
+    if (output_.getNumSubscribers() == 0 && !decimate) // no one listening?
       return;                                     // avoid much work
 
     boost::lock_guard<boost::mutex> guard(reconfigure_mtx_);
@@ -136,15 +155,32 @@ namespace velodyne_pointcloud
     container_ptr_->setup(scanMsg);
 
     // process each packet provided by the driver
-    for (size_t i = 0; i < scanMsg->packets.size(); ++i)
+    if (unpacker_)
     {
-      data_->unpack(scanMsg->packets[i], *container_ptr_, scanMsg->header.stamp);
+      unpacker_->unpack(scanMsg, *container_ptr_);
+    }
+    else
+    {
+      for (size_t i = 0; i < scanMsg->packets.size(); ++i)
+      {
+        data_->unpack(scanMsg->packets[i], *container_ptr_, scanMsg->header.stamp);
+      }
     }
 
     // publish the accumulated cloud message
     diag_topic_->tick(scanMsg->header.stamp);
     diagnostics_.update();
-    output_.publish(container_ptr_->finishCloud());
+
+    // the decimated cloud comes from the same unpacked scan
+    if (decimate)
+    {
+      if (!decimated_msg_ || decimated_msg_.use_count() != 1)
+        decimated_msg_ = boost::make_shared<sensor_msgs::PointCloud2>();
+      if (decimator_.decimate(container_ptr_->finishCloud(), *decimated_msg_))
+        decimated_output_.publish(decimated_msg_);
+    }
+    if (output_.getNumSubscribers() > 0)
+      output_.publish(container_ptr_->finishCloudPtr());
   }
 
 } // namespace velodyne_pointcloud
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    This class converts raw Velodyne 3D LIDAR packets of one ring to
+    LaserScan messages.
+
+*/
+
+#include "velodyne_pointcloud/laserscan_convert.h"
+
+#include <cmath>
+
+#include <sensor_msgs/LaserScan.h>
+
+namespace velodyne_pointcloud
+{
+  /** @brief Constructor. */
+  LaserScanConvert::LaserScanConvert(ros::NodeHandle node, ros::NodeHandle private_nh):
+    data_(new velodyne_rawdata::RawData())
+  {
+    // Get startup parameters
+    private_nh.param<double>("min_range", config_.min_range, 0.9);
+    private_nh.param<double>("max_range", config_.max_range, 130.0);
+    private_nh.param<double>("view_direction", config_.view_direction, 0.0);
+    private_nh.param<double>("view_width", config_.view_width, 2 * M_PI);
+    private_nh.param<int>("ring", config_.ring, -1);
+    private_nh.param<double>("resolution", config_.resolution, 0.007);
+
+    boost::optional<velodyne_pointcloud::Calibration> calibration = data_->setup(private_nh);
+    if (!calibration)
+    {
+      ROS_ERROR_STREAM("Could not load calibration file!");
+      return;
+    }
+    config_.resolution = std::abs(config_.resolution);
+    if (config_.resolution < 0.001)
+    {
+      ROS_ERROR_STREAM("resolution must be at least 0.001 rad, got " << config_.resolution);
+      return;
+    }
+    data_->setParameters(config_.min_range, config_.max_range,
+                         config_.view_direction, config_.view_width);
+
+    // default to the ring closest to being level, as velodyne_laserscan
+    const int ring_count = calibration.get().num_lasers;
+    if (config_.ring < 0 || config_.ring >= ring_count)
+    {
+      if (ring_count > 32)
+        config_.ring = 57;                        // HDL-64E
+      else if (ring_count > 16)
+        config_.ring = 23;                        // HDL-32E
+      else
+        config_.ring = 8;                         // VLP-16
+    }
+    ROS_INFO_STREAM("Extracting ring " << config_.ring << " of " << ring_count);
+
+    // advertise output scan (before subscribing to input data)
+    output_ =
+      node.advertise<sensor_msgs::LaserScan>("scan", 10);
+
+    // subscribe to VelodyneScan packets
+    velodyne_scan_ =
+      node.subscribe("velodyne_packets", 10,
+                     &LaserScanConvert::processScan, this,
+                     ros::TransportHints().tcpNoDelay(true));
+  }
+
+  /** @brief Callback for raw scan messages. */
+  void LaserScanConvert::processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg)
+  {
+    if (output_.getNumSubscribers() == 0)         // no one listening?
+      return;                                     // avoid much work
+
+    // decode only the lasers of the published ring
+    returns_.clear();
+    for (size_t i = 0; i < scanMsg->packets.size(); ++i)
+    {
+      data_->unpackRing(scanMsg->packets[i], config_.ring, returns_);
+    }
+
+    const float resolution = config_.resolution;
+    const size_t size = 2.0 * M_PI / resolution;
+    sensor_msgs::LaserScanPtr scan(new sensor_msgs::LaserScan());
+    scan->header = scanMsg->header;
+    scan->angle_increment = resolution;
+    scan->angle_min = -M_PI;
+    scan->angle_max = M_PI;
+    scan->range_min = config_.min_range;
+    scan->range_max = config_.max_range;
+    scan->time_increment = 0.0;
+    scan->ranges.resize(size, INFINITY);
+    scan->intensities.resize(size);
+
+    for (size_t i = 0; i < returns_.size(); ++i)
+    {
+      const int bin = (returns_[i].angle + static_cast<float>(M_PI)) / resolution;
+      if (bin >= 0 && bin < static_cast<int>(size))
+      {
+        scan->ranges[bin] = returns_[i].range;
+        scan->intensities[bin] = returns_[i].intensity;
+      }
+    }
+
+    output_.publish(scan);
+  }
+
+} // namespace velodyne_pointcloud
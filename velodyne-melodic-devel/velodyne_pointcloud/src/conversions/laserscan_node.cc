@@ -0,0 +1,30 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** \file
+
+    This ROS node converts raw Velodyne LIDAR packets of one ring to
+    LaserScan messages.
+
+*/
+
+#include <ros/ros.h>
+#include "velodyne_pointcloud/laserscan_convert.h"
+
+/** Main node entry point. */
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "laserscan_node");
+  ros::NodeHandle node;
+  ros::NodeHandle priv_nh("~");
+
+  // create conversion class, which subscribes to raw data
+  velodyne_pointcloud::LaserScanConvert conv(node, priv_nh);
+
+  // handle callbacks until shut down
+  ros::spin();
+
+  return 0;
+}
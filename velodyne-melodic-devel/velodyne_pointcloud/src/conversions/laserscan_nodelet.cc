@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    This ROS nodelet converts raw Velodyne 3D LIDAR packets of one ring
+    to LaserScan messages.
+
+*/
+
+#include <ros/ros.h>
+#include <pluginlib/class_list_macros.h>
+#include <nodelet/nodelet.h>
+
+#include "velodyne_pointcloud/laserscan_convert.h"
+
+namespace velodyne_pointcloud
+{
+  class LaserScanNodelet: public nodelet::Nodelet
+  {
+  public:
+
+    LaserScanNodelet() {}
+    ~LaserScanNodelet() {}
+
+  private:
+
+    virtual void onInit();
+    boost::shared_ptr<LaserScanConvert> conv_;
+  };
+
+  /** @brief Nodelet initialization. */
+  void LaserScanNodelet::onInit()
+  {
+    conv_.reset(new LaserScanConvert(getNodeHandle(), getPrivateNodeHandle()));
+  }
+
+} // namespace velodyne_pointcloud
+
+
+PLUGINLIB_EXPORT_CLASS(velodyne_pointcloud::LaserScanNodelet, nodelet::Nodelet)
@@ -1,5 +1,6 @@
 
 #include <velodyne_pointcloud/organized_cloudXYZIR.h>
+#include <cstring>
 
 namespace velodyne_pointcloud
 {
@@ -8,73 +9,149 @@ namespace velodyne_pointcloud
       const double max_range, const double min_range,
       const std::string& target_frame, const std::string& fixed_frame,
       const unsigned int num_lasers, const unsigned int scans_per_block,
-      boost::shared_ptr<tf::TransformListener> tf_ptr)
+      boost::shared_ptr<tf::TransformListener> tf_ptr, const unsigned int azimuth_bins)
     : DataContainerBase(
         max_range, min_range, target_frame, fixed_frame,
-        num_lasers, 0, false, scans_per_block, tf_ptr, 6,
+        azimuth_bins ? azimuth_bins : num_lasers, azimuth_bins ? num_lasers : 0,
+        false, scans_per_block, tf_ptr, 6,
         "x", 1, sensor_msgs::PointField::FLOAT32,
         "y", 1, sensor_msgs::PointField::FLOAT32,
         "z", 1, sensor_msgs::PointField::FLOAT32,
         "intensity", 1, sensor_msgs::PointField::FLOAT32,
         "ring", 1, sensor_msgs::PointField::UINT16,
         "time", 1, sensor_msgs::PointField::FLOAT32),
-        iter_x(cloud, "x"), iter_y(cloud, "y"), iter_z(cloud, "z"),
-        iter_intensity(cloud, "intensity"), iter_ring(cloud, "ring"), iter_time(cloud, "time")
+        num_lasers_(num_lasers), azimuth_bins_(azimuth_bins),
+        offset_x_(fieldOffset("x")), offset_y_(fieldOffset("y")), offset_z_(fieldOffset("z")),
+        offset_intensity_(fieldOffset("intensity")), offset_ring_(fieldOffset("ring")),
+        offset_time_(fieldOffset("time"))
   {
   }
 
   void OrganizedCloudXYZIR::newLine()
   {
-    iter_x = iter_x + config_.init_width;
-    iter_y = iter_y + config_.init_width;
-    iter_z = iter_z + config_.init_width;
-    iter_ring = iter_ring + config_.init_width;
-    iter_intensity = iter_intensity + config_.init_width;
-    iter_time = iter_time + config_.init_width;
+    // the binned layout does not depend on blocks
+    if (azimuth_bins_)
+      return;
+
     ++cloud.height;
+    if (cloud.data.size() < cloud.height * cloud.row_step)
+      cloud.data.resize(cloud.height * cloud.row_step);
   }
 
   void OrganizedCloudXYZIR::setup(const velodyne_msgs::VelodyneScan::ConstPtr& scan_msg){
     DataContainerBase::setup(scan_msg);
-    iter_x = sensor_msgs::PointCloud2Iterator<float>(cloud, "x");
-    iter_y = sensor_msgs::PointCloud2Iterator<float>(cloud, "y");
-    iter_z = sensor_msgs::PointCloud2Iterator<float>(cloud, "z");
-    iter_intensity = sensor_msgs::PointCloud2Iterator<float>(cloud, "intensity");
-    iter_ring = sensor_msgs::PointCloud2Iterator<uint16_t >(cloud, "ring");
-    iter_time = sensor_msgs::PointCloud2Iterator<float >(cloud, "time");
+    if (!azimuth_bins_)
+    {
+      // returns outside the view are never written, do not leak the last scan
+      std::fill(cloud.data.begin(), cloud.data.end(), 0);
+      return;
+    }
+
+    // fixed size, start with a NaN point in every cell
+    const size_t cells = static_cast<size_t>(azimuth_bins_) * num_lasers_;
+    cloud.data.resize(cells * cloud.point_step);
+    filled_.assign(cells, CELL_EMPTY);
+    const float nan = nanf("");
+    const float time = 0;
+    for (uint16_t ring = 0; ring < num_lasers_; ++ring)
+    {
+      uint8_t* out = &cloud.data[0] + ring * cloud.row_step;
+      for (unsigned int bin = 0; bin < azimuth_bins_; ++bin, out += cloud.point_step)
+      {
+        memcpy(out + offset_x_, &nan, sizeof(float));
+        memcpy(out + offset_y_, &nan, sizeof(float));
+        memcpy(out + offset_z_, &nan, sizeof(float));
+        memcpy(out + offset_intensity_, &nan, sizeof(float));
+        memcpy(out + offset_ring_, &ring, sizeof(uint16_t));
+        memcpy(out + offset_time_, &time, sizeof(float));
+      }
+    }
   }
 
 
   void OrganizedCloudXYZIR::addPoint(float x, float y, float z,
-      const uint16_t ring, const uint16_t /*azimuth*/, const float distance, const float intensity, const float time)
+      const uint16_t ring, const uint16_t azimuth, const float distance, const float intensity, const float time)
+  {
+    addPoints(&x, &y, &z, &ring, &azimuth, &distance, &intensity, &time, 1);
+  }
+
+  void OrganizedCloudXYZIR::addPoints(const float* x, const float* y, const float* z,
+      const uint16_t* ring, const uint16_t* azimuth, const float* distance,
+      const float* intensity, const float* time, const size_t count)
   {
     /** The laser values are not ordered, the organized structure
      * needs ordered neighbour points. The right order is defined
-     * by the laser_ring value.
-     * To keep the right ordering, the filtered values are set to
-     * NaN.
+     * by the laser_ring value (and the azimuth bin for the binned
+     * layout). To keep the right ordering, the filtered values are
+     * set to NaN.
      */
-    if (pointInRange(distance))
+    // the current line is the one opened by the last newLine(); a 64
+    // laser packet fills more lines than scans_per_packet accounts for
+    if (!azimuth_bins_ && cloud.data.size() < (cloud.height + 1) * cloud.row_step)
+      cloud.data.resize((cloud.height + 1) * cloud.row_step);
+    uint8_t* row = &cloud.data[0] + cloud.height * cloud.row_step;
+    const float nan = nanf("");
+
+    for (size_t i = 0; i < count; ++i)
     {
-      if(config_.transform)
-        transformPoint(x, y, z);
+      // a missing return has a NaN distance, which is never in range
+      const bool valid = pointInRange(distance[i]);
+      uint8_t* out;
+      if (azimuth_bins_)
+      {
+        // a valid return replaces anything, a filtered one only an empty cell
+        const size_t bin = std::min<size_t>(static_cast<size_t>(azimuth[i]) * azimuth_bins_ / 36000,
+                                            azimuth_bins_ - 1);
+        const size_t cell = ring[i] * azimuth_bins_ + bin;
+        if (!valid && filled_[cell] == CELL_VALID)
+          continue;
+        filled_[cell] = valid ? CELL_VALID : CELL_FILTERED;
+        out = &cloud.data[0] + cell * cloud.point_step;
+      }
+      else
+      {
+        out = row + ring[i] * cloud.point_step;
+      }
+
+      float px = nan, py = nan, pz = nan, pi = nan;
+      if (valid)
+      {
+        px = x[i];
+        py = y[i];
+        pz = z[i];
+        pi = intensity[i];
+        if(config_.transform)
+          transformPoint(px, py, pz);
+      }
 
-      *(iter_x+ring) = x;
-      *(iter_y+ring) = y;
-      *(iter_z+ring) = z;
-      *(iter_intensity+ring) = intensity;
-      *(iter_ring+ring) = ring;
-      *(iter_time+time) = time;
+      memcpy(out + offset_x_, &px, sizeof(float));
+      memcpy(out + offset_y_, &py, sizeof(float));
+      memcpy(out + offset_z_, &pz, sizeof(float));
+      memcpy(out + offset_intensity_, &pi, sizeof(float));
+      memcpy(out + offset_ring_, &ring[i], sizeof(uint16_t));
+      memcpy(out + offset_time_, &time[i], sizeof(float));
     }
-    else
+  }
+
+  void OrganizedCloudXYZIR::append(const velodyne_rawdata::DataContainerBase& other)
+  {
+    if (!azimuth_bins_)
     {
-      *(iter_x+ring) = nanf("");
-      *(iter_y+ring) = nanf("");
-      *(iter_z+ring) = nanf("");
-      *(iter_intensity+ring) = nanf("");
-      *(iter_ring+ring) = ring;
-      *(iter_time+time) = time;
+      DataContainerBase::append(other);
+      return;
+    }
+
+    // the later packets win by the rule of addPoints(), like serial unpacking
+    const OrganizedCloudXYZIR& binned = dynamic_cast<const OrganizedCloudXYZIR&>(other);
+    for (size_t cell = 0; cell < filled_.size(); ++cell)
+    {
+      const uint8_t state = binned.filled_[cell];
+      if (state == CELL_VALID || (state == CELL_FILTERED && filled_[cell] != CELL_VALID))
+      {
+        memcpy(&cloud.data[cell * cloud.point_step], &binned.cloud.data[cell * cloud.point_step],
+               cloud.point_step);
+        filled_[cell] = state;
+      }
     }
   }
 }
-
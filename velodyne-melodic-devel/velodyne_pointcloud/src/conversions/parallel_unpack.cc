@@ -0,0 +1,113 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    This class unpacks the packets of one scan on several threads.
+
+*/
+
+#include "velodyne_pointcloud/parallel_unpack.h"
+
+#include <boost/bind.hpp>
+
+namespace velodyne_pointcloud
+{
+  /** @brief Constructor, starts num_threads - 1 worker threads. */
+  ParallelUnpacker::ParallelUnpacker(const boost::shared_ptr<velodyne_rawdata::RawData>& data,
+                                     const unsigned int num_threads,
+                                     const bool transform_per_packet):
+    data_(data), num_threads_(num_threads > 0 ? num_threads : 1),
+    transform_per_packet_(transform_per_packet),
+    containers_(num_threads_),
+    start_barrier_(num_threads_), done_barrier_(num_threads_),
+    stop_(false)
+  {
+    for (unsigned int i = 1; i < num_threads_; ++i)
+    {
+      threads_.create_thread(boost::bind(&ParallelUnpacker::workerLoop, this, i));
+    }
+    ROS_INFO_STREAM("Unpacking packets on " << num_threads_ << " threads");
+  }
+
+  ParallelUnpacker::~ParallelUnpacker()
+  {
+    stop_ = true;
+    start_barrier_.wait();
+    threads_.join_all();
+  }
+
+  void ParallelUnpacker::resetContainers(const ContainerFactory& factory)
+  {
+    for (unsigned int i = 1; i < num_threads_; ++i)
+    {
+      containers_[i] = factory();
+    }
+  }
+
+  void ParallelUnpacker::configure(const double max_range, const double min_range,
+                                   const std::string& fixed_frame, const std::string& target_frame)
+  {
+    for (unsigned int i = 1; i < num_threads_; ++i)
+    {
+      if (containers_[i])
+        containers_[i]->configure(max_range, min_range, fixed_frame, target_frame);
+    }
+  }
+
+  void ParallelUnpacker::unpack(const velodyne_msgs::VelodyneScan::ConstPtr& scan_msg,
+                                velodyne_rawdata::DataContainerBase& container)
+  {
+    scan_msg_ = scan_msg;
+    if (transform_per_packet_)
+    {
+      for (unsigned int i = 1; i < num_threads_; ++i)
+      {
+        containers_[i]->shareTransformations(container);
+      }
+    }
+
+    // the barriers publish scan_msg_ to the workers and their clouds back
+    start_barrier_.wait();
+    unpackRange(0, container);
+    done_barrier_.wait();
+
+    for (unsigned int i = 1; i < num_threads_; ++i)
+    {
+      container.append(*containers_[i]);
+    }
+    scan_msg_.reset();
+  }
+
+  void ParallelUnpacker::workerLoop(const unsigned int index)
+  {
+    while (true)
+    {
+      start_barrier_.wait();
+      if (stop_)
+        return;
+      containers_[index]->setup(scan_msg_);
+      unpackRange(index, *containers_[index]);
+      done_barrier_.wait();
+    }
+  }
+
+  /** @brief Unpack the index-th contiguous range of packets. */
+  void ParallelUnpacker::unpackRange(const unsigned int index,
+                                     velodyne_rawdata::DataContainerBase& container)
+  {
+    const size_t npackets = scan_msg_->packets.size();
+    const size_t begin = npackets * index / num_threads_;
+    const size_t end = npackets * (index + 1) / num_threads_;
+
+    for (size_t i = begin; i < end; ++i)
+    {
+      if (transform_per_packet_)
+        container.updateTransformation(scan_msg_->packets[i].stamp);
+      data_->unpack(scan_msg_->packets[i], container, scan_msg_->header.stamp);
+    }
+  }
+
+} // namespace velodyne_pointcloud
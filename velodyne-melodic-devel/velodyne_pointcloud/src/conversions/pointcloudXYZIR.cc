@@ -2,6 +2,7 @@
 
 
 #include <velodyne_pointcloud/pointcloudXYZIR.h>
+#include <cstring>
 
 namespace velodyne_pointcloud 
 {
@@ -20,7 +21,10 @@ namespace velodyne_pointcloud
         "ring", 1, sensor_msgs::PointField::UINT16,
         "time", 1, sensor_msgs::PointField::FLOAT32),
         iter_x(cloud, "x"), iter_y(cloud, "y"), iter_z(cloud, "z"),
-        iter_ring(cloud, "ring"), iter_intensity(cloud, "intensity"), iter_time(cloud, "time")
+        iter_ring(cloud, "ring"), iter_intensity(cloud, "intensity"), iter_time(cloud, "time"),
+        offset_x_(fieldOffset("x")), offset_y_(fieldOffset("y")), offset_z_(fieldOffset("z")),
+        offset_intensity_(fieldOffset("intensity")), offset_ring_(fieldOffset("ring")),
+        offset_time_(fieldOffset("time"))
     {};
 
   void PointcloudXYZIR::setup(const velodyne_msgs::VelodyneScan::ConstPtr& scan_msg){
@@ -60,5 +64,40 @@ namespace velodyne_pointcloud
     ++iter_intensity;
     ++iter_time;
   }
-}
 
+  void PointcloudXYZIR::addPoints(const float* x, const float* y, const float* z,
+      const uint16_t* ring, const uint16_t* /*azimuth*/, const float* distance,
+      const float* intensity, const float* time, const size_t count)
+  {
+    // points are packed, so the next free slot follows the last written one
+    uint8_t* out = &cloud.data[0] + cloud.width * cloud.point_step;
+    uint32_t added = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      if(!pointInRange(distance[i])) continue;
+
+      float px = x[i], py = y[i], pz = z[i];
+      if(config_.transform)
+        transformPoint(px, py, pz);
+
+      memcpy(out + offset_x_, &px, sizeof(float));
+      memcpy(out + offset_y_, &py, sizeof(float));
+      memcpy(out + offset_z_, &pz, sizeof(float));
+      memcpy(out + offset_intensity_, &intensity[i], sizeof(float));
+      memcpy(out + offset_ring_, &ring[i], sizeof(uint16_t));
+      memcpy(out + offset_time_, &time[i], sizeof(float));
+      out += cloud.point_step;
+      ++added;
+    }
+
+    // keep the iterators in sync for subsequent addPoint() calls
+    cloud.width += added;
+    iter_x = iter_x + added;
+    iter_y = iter_y + added;
+    iter_z = iter_z + added;
+    iter_ring = iter_ring + added;
+    iter_intensity = iter_intensity + added;
+    iter_time = iter_time + added;
+  }
+}
@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+#include <velodyne_pointcloud/range_image.h>
+#include <sensor_msgs/image_encodings.h>
+#include <algorithm>
+#include <cstring>
+
+namespace velodyne_pointcloud
+{
+
+  RangeImage::RangeImage(
+      const double max_range, const double min_range,
+      const Calibration& calibration, const unsigned int columns,
+      const unsigned int scans_per_block, const bool intensity,
+      boost::shared_ptr<tf::TransformListener> tf_ptr)
+    : DataContainerBase(
+        max_range, min_range, "", "", columns, calibration.num_lasers, false, scans_per_block, tf_ptr, 0),
+      num_lasers_(calibration.num_lasers), columns_(columns),
+      range_scale_(1.0f / calibration.distance_resolution_m),
+      dist_corrections_(calibration.num_lasers, 0.0f), intensity_(intensity)
+  {
+    for (size_t i = 0; i < calibration.laser_corrections.size(); ++i)
+    {
+      const LaserCorrection& correction = calibration.laser_corrections[i];
+      if (correction.laser_ring >= 0 && correction.laser_ring < static_cast<int>(num_lasers_))
+        dist_corrections_[correction.laser_ring] = correction.dist_correction;
+    }
+  }
+
+  void RangeImage::newLine()
+  {}
+
+  void RangeImage::setupImage(sensor_msgs::ImagePtr& image, const std::string& encoding,
+                              const unsigned int pixel_size, const std_msgs::Header& header)
+  {
+    // do not touch an image a subscriber may still be reading
+    if (!image || image.use_count() > 1)
+      image = boost::make_shared<sensor_msgs::Image>();
+
+    image->header = header;
+    image->height = num_lasers_;
+    image->width = columns_;
+    image->encoding = encoding;
+    image->is_bigendian = 0;
+    image->step = columns_ * pixel_size;
+    image->data.assign(image->step * image->height, 0);
+  }
+
+  void RangeImage::setup(const velodyne_msgs::VelodyneScan::ConstPtr& scan_msg)
+  {
+    DataContainerBase::setup(scan_msg);
+    setupImage(range_image_, sensor_msgs::image_encodings::TYPE_16UC1, sizeof(uint16_t), scan_msg->header);
+    if (intensity_)
+      setupImage(intensity_image_, sensor_msgs::image_encodings::MONO8, sizeof(uint8_t), scan_msg->header);
+  }
+
+  void RangeImage::addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth,
+                            const float distance, const float intensity, const float time)
+  {
+    addPoints(&x, &y, &z, &ring, &azimuth, &distance, &intensity, &time, 1);
+  }
+
+  void RangeImage::addPoints(const float* /*x*/, const float* /*y*/, const float* /*z*/,
+      const uint16_t* ring, const uint16_t* azimuth, const float* distance,
+      const float* intensity, const float* /*time*/, const size_t count)
+  {
+    uint8_t* range_data = &range_image_->data[0];
+    uint8_t* intensity_data = intensity_ ? &intensity_image_->data[0] : NULL;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      // NaN distances of missing returns fail this check, too
+      if (!pointInRange(distance[i]) || ring[i] >= num_lasers_)
+        continue;
+
+      const size_t column = std::min<size_t>(static_cast<size_t>(azimuth[i]) * columns_ / 36000, columns_ - 1);
+      const size_t cell = ring[i] * columns_ + column;
+
+      // back to the raw distance of the packet, which the float error cannot round off
+      const float raw_distance = (distance[i] - dist_corrections_[ring[i]]) * range_scale_;
+      const uint16_t range = static_cast<uint16_t>(std::min(std::max(raw_distance + 0.5f, 0.0f), 65535.0f));
+      memcpy(range_data + cell * sizeof(uint16_t), &range, sizeof(uint16_t));
+
+      if (intensity_data)
+        intensity_data[cell] = static_cast<uint8_t>(std::min(std::max(intensity[i] + 0.5f, 0.0f), 255.0f));
+    }
+  }
+}
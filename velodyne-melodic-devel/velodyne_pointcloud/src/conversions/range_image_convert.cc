@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    This class converts raw Velodyne 3D LIDAR packets to range and
+    intensity images.
+
+*/
+
+#include "velodyne_pointcloud/range_image_convert.h"
+
+#include <sensor_msgs/Image.h>
+
+namespace velodyne_pointcloud
+{
+  /** @brief Constructor. */
+  RangeImageConvert::RangeImageConvert(ros::NodeHandle node, ros::NodeHandle private_nh):
+    data_(new velodyne_rawdata::RawData())
+  {
+    // Get startup parameters
+    private_nh.param<double>("min_range", config_.min_range, 0.9);
+    private_nh.param<double>("max_range", config_.max_range, 130.0);
+    private_nh.param<double>("view_direction", config_.view_direction, 0.0);
+    private_nh.param<double>("view_width", config_.view_width, 2 * M_PI);
+    private_nh.param<int>("columns", config_.columns, 1800);
+    private_nh.param<bool>("intensity_image", config_.intensity_image, true);
+
+    boost::optional<velodyne_pointcloud::Calibration> calibration = data_->setup(private_nh);
+    if (!calibration)
+    {
+      ROS_ERROR_STREAM("Could not load calibration file!");
+      return;
+    }
+    if (config_.columns <= 0)
+    {
+      ROS_ERROR_STREAM("columns must be positive, got " << config_.columns);
+      return;
+    }
+    data_->setParameters(config_.min_range, config_.max_range,
+                         config_.view_direction, config_.view_width);
+    data_->setRawIntensity(true);
+
+    container_ptr_.reset(new RangeImage(config_.max_range, config_.min_range,
+                                        calibration.get(), config_.columns,
+                                        data_->scansPerPacket(),
+                                        config_.intensity_image));
+
+    // advertise output images (before subscribing to input data)
+    range_output_ =
+      node.advertise<sensor_msgs::Image>("velodyne_range_image", 10);
+    if (config_.intensity_image)
+      intensity_output_ =
+        node.advertise<sensor_msgs::Image>("velodyne_intensity_image", 10);
+
+    // subscribe to VelodyneScan packets
+    velodyne_scan_ =
+      node.subscribe("velodyne_packets", 10,
+                     &RangeImageConvert::processScan, this,
+                     ros::TransportHints().tcpNoDelay(true));
+  }
+
+  /** @brief Callback for raw scan messages. */
+  void RangeImageConvert::processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg)
+  {
+    if (range_output_.getNumSubscribers() == 0 &&
+        (!intensity_output_ || intensity_output_.getNumSubscribers() == 0))
+      return;                                     // avoid much work
+
+    container_ptr_->setup(scanMsg);
+
+    // process each packet provided by the driver
+    for (size_t i = 0; i < scanMsg->packets.size(); ++i)
+    {
+      data_->unpack(scanMsg->packets[i], *container_ptr_, scanMsg->header.stamp);
+    }
+
+    range_output_.publish(container_ptr_->rangeImage());
+    if (config_.intensity_image)
+      intensity_output_.publish(container_ptr_->intensityImage());
+  }
+
+} // namespace velodyne_pointcloud
@@ -0,0 +1,30 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** \file
+
+    This ROS node converts raw Velodyne LIDAR packets to range and
+    intensity images.
+
+*/
+
+#include <ros/ros.h>
+#include "velodyne_pointcloud/range_image_convert.h"
+
+/** Main node entry point. */
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "range_image_node");
+  ros::NodeHandle node;
+  ros::NodeHandle priv_nh("~");
+
+  // create conversion class, which subscribes to raw data
+  velodyne_pointcloud::RangeImageConvert conv(node, priv_nh);
+
+  // handle callbacks until shut down
+  ros::spin();
+
+  return 0;
+}
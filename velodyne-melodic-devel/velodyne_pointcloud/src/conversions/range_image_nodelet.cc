@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    This ROS nodelet converts raw Velodyne 3D LIDAR packets to range
+    and intensity images.
+
+*/
+
+#include <ros/ros.h>
+#include <pluginlib/class_list_macros.h>
+#include <nodelet/nodelet.h>
+
+#include "velodyne_pointcloud/range_image_convert.h"
+
+namespace velodyne_pointcloud
+{
+  class RangeImageNodelet: public nodelet::Nodelet
+  {
+  public:
+
+    RangeImageNodelet() {}
+    ~RangeImageNodelet() {}
+
+  private:
+
+    virtual void onInit();
+    boost::shared_ptr<RangeImageConvert> conv_;
+  };
+
+  /** @brief Nodelet initialization. */
+  void RangeImageNodelet::onInit()
+  {
+    conv_.reset(new RangeImageConvert(getNodeHandle(), getPrivateNodeHandle()));
+  }
+
+} // namespace velodyne_pointcloud
+
+
+PLUGINLIB_EXPORT_CLASS(velodyne_pointcloud::RangeImageNodelet, nodelet::Nodelet)
@@ -44,25 +44,31 @@ namespace velodyne_pointcloud
     }
 
     config_.target_frame = config_.fixed_frame = "velodyne";
+    config_.azimuth_bins = 0;
     tf_ptr_ = boost::make_shared<tf::TransformListener>();
 
-    if(config_.organize_cloud)
-    {
-      container_ptr = boost::shared_ptr<OrganizedCloudXYZIR>(
-          new OrganizedCloudXYZIR(config_.max_range, config_.min_range, config_.target_frame, config_.fixed_frame,
-                                  config_.num_lasers, data_->scansPerPacket(), tf_ptr_));
-    }
-    else
+    container_ptr = createContainer();
+
+    private_nh.param<int>("num_threads", config_.num_threads, 1);
+    if(config_.num_threads > 1)
     {
-      container_ptr = boost::shared_ptr<PointcloudXYZIR>(
-          new PointcloudXYZIR(config_.max_range, config_.min_range,
-                              config_.target_frame, config_.fixed_frame,
-                              data_->scansPerPacket(), tf_ptr_));
+      unpacker_.reset(new ParallelUnpacker(data_, config_.num_threads, true));
+      unpacker_->resetContainers(boost::bind(&Transform::createContainer, this));
     }
 
+    int ring_stride, azimuth_stride;
+    double voxel_size;
+    private_nh.param<int>("decimate_ring_stride", ring_stride, 1);
+    private_nh.param<int>("decimate_azimuth_stride", azimuth_stride, 1);
+    private_nh.param<double>("decimate_voxel_size", voxel_size, 0.0);
+    decimator_.configure(ring_stride, azimuth_stride, voxel_size);
+
     // advertise output point cloud (before subscribing to input data)
     output_ =
       node.advertise<sensor_msgs::PointCloud2>("velodyne_points", 10);
+    if (decimator_.enabled())
+      decimated_output_ =
+        node.advertise<sensor_msgs::PointCloud2>("velodyne_points/decimated", 10);
 
     srv_ = boost::make_shared<dynamic_reconfigure::Server<TransformNodeCfg>> (private_nh);
     dynamic_reconfigure::Server<TransformNodeCfg>::CallbackType f;
@@ -95,35 +101,51 @@ namespace velodyne_pointcloud
       velodyne_pointcloud::TransformNodeConfig &config, uint32_t level)
   {
     ROS_INFO_STREAM("Reconfigure request.");
+    boost::lock_guard<boost::mutex> guard(reconfigure_mtx_);
     data_->setParameters(config.min_range, config.max_range,
                          config.view_direction, config.view_width);
     config_.target_frame = tf::resolve(tf_prefix_, config.frame_id);
     ROS_INFO_STREAM("Target frame ID now: " << config_.target_frame);
     config_.min_range = config.min_range;
     config_.max_range = config.max_range;
+    config_.transform_knots = config.transform_knots;
 
-    boost::lock_guard<boost::mutex> guard(reconfigure_mtx_);
-
-    if(first_rcfg_call || config.organize_cloud != config_.organize_cloud){
+    if(first_rcfg_call || config.organize_cloud != config_.organize_cloud
+       || config.azimuth_bins != config_.azimuth_bins){
       first_rcfg_call = false;
       config_.organize_cloud = config.organize_cloud;
+      config_.azimuth_bins = config.azimuth_bins;
       if(config_.organize_cloud)
       {
         ROS_INFO_STREAM("Using the organized cloud format...");
-        container_ptr = boost::shared_ptr<OrganizedCloudXYZIR>(
-            new OrganizedCloudXYZIR(config_.max_range, config_.min_range,
-                                    config_.target_frame, config_.fixed_frame,
-                                    config_.num_lasers, data_->scansPerPacket()));
-      }
-      else
-      {
-        container_ptr = boost::shared_ptr<PointcloudXYZIR>(
-            new PointcloudXYZIR(config_.max_range, config_.min_range,
-                                config_.target_frame, config_.fixed_frame,
-                                data_->scansPerPacket()));
       }
+      container_ptr = createContainer();
+      if(unpacker_)
+        unpacker_->resetContainers(boost::bind(&Transform::createContainer, this));
     }
     container_ptr->configure(config_.max_range, config_.min_range, config_.fixed_frame, config_.target_frame);
+    if(unpacker_)
+      unpacker_->configure(config_.max_range, config_.min_range, config_.fixed_frame, config_.target_frame);
+  }
+
+  /** @brief Create an empty container for the configured cloud format.
+   *
+   *  All containers share the node's transform listener.
+   */
+  boost::shared_ptr<velodyne_rawdata::DataContainerBase> Transform::createContainer()
+  {
+    if(config_.organize_cloud)
+    {
+      return boost::shared_ptr<OrganizedCloudXYZIR>(
+          new OrganizedCloudXYZIR(config_.max_range, config_.min_range,
+                                  config_.target_frame, config_.fixed_frame,
+                                  config_.num_lasers, data_->scansPerPacket(), tf_ptr_,
+                                  config_.azimuth_bins));
+    }
+    return boost::shared_ptr<PointcloudXYZIR>(
+        new PointcloudXYZIR(config_.max_range, config_.min_range,
+                            config_.target_frame, config_.fixed_frame,
+                            data_->scansPerPacket(), tf_ptr_));
   }
 
   /** @brief Callback for raw scan messages.
@@ -134,7 +156,8 @@ namespace velodyne_pointcloud
   void
     Transform::processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg)
   {
-    if (output_.getNumSubscribers() == 0)         // no one listening?
+    const bool decimate = decimator_.enabled() && decimated_output_.getNumSubscribers() > 0;
+    if (output_.getNumSubscribers() == 0 && !decimate) // no one listening?
       return;                                     // avoid much work
 
     boost::lock_guard<boost::mutex> guard(reconfigure_mtx_);
@@ -142,14 +165,44 @@ namespace velodyne_pointcloud
     // allocate a point cloud with same time and frame ID as raw data
     container_ptr->setup(scanMsg);
 
+    // look up a few poses per scan and interpolate them for each packet
+    if (config_.transform_knots > 0 && !scanMsg->packets.empty())
+    {
+      container_ptr->cacheTransformations(scanMsg->packets.front().stamp,
+                                          scanMsg->packets.back().stamp,
+                                          config_.transform_knots);
+    }
+    else
+    {
+      container_ptr->clearTransformations();
+    }
+
     // process each packet provided by the driver
-    for (size_t i = 0; i < scanMsg->packets.size(); ++i)
+    if (unpacker_)
     {
-      container_ptr->computeTransformation(scanMsg->packets[i].stamp);
-      data_->unpack(scanMsg->packets[i], *container_ptr,  scanMsg->header.stamp);
+      unpacker_->unpack(scanMsg, *container_ptr);
     }
+    else
+    {
+      for (size_t i = 0; i < scanMsg->packets.size(); ++i)
+      {
+        container_ptr->updateTransformation(scanMsg->packets[i].stamp);
+        data_->unpack(scanMsg->packets[i], *container_ptr,  scanMsg->header.stamp);
+      }
+    }
+
+    // the decimated cloud comes from the same unpacked scan
+    if (decimate)
+    {
+      if (!decimated_msg_ || decimated_msg_.use_count() != 1)
+        decimated_msg_ = boost::make_shared<sensor_msgs::PointCloud2>();
+      if (decimator_.decimate(container_ptr->finishCloud(), *decimated_msg_))
+        decimated_output_.publish(decimated_msg_);
+    }
+
     // publish the accumulated cloud message
-    output_.publish(container_ptr->finishCloud());
+    if (output_.getNumSubscribers() > 0)
+      output_.publish(container_ptr->finishCloudPtr());
 
     diag_topic_->tick(scanMsg->header.stamp);
     diagnostics_.update();
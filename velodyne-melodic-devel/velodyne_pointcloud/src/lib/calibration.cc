@@ -88,8 +88,9 @@ namespace velodyne_pointcloud
 
     const YAML::Node * max_intensity_node = NULL;
 #ifdef HAVE_NEW_YAMLCPP
+    YAML::Node max_intensity_node_ref;   // must outlive the pointer
     if (node[MAX_INTENSITY]) {
-      const YAML::Node max_intensity_node_ref = node[MAX_INTENSITY];
+      max_intensity_node_ref = node[MAX_INTENSITY];
       max_intensity_node = &max_intensity_node_ref;
     }
 #else
@@ -107,8 +108,9 @@ namespace velodyne_pointcloud
 
     const YAML::Node * min_intensity_node = NULL;
 #ifdef HAVE_NEW_YAMLCPP
+    YAML::Node min_intensity_node_ref;   // must outlive the pointer
     if (node[MIN_INTENSITY]) {
-      const YAML::Node min_intensity_node_ref = node[MIN_INTENSITY];
+      min_intensity_node_ref = node[MIN_INTENSITY];
       min_intensity_node = &min_intensity_node_ref;
     }
 #else
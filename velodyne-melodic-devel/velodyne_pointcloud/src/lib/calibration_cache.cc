@@ -0,0 +1,217 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    Binary calibration cache.
+
+    Layout of the cache file (host byte order and struct layout):
+
+      header (CacheHeader below),
+      laser corrections (LaserCorrection[num_corrections]),
+      corrections by laser id (LaserCorrection[num_mapped]),
+      their laser ids (int32[num_mapped]),
+      cosine table, sine table (float[table_size] each).
+
+    The header records the checksum of the source calibration file,
+    the format version and the host layout, so any change of either
+    makes the cache stale, and a checksum of the payload.
+
+*/
+
+#include <velodyne_pointcloud/calibration_cache.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+namespace velodyne_pointcloud
+{
+namespace
+{
+const char MAGIC[4] = {'V', 'C', 'C', '1'};
+const uint32_t VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct CacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t correction_size;        ///< sizeof(LaserCorrection)
+  uint64_t source_checksum;        ///< checksum of the calibration file
+  uint64_t payload_checksum;       ///< checksum of everything after the header
+  int32_t num_lasers;
+  float distance_resolution_m;
+  uint32_t num_corrections;        ///< size of laser_corrections
+  uint32_t num_mapped;             ///< size of laser_corrections_map
+  uint32_t table_size;
+  uint32_t reserved;
+};
+
+/** 64 bit FNV-1a hash. */
+uint64_t fnv1a(const void* data, const size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+size_t payloadSize(const CacheHeader& header)
+{
+  return (header.num_corrections + header.num_mapped) * sizeof(LaserCorrection) +
+         header.num_mapped * sizeof(int32_t) + 2 * header.table_size * sizeof(float);
+}
+
+bool validHeader(const CacheHeader& header, const uint64_t source_checksum, const size_t table_size)
+{
+  return memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+         header.byte_order == BYTE_ORDER_MARK && header.correction_size == sizeof(LaserCorrection) &&
+         header.source_checksum == source_checksum && header.table_size == table_size &&
+         header.num_mapped <= header.num_corrections && header.num_corrections <= 65536;
+}
+}  // namespace
+
+bool calibrationChecksum(const std::string& calibration_file, uint64_t& checksum)
+{
+  std::ifstream in(calibration_file.c_str(), std::ios::binary);
+  if (!in.is_open())
+    return false;
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  const std::string bytes = contents.str();
+  checksum = fnv1a(bytes.data(), bytes.size());
+  return true;
+}
+
+bool readCalibrationCache(const std::string& cache_file, const uint64_t source_checksum,
+                          Calibration& calibration, float* cos_table, float* sin_table,
+                          const size_t table_size)
+{
+  const int fd = open(cache_file.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(CacheHeader)))
+  {
+    close(fd);
+    return false;
+  }
+  const size_t size = status.st_size;
+  void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  const uint8_t* data = static_cast<const uint8_t*>(mapping);
+  CacheHeader header;
+  memcpy(&header, data, sizeof(header));
+  const uint8_t* payload = data + sizeof(header);
+  const bool valid = validHeader(header, source_checksum, table_size) &&
+                     size == sizeof(header) + payloadSize(header) &&
+                     fnv1a(payload, payloadSize(header)) == header.payload_checksum;
+  if (valid)
+  {
+    const LaserCorrection* corrections = reinterpret_cast<const LaserCorrection*>(payload);
+    const LaserCorrection* mapped = corrections + header.num_corrections;
+    const uint8_t* ids = reinterpret_cast<const uint8_t*>(mapped + header.num_mapped);
+    const uint8_t* tables = ids + header.num_mapped * sizeof(int32_t);
+
+    calibration.num_lasers = header.num_lasers;
+    calibration.distance_resolution_m = header.distance_resolution_m;
+    calibration.laser_corrections.assign(corrections, corrections + header.num_corrections);
+    calibration.laser_corrections_map.clear();
+    for (uint32_t i = 0; i < header.num_mapped; ++i)
+    {
+      int32_t id;
+      memcpy(&id, ids + i * sizeof(id), sizeof(id));
+      calibration.laser_corrections_map[id] = mapped[i];
+    }
+    calibration.initialized = true;
+    memcpy(cos_table, tables, table_size * sizeof(float));
+    memcpy(sin_table, tables + table_size * sizeof(float), table_size * sizeof(float));
+  }
+  munmap(mapping, size);
+  return valid;
+}
+
+bool writeCalibrationCache(const std::string& cache_file, const uint64_t source_checksum,
+                           const Calibration& calibration, const float* cos_table,
+                           const float* sin_table, const size_t table_size)
+{
+  std::vector<LaserCorrection> mapped;
+  std::vector<int32_t> ids;
+  for (std::map<int, LaserCorrection>::const_iterator it = calibration.laser_corrections_map.begin();
+       it != calibration.laser_corrections_map.end(); ++it)
+  {
+    mapped.push_back(it->second);
+    ids.push_back(it->first);
+  }
+
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.correction_size = sizeof(LaserCorrection);
+  header.source_checksum = source_checksum;
+  header.num_lasers = calibration.num_lasers;
+  header.distance_resolution_m = calibration.distance_resolution_m;
+  header.num_corrections = calibration.laser_corrections.size();
+  header.num_mapped = ids.size();
+  header.table_size = table_size;
+
+  // assemble the payload first: its checksum goes into the header
+  std::vector<uint8_t> payload(payloadSize(header));
+  uint8_t* out = payload.data();
+  if (!calibration.laser_corrections.empty())
+    memcpy(out, &calibration.laser_corrections[0], header.num_corrections * sizeof(LaserCorrection));
+  out += header.num_corrections * sizeof(LaserCorrection);
+  if (!mapped.empty())
+  {
+    memcpy(out, &mapped[0], mapped.size() * sizeof(LaserCorrection));
+    memcpy(out + mapped.size() * sizeof(LaserCorrection), &ids[0], ids.size() * sizeof(int32_t));
+  }
+  out += mapped.size() * sizeof(LaserCorrection);
+  out += ids.size() * sizeof(int32_t);
+  memcpy(out, cos_table, table_size * sizeof(float));
+  memcpy(out + table_size * sizeof(float), sin_table, table_size * sizeof(float));
+  header.payload_checksum = fnv1a(payload.data(), payload.size());
+
+  // write a temporary file and rename it, so that concurrently starting
+  // nodes never see a partial cache
+  std::ostringstream temporary;
+  temporary << cache_file << ".tmp" << getpid();
+  {
+    std::ofstream fout(temporary.str().c_str(), std::ios::binary);
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fout.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    fout.close();
+    if (!fout)
+    {
+      remove(temporary.str().c_str());
+      return false;
+    }
+  }
+  if (rename(temporary.str().c_str(), cache_file.c_str()) != 0)
+  {
+    remove(temporary.str().c_str());
+    return false;
+  }
+  return true;
+}
+}  // namespace velodyne_pointcloud
@@ -0,0 +1,722 @@
+/*
+ *  Copyright (C) 2019 Austin Robot Technology
+ *  License: Modified BSD Software License Agreement
+ */
+
+/** @file
+
+    Compact encoding of Velodyne PointCloud2 messages.
+
+    Layout of the encoded data (little endian):
+
+      "VPC1", version (uint8), flags (uint8), resolution (float64),
+      height, width, point_step, row_step (uint32), field count (uint16),
+      per field: name length (uint8), name, offset (uint32),
+                 datatype (uint8), count (uint32), coding mode (uint8),
+      ring field index (int16, -1 if none),
+      followed by the bit stream of all points in row-major order.
+
+*/
+
+#include <velodyne_pointcloud/cloud_codec.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace velodyne_pointcloud
+{
+const std::string CloudCodec::FORMAT = "vpc1";
+
+namespace
+{
+const uint8_t MAGIC[4] = {'V', 'P', 'C', '1'};
+const uint8_t VERSION = 1;
+
+enum
+{
+  FLAG_VALIDITY = 1,     ///< one bit per point tells whether x is NaN
+  FLAG_DENSE = 2,
+  FLAG_BIGENDIAN = 4
+};
+
+enum CodingMode
+{
+  MODE_QUANTIZED = 0,      ///< float32 x, y, z as multiples of the resolution
+  MODE_INTEGER = 1,        ///< integer types, delta per ring
+  MODE_FLOAT_INTEGER = 2,  ///< float32 holding integers, delta per ring
+  MODE_FLOAT_BITS = 3,     ///< float32 bit pattern, delta per ring
+  MODE_RAW = 4             ///< anything else, byte by byte
+};
+
+const unsigned int MAX_RINGS = 128;  ///< prediction contexts, larger rings share the last
+const unsigned int ESCAPE = 24;      ///< unary length escaping to a raw 64 bit value
+const uint32_t MAX_POINT_STEP = 4096;   ///< bounds what corrupt data can allocate
+const uint32_t MAX_ROW_PADDING = 4096;
+
+inline uint64_t zigzag(int64_t value)
+{
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value)
+{
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline uint64_t lowBits(uint64_t value, unsigned int n)
+{
+  return n >= 64 ? value : value & ((1ull << n) - 1);
+}
+
+/** Least significant bit first writer. */
+class BitWriter
+{
+public:
+  explicit BitWriter(std::vector<uint8_t>& out) : out_(out), size_(out.size()), acc_(0), bits_(0) {}
+
+  /// append the n <= 32 low bits of value
+  inline void put(uint64_t value, unsigned int n)
+  {
+    acc_ |= lowBits(value, n) << bits_;
+    bits_ += n;
+    if (bits_ >= 32)
+    {
+      if (size_ + 4 > out_.size())
+        out_.resize(2 * out_.size() + 64);
+      uint8_t* out = &out_[size_];
+      for (int i = 0; i < 4; ++i)
+        out[i] = static_cast<uint8_t>(acc_ >> (8 * i));
+      size_ += 4;
+      acc_ >>= 32;
+      bits_ -= 32;
+    }
+  }
+
+  /// write the pending bits and trim the output
+  void flush()
+  {
+    out_.resize(size_);
+    for (; bits_ > 0; bits_ -= std::min(bits_, 8u))
+    {
+      out_.push_back(static_cast<uint8_t>(acc_));
+      acc_ >>= 8;
+    }
+    acc_ = 0;
+    size_ = out_.size();
+  }
+
+private:
+  std::vector<uint8_t>& out_;
+  size_t size_;
+  uint64_t acc_;
+  unsigned int bits_;
+};
+
+class BitReader
+{
+public:
+  BitReader(const uint8_t* data, size_t size) : data_(data), size_(size), pos_(0), acc_(0), bits_(0) {}
+
+  /// read n <= 32 bits
+  inline uint64_t get(unsigned int n)
+  {
+    if (bits_ < n)
+      refill();
+    const uint64_t value = lowBits(acc_, n);
+    acc_ >>= n;
+    bits_ -= n;
+    return value;
+  }
+
+  /// count up to limit one bits, consuming the terminating zero if found
+  inline unsigned int ones(unsigned int limit)
+  {
+    if (bits_ < limit + 1)
+      refill();
+    unsigned int n = 0;
+    while (n < limit && ((acc_ >> n) & 1))
+      ++n;
+    const unsigned int consumed = n < limit ? n + 1 : n;
+    acc_ >>= consumed;
+    bits_ -= consumed;
+    return n;
+  }
+
+  /// whether more bits were consumed than the data holds
+  bool overrun() const
+  {
+    return pos_ * 8 - bits_ > size_ * 8;
+  }
+
+private:
+  /// top up the accumulator to at least 56 bits
+  inline void refill()
+  {
+    while (bits_ <= 56)
+    {
+      const uint64_t byte = pos_ < size_ ? data_[pos_] : 0;
+      ++pos_;
+      acc_ |= byte << bits_;
+      bits_ += 8;
+    }
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+  uint64_t acc_;
+  unsigned int bits_;
+};
+
+/** Adaptive Golomb-Rice parameter, the smallest k with count * 2^k >= sum. */
+struct RiceContext
+{
+  uint64_t sum;
+  uint32_t count;
+  unsigned int k;
+
+  RiceContext() : sum(4), count(1), k(2) {}
+
+  inline void update(uint64_t value)
+  {
+    sum += value;
+    if (++count >= 64)
+    {
+      sum >>= 1;
+      count >>= 1;
+    }
+    // the mean moves slowly, so k only needs a step or two
+    while (k < 32 && (static_cast<uint64_t>(count) << k) < sum)
+      ++k;
+    while (k > 0 && (static_cast<uint64_t>(count) << (k - 1)) >= sum)
+      --k;
+  }
+};
+
+inline void writeRice(BitWriter& writer, RiceContext& ctx, uint64_t value)
+{
+  const unsigned int k = ctx.k;
+  const uint64_t quotient = value >> k;
+  if (quotient < ESCAPE)
+  {
+    // quotient ones, a terminating zero, then the k low bits
+    writer.put((1ull << quotient) - 1, quotient + 1);
+    writer.put(value, k);
+  }
+  else
+  {
+    writer.put((1ull << ESCAPE) - 1, ESCAPE);
+    writer.put(value, 32);
+    writer.put(value >> 32, 32);
+  }
+  ctx.update(value);
+}
+
+inline uint64_t readRice(BitReader& reader, RiceContext& ctx)
+{
+  const unsigned int k = ctx.k;
+  const uint64_t quotient = reader.ones(ESCAPE);
+  uint64_t value;
+  if (quotient < ESCAPE)
+  {
+    value = (quotient << k) | reader.get(k);
+  }
+  else
+  {
+    value = reader.get(32);
+    value |= reader.get(32) << 32;
+  }
+  ctx.update(value);
+  return value;
+}
+
+/** Coding state of one field. */
+struct FieldCoder
+{
+  std::string name;
+  uint32_t offset;
+  uint8_t datatype;
+  uint32_t count;
+  uint8_t mode;
+  std::vector<RiceContext> contexts;
+  std::vector<int64_t> previous;
+
+  FieldCoder() : offset(0), datatype(0), count(0), mode(MODE_RAW) {}
+
+  void reset()
+  {
+    contexts.assign(MAX_RINGS, RiceContext());
+    previous.assign(MAX_RINGS, 0);
+  }
+};
+
+size_t datatypeSize(uint8_t datatype)
+{
+  switch (datatype)
+  {
+    case sensor_msgs::PointField::INT8:
+    case sensor_msgs::PointField::UINT8:
+      return 1;
+    case sensor_msgs::PointField::INT16:
+    case sensor_msgs::PointField::UINT16:
+      return 2;
+    case sensor_msgs::PointField::INT32:
+    case sensor_msgs::PointField::UINT32:
+    case sensor_msgs::PointField::FLOAT32:
+      return 4;
+    case sensor_msgs::PointField::FLOAT64:
+      return 8;
+  }
+  return 0;
+}
+
+bool isInteger(uint8_t datatype)
+{
+  return datatype >= sensor_msgs::PointField::INT8 && datatype <= sensor_msgs::PointField::UINT32;
+}
+
+/// integer field value, widened without loss
+int64_t readInteger(const uint8_t* ptr, uint8_t datatype)
+{
+  switch (datatype)
+  {
+    case sensor_msgs::PointField::INT8:
+      { int8_t v; memcpy(&v, ptr, sizeof(v)); return v; }
+    case sensor_msgs::PointField::UINT8:
+      return *ptr;
+    case sensor_msgs::PointField::INT16:
+      { int16_t v; memcpy(&v, ptr, sizeof(v)); return v; }
+    case sensor_msgs::PointField::UINT16:
+      { uint16_t v; memcpy(&v, ptr, sizeof(v)); return v; }
+    case sensor_msgs::PointField::INT32:
+      { int32_t v; memcpy(&v, ptr, sizeof(v)); return v; }
+    case sensor_msgs::PointField::UINT32:
+      { uint32_t v; memcpy(&v, ptr, sizeof(v)); return v; }
+  }
+  return 0;
+}
+
+void writeInteger(uint8_t* ptr, uint8_t datatype, int64_t value)
+{
+  switch (datatype)
+  {
+    case sensor_msgs::PointField::INT8:
+      { int8_t v = static_cast<int8_t>(value); memcpy(ptr, &v, sizeof(v)); break; }
+    case sensor_msgs::PointField::UINT8:
+      *ptr = static_cast<uint8_t>(value); break;
+    case sensor_msgs::PointField::INT16:
+      { int16_t v = static_cast<int16_t>(value); memcpy(ptr, &v, sizeof(v)); break; }
+    case sensor_msgs::PointField::UINT16:
+      { uint16_t v = static_cast<uint16_t>(value); memcpy(ptr, &v, sizeof(v)); break; }
+    case sensor_msgs::PointField::INT32:
+      { int32_t v = static_cast<int32_t>(value); memcpy(ptr, &v, sizeof(v)); break; }
+    case sensor_msgs::PointField::UINT32:
+      { uint32_t v = static_cast<uint32_t>(value); memcpy(ptr, &v, sizeof(v)); break; }
+  }
+}
+
+inline float readFloat(const uint8_t* ptr)
+{
+  float v;
+  memcpy(&v, ptr, sizeof(v));
+  return v;
+}
+
+inline int64_t floatBits(const uint8_t* ptr)
+{
+  int32_t v;
+  memcpy(&v, ptr, sizeof(v));
+  return v;
+}
+
+/// whether a float32 survives the round trip through an integer
+inline bool isIntegral(float v)
+{
+  return std::isfinite(v) && v == std::floor(v) && std::fabs(v) < 2147483648.0f && !(v == 0 && std::signbit(v));
+}
+
+template <typename T>
+void append(std::vector<uint8_t>& out, T value)
+{
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool extract(const std::vector<uint8_t>& in, size_t& pos, T& value)
+{
+  if (pos + sizeof(T) > in.size())
+    return false;
+  memcpy(&value, &in[pos], sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+/// bytes between rows, tolerating clouds that leave row_step unset
+inline size_t rowStride(uint32_t width, uint32_t point_step, uint32_t row_step)
+{
+  return std::max<size_t>(row_step, static_cast<size_t>(width) * point_step);
+}
+
+/** Byte offsets of the points in row-major order, skipping row padding. */
+class PointCursor
+{
+public:
+  PointCursor(uint32_t width, uint32_t point_step, size_t stride)
+    : width_(width), point_step_(point_step), stride_(stride), row_(0), offset_(0), column_(0)
+  {
+  }
+
+  inline size_t offset() const
+  {
+    return offset_;
+  }
+
+  inline void next()
+  {
+    offset_ += point_step_;
+    if (++column_ == width_)
+    {
+      column_ = 0;
+      row_ += stride_;
+      offset_ = row_;
+    }
+  }
+
+private:
+  uint32_t width_;
+  uint32_t point_step_;
+  size_t stride_;
+  size_t row_;
+  size_t offset_;
+  uint32_t column_;
+};
+
+/// whether the layout is one the codec handles
+bool supportedLayout(uint32_t width, uint32_t point_step, uint32_t row_step, size_t nfields)
+{
+  return nfields > 0 && nfields <= 0xffff && point_step <= MAX_POINT_STEP &&
+         rowStride(width, point_step, row_step) - static_cast<size_t>(width) * point_step <= MAX_ROW_PADDING;
+}
+
+inline unsigned int ringContext(int64_t ring)
+{
+  if (ring < 0)
+    return 0;
+  return ring < MAX_RINGS ? static_cast<unsigned int>(ring) : MAX_RINGS - 1;
+}
+}  // namespace
+
+CloudCodec::CloudCodec(const double resolution) : resolution_(resolution > 0 ? resolution : 0)
+{
+}
+
+bool CloudCodec::encode(const sensor_msgs::PointCloud2& cloud, std::vector<uint8_t>& data) const
+{
+  const size_t npoints = static_cast<size_t>(cloud.width) * cloud.height;
+  const size_t stride = rowStride(cloud.width, cloud.point_step, cloud.row_step);
+  if (!supportedLayout(cloud.width, cloud.point_step, cloud.row_step, cloud.fields.size()) ||
+      (npoints > 0 && cloud.data.size() < stride * (cloud.height - 1) + static_cast<size_t>(cloud.width) * cloud.point_step))
+    return false;
+
+  std::vector<FieldCoder> fields(cloud.fields.size());
+  int ring_field = -1;
+  int xyz[3] = {-1, -1, -1};
+  for (size_t f = 0; f < cloud.fields.size(); ++f)
+  {
+    const sensor_msgs::PointField& field = cloud.fields[f];
+    FieldCoder& coder = fields[f];
+    coder.name = field.name;
+    coder.offset = field.offset;
+    coder.datatype = field.datatype;
+    coder.count = field.count;
+    if (field.offset + datatypeSize(field.datatype) * field.count > cloud.point_step || field.name.size() > 255)
+      return false;
+
+    if (field.count != 1)
+      coder.mode = MODE_RAW;
+    else if (isInteger(field.datatype))
+      coder.mode = MODE_INTEGER;
+    else if (field.datatype == sensor_msgs::PointField::FLOAT32)
+      coder.mode = MODE_FLOAT_INTEGER;  // until a value proves otherwise
+    else
+      coder.mode = MODE_RAW;
+
+    if (coder.mode == MODE_INTEGER && ring_field < 0 && (field.name == "ring" || field.name == "laserid"))
+      ring_field = static_cast<int>(f);
+    if (field.count == 1 && field.datatype == sensor_msgs::PointField::FLOAT32)
+    {
+      if (field.name == "x") xyz[0] = static_cast<int>(f);
+      if (field.name == "y") xyz[1] = static_cast<int>(f);
+      if (field.name == "z") xyz[2] = static_cast<int>(f);
+    }
+  }
+
+  // decide how each field can be coded without losing information
+  const bool quantize = resolution_ > 0 && xyz[0] >= 0 && xyz[1] >= 0 && xyz[2] >= 0;
+  bool quantizable = quantize;
+  bool validity = false;
+  PointCursor cursor(cloud.width, cloud.point_step, stride);
+  for (size_t i = 0; i < npoints; ++i, cursor.next())
+  {
+    const uint8_t* point = &cloud.data[cursor.offset()];
+    const bool valid = xyz[0] < 0 || !std::isnan(readFloat(point + fields[xyz[0]].offset));
+    validity |= !valid;
+    for (size_t f = 0; f < fields.size(); ++f)
+    {
+      FieldCoder& coder = fields[f];
+      if (coder.mode != MODE_FLOAT_INTEGER)
+        continue;
+      const float v = readFloat(point + coder.offset);
+      if (valid ? !isIntegral(v) : !std::isnan(v))
+        coder.mode = MODE_FLOAT_BITS;
+    }
+    if (quantizable)
+    {
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        const float v = readFloat(point + fields[xyz[axis]].offset);
+        if (valid ? !(std::isfinite(v) && std::fabs(v / resolution_) < 2147483647.0) : !std::isnan(v))
+          quantizable = false;
+      }
+    }
+  }
+  if (quantizable)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+      fields[xyz[axis]].mode = MODE_QUANTIZED;
+  }
+  validity = validity && xyz[0] >= 0;
+
+  // header
+  data.clear();
+  data.reserve(64 + npoints * 4);
+  data.insert(data.end(), MAGIC, MAGIC + 4);
+  append<uint8_t>(data, VERSION);
+  append<uint8_t>(data, (validity ? FLAG_VALIDITY : 0) | (cloud.is_dense ? FLAG_DENSE : 0) |
+                        (cloud.is_bigendian ? FLAG_BIGENDIAN : 0));
+  append<double>(data, resolution_);
+  append<uint32_t>(data, cloud.height);
+  append<uint32_t>(data, cloud.width);
+  append<uint32_t>(data, cloud.point_step);
+  append<uint32_t>(data, cloud.row_step);
+  append<uint16_t>(data, static_cast<uint16_t>(fields.size()));
+  for (size_t f = 0; f < fields.size(); ++f)
+  {
+    const FieldCoder& coder = fields[f];
+    append<uint8_t>(data, static_cast<uint8_t>(coder.name.size()));
+    data.insert(data.end(), coder.name.begin(), coder.name.end());
+    append<uint32_t>(data, coder.offset);
+    append<uint8_t>(data, coder.datatype);
+    append<uint32_t>(data, coder.count);
+    append<uint8_t>(data, coder.mode);
+  }
+  append<int16_t>(data, static_cast<int16_t>(ring_field));
+
+  // points
+  for (size_t f = 0; f < fields.size(); ++f)
+    fields[f].reset();
+  RiceContext ring_context;
+  int64_t previous_ring = 0;
+  const double scale = resolution_ > 0 ? 1.0 / resolution_ : 0;
+  BitWriter writer(data);
+
+  cursor = PointCursor(cloud.width, cloud.point_step, stride);
+  for (size_t i = 0; i < npoints; ++i, cursor.next())
+  {
+    const uint8_t* point = &cloud.data[cursor.offset()];
+
+    unsigned int ctx = 0;
+    if (ring_field >= 0)
+    {
+      const int64_t ring = readInteger(point + fields[ring_field].offset, fields[ring_field].datatype);
+      writeRice(writer, ring_context, zigzag(ring - previous_ring));
+      previous_ring = ring;
+      ctx = ringContext(ring);
+    }
+
+    bool valid = true;
+    if (validity)
+    {
+      valid = !std::isnan(readFloat(point + fields[xyz[0]].offset));
+      writer.put(valid ? 1 : 0, 1);
+    }
+
+    for (size_t f = 0; f < fields.size(); ++f)
+    {
+      if (static_cast<int>(f) == ring_field)
+        continue;
+      FieldCoder& coder = fields[f];
+      const uint8_t* ptr = point + coder.offset;
+      int64_t value;
+      switch (coder.mode)
+      {
+        case MODE_QUANTIZED:
+          if (!valid)
+            continue;
+          value = std::llrint(readFloat(ptr) * scale);
+          break;
+        case MODE_FLOAT_INTEGER:
+          if (!valid)
+            continue;
+          value = static_cast<int64_t>(readFloat(ptr));
+          break;
+        case MODE_FLOAT_BITS:
+          value = floatBits(ptr);
+          break;
+        case MODE_INTEGER:
+          value = readInteger(ptr, coder.datatype);
+          break;
+        default:
+          for (size_t b = 0; b < datatypeSize(coder.datatype) * coder.count; ++b)
+            writer.put(ptr[b], 8);
+          continue;
+      }
+      writeRice(writer, coder.contexts[ctx], zigzag(value - coder.previous[ctx]));
+      coder.previous[ctx] = value;
+    }
+  }
+  writer.flush();
+  return true;
+}
+
+bool CloudCodec::decode(const std::vector<uint8_t>& data, sensor_msgs::PointCloud2& cloud) const
+{
+  size_t pos = 0;
+  uint8_t magic[4];
+  for (int i = 0; i < 4; ++i)
+  {
+    if (!extract(data, pos, magic[i]) || magic[i] != MAGIC[i])
+      return false;
+  }
+  uint8_t version, flags;
+  double resolution;
+  uint32_t height, width, point_step, row_step;
+  uint16_t nfields;
+  if (!extract(data, pos, version) || version != VERSION || !extract(data, pos, flags) ||
+      !extract(data, pos, resolution) || !extract(data, pos, height) || !extract(data, pos, width) ||
+      !extract(data, pos, point_step) || !extract(data, pos, row_step) || !extract(data, pos, nfields))
+    return false;
+
+  std::vector<FieldCoder> fields(nfields);
+  cloud.fields.resize(nfields);
+  int xyz_field = -1;
+  for (size_t f = 0; f < nfields; ++f)
+  {
+    FieldCoder& coder = fields[f];
+    uint8_t length;
+    if (!extract(data, pos, length) || pos + length > data.size())
+      return false;
+    coder.name.assign(reinterpret_cast<const char*>(&data[pos]), length);
+    pos += length;
+    if (!extract(data, pos, coder.offset) || !extract(data, pos, coder.datatype) ||
+        !extract(data, pos, coder.count) || !extract(data, pos, coder.mode))
+      return false;
+    if (coder.offset + datatypeSize(coder.datatype) * coder.count > point_step)
+      return false;
+    if (coder.name == "x" && coder.datatype == sensor_msgs::PointField::FLOAT32 && coder.count == 1)
+      xyz_field = static_cast<int>(f);
+
+    cloud.fields[f].name = coder.name;
+    cloud.fields[f].offset = coder.offset;
+    cloud.fields[f].datatype = coder.datatype;
+    cloud.fields[f].count = coder.count;
+    coder.reset();
+  }
+  int16_t ring_field;
+  if (!extract(data, pos, ring_field) || ring_field >= static_cast<int>(nfields) ||
+      ((flags & FLAG_VALIDITY) && xyz_field < 0))
+    return false;
+
+  // every point takes at least one bit
+  const size_t npoints = static_cast<size_t>(width) * height;
+  if (!supportedLayout(width, point_step, row_step, nfields) || npoints > (data.size() - pos) * 8)
+    return false;
+
+  cloud.height = height;
+  cloud.width = width;
+  cloud.point_step = point_step;
+  cloud.row_step = row_step;
+  cloud.is_dense = (flags & FLAG_DENSE) != 0;
+  cloud.is_bigendian = (flags & FLAG_BIGENDIAN) != 0;
+  const size_t stride = rowStride(width, point_step, row_step);
+  cloud.data.assign(stride * height, 0);
+
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  RiceContext ring_context;
+  int64_t previous_ring = 0;
+  BitReader reader(pos < data.size() ? &data[pos] : NULL, data.size() - pos);
+
+  PointCursor cursor(width, point_step, stride);
+  for (size_t i = 0; i < npoints; ++i, cursor.next())
+  {
+    uint8_t* point = &cloud.data[cursor.offset()];
+
+    unsigned int ctx = 0;
+    if (ring_field >= 0)
+    {
+      const int64_t ring = previous_ring + unzigzag(readRice(reader, ring_context));
+      writeInteger(point + fields[ring_field].offset, fields[ring_field].datatype, ring);
+      previous_ring = ring;
+      ctx = ringContext(ring);
+    }
+
+    bool valid = true;
+    if (flags & FLAG_VALIDITY)
+      valid = reader.get(1) != 0;
+
+    for (size_t f = 0; f < fields.size(); ++f)
+    {
+      if (static_cast<int>(f) == ring_field)
+        continue;
+      FieldCoder& coder = fields[f];
+      uint8_t* ptr = point + coder.offset;
+      if (coder.mode == MODE_RAW)
+      {
+        for (size_t b = 0; b < datatypeSize(coder.datatype) * coder.count; ++b)
+          ptr[b] = static_cast<uint8_t>(reader.get(8));
+        continue;
+      }
+      if (!valid && (coder.mode == MODE_QUANTIZED || coder.mode == MODE_FLOAT_INTEGER))
+      {
+        memcpy(ptr, &nan, sizeof(nan));
+        continue;
+      }
+
+      const int64_t value = coder.previous[ctx] + unzigzag(readRice(reader, coder.contexts[ctx]));
+      coder.previous[ctx] = value;
+      switch (coder.mode)
+      {
+        case MODE_QUANTIZED:
+          {
+            const float v = static_cast<float>(value * resolution);
+            memcpy(ptr, &v, sizeof(v));
+          }
+          break;
+        case MODE_FLOAT_INTEGER:
+          {
+            const float v = static_cast<float>(value);
+            memcpy(ptr, &v, sizeof(v));
+          }
+          break;
+        case MODE_FLOAT_BITS:
+          {
+            const int32_t v = static_cast<int32_t>(value);
+            memcpy(ptr, &v, sizeof(v));
+          }
+          break;
+        case MODE_INTEGER:
+          writeInteger(ptr, coder.datatype, value);
+          break;
+        default:
+          return false;
+      }
+    }
+    if (reader.overrun())
+      return false;
+  }
+  return true;
+}
+
+}  // namespace velodyne_pointcloud
@@ -0,0 +1,248 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+/** @file
+
+    Decimation of Velodyne point clouds by ring, azimuth and voxel.
+
+*/
+
+#include <velodyne_pointcloud/cloud_decimator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace velodyne_pointcloud
+{
+namespace
+{
+const int VOXEL_BITS = 21;
+const int64_t VOXEL_OFFSET = 1 << (VOXEL_BITS - 1);
+const int64_t VOXEL_MASK = (1 << VOXEL_BITS) - 1;
+
+/** Offset of the named field of the given type, or -1. */
+int fieldOffset(const sensor_msgs::PointCloud2& cloud, const std::string& name, const uint8_t datatype)
+{
+  for (size_t i = 0; i < cloud.fields.size(); ++i)
+  {
+    if (cloud.fields[i].name == name)
+      return cloud.fields[i].datatype == datatype && cloud.fields[i].count == 1 ? cloud.fields[i].offset : -1;
+  }
+  return -1;
+}
+
+float readFloat(const uint8_t* point, const int offset)
+{
+  float value;
+  memcpy(&value, point + offset, sizeof(value));
+  return value;
+}
+
+void writeFloat(uint8_t* point, const int offset, const float value)
+{
+  memcpy(point + offset, &value, sizeof(value));
+}
+
+/** Voxel coordinate, clamped to VOXEL_BITS bits. */
+uint64_t voxelCoordinate(const double value)
+{
+  const int64_t index = static_cast<int64_t>(std::floor(value)) + VOXEL_OFFSET;
+  return static_cast<uint64_t>(std::min(std::max(index, static_cast<int64_t>(0)), VOXEL_MASK));
+}
+}  // namespace
+
+CloudDecimator::CloudDecimator()
+  : ring_stride_(1), azimuth_stride_(1), voxel_size_(0.0), inverse_voxel_size_(0.0), generation_(1)
+{
+}
+
+void CloudDecimator::configure(const int ring_stride, const int azimuth_stride, const double voxel_size)
+{
+  ring_stride_ = std::max(1, ring_stride);
+  azimuth_stride_ = std::max(1, azimuth_stride);
+  voxel_size_ = std::max(0.0, voxel_size);
+  inverse_voxel_size_ = voxel_size_ > 0 ? 1.0 / voxel_size_ : 0.0;
+}
+
+uint32_t CloudDecimator::voxelIndex(const float x, const float y, const float z, const uint32_t next)
+{
+  const uint64_t key = voxelCoordinate(x * inverse_voxel_size_) << (2 * VOXEL_BITS) |
+                       voxelCoordinate(y * inverse_voxel_size_) << VOXEL_BITS |
+                       voxelCoordinate(z * inverse_voxel_size_);
+
+  // open addressing with linear probing, the table is at most half full
+  const size_t mask = voxels_.size() - 1;
+  size_t slot = (key * 0x9E3779B97F4A7C15ULL) >> 32 & mask;
+  while (voxels_[slot].generation == generation_)
+  {
+    if (voxels_[slot].key == key)
+      return voxels_[slot].index;
+    slot = (slot + 1) & mask;
+  }
+  voxels_[slot].key = key;
+  voxels_[slot].index = next;
+  voxels_[slot].generation = generation_;
+  return next;
+}
+
+bool CloudDecimator::decimate(const sensor_msgs::PointCloud2& cloud, sensor_msgs::PointCloud2& reduced)
+{
+  const int x_offset = fieldOffset(cloud, "x", sensor_msgs::PointField::FLOAT32);
+  const int y_offset = fieldOffset(cloud, "y", sensor_msgs::PointField::FLOAT32);
+  const int z_offset = fieldOffset(cloud, "z", sensor_msgs::PointField::FLOAT32);
+  const int intensity_offset = fieldOffset(cloud, "intensity", sensor_msgs::PointField::FLOAT32);
+  const int ring_offset = fieldOffset(cloud, "ring", sensor_msgs::PointField::UINT16);
+  const bool strided = ring_stride_ > 1 || azimuth_stride_ > 1;
+  const uint32_t point_step = cloud.point_step;
+  const size_t row_step = std::max<size_t>(cloud.row_step, static_cast<size_t>(cloud.width) * point_step);
+  if (x_offset < 0 || y_offset < 0 || z_offset < 0 || (strided && ring_offset < 0) ||
+      point_step < 3 * sizeof(float) ||
+      (cloud.height > 0 && cloud.data.size() < (cloud.height - 1) * row_step + cloud.width * point_step))
+    return false;
+
+  const size_t npoints = static_cast<size_t>(cloud.width) * cloud.height;
+  reduced.header = cloud.header;
+  reduced.fields = cloud.fields;
+  reduced.is_bigendian = cloud.is_bigendian;
+  reduced.point_step = point_step;
+  reduced.height = 1;
+  reduced.is_dense = true;
+  reduced.data.resize(npoints * point_step);
+
+  if (azimuth_stride_ > 1)
+    std::fill(ring_counts_.begin(), ring_counts_.end(), 0);
+  const bool voxelized = voxel_size_ > 0;
+  if (voxelized)
+  {
+    size_t capacity = 1024;
+    while (capacity < 2 * npoints)
+      capacity *= 2;
+    if (voxels_.size() < capacity)
+    {
+      Voxel unused = {0, 0, 0};
+      voxels_.assign(capacity, unused);
+      generation_ = 0;
+    }
+    if (++generation_ == 0)                 // wrapped around
+    {
+      for (size_t i = 0; i < voxels_.size(); ++i)
+        voxels_[i].generation = 0;
+      generation_ = 1;
+    }
+    sums_.resize(npoints);
+  }
+
+  uint32_t count = 0;
+  uint8_t* out = reduced.data.data();
+  for (uint32_t row = 0; row < cloud.height; ++row)
+  {
+    const uint8_t* point = cloud.data.data() + row * row_step;
+    for (uint32_t column = 0; column < cloud.width; ++column, point += point_step)
+    {
+      if (strided)
+      {
+        uint16_t ring;
+        memcpy(&ring, point + ring_offset, sizeof(ring));
+        if (ring % ring_stride_ != 0)
+          continue;
+        if (azimuth_stride_ > 1)
+        {
+          // count missing returns too, to keep the spacing in azimuth
+          if (ring >= ring_counts_.size())
+            ring_counts_.resize(ring + 1, 0);
+          if (ring_counts_[ring]++ % azimuth_stride_ != 0)
+            continue;
+        }
+      }
+
+      const float x = readFloat(point, x_offset);
+      const float y = readFloat(point, y_offset);
+      const float z = readFloat(point, z_offset);
+      if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z))
+        continue;
+
+      if (!voxelized)
+      {
+        memcpy(out + count * point_step, point, point_step);
+        ++count;
+        continue;
+      }
+
+      const uint32_t index = voxelIndex(x, y, z, count);
+      Sum& sum = sums_[index];
+      const float intensity = intensity_offset >= 0 ? readFloat(point, intensity_offset) : 0.0f;
+      if (index == count)
+      {
+        memcpy(out + count * point_step, point, point_step);
+        sum.x = x;
+        sum.y = y;
+        sum.z = z;
+        sum.intensity = intensity;
+        sum.count = 1;
+        ++count;
+      }
+      else
+      {
+        sum.x += x;
+        sum.y += y;
+        sum.z += z;
+        sum.intensity += intensity;
+        ++sum.count;
+      }
+    }
+  }
+
+  if (voxelized)
+  {
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const Sum& sum = sums_[i];
+      if (sum.count == 1)
+        continue;
+      uint8_t* point = out + i * point_step;
+      writeFloat(point, x_offset, sum.x / sum.count);
+      writeFloat(point, y_offset, sum.y / sum.count);
+      writeFloat(point, z_offset, sum.z / sum.count);
+      if (intensity_offset >= 0)
+        writeFloat(point, intensity_offset, sum.intensity / sum.count);
+    }
+  }
+
+  reduced.width = count;
+  reduced.row_step = count * point_step;
+  reduced.data.resize(reduced.row_step);
+  return true;
+}
+}  // namespace velodyne_pointcloud
@@ -35,6 +35,7 @@
 #include <angles/angles.h>
 
 #include <velodyne_pointcloud/rawdata.h>
+#include <velodyne_pointcloud/calibration_cache.h>
 
 namespace velodyne_rawdata
 {
@@ -46,7 +47,14 @@ inline float SQR(float val) { return val*val; }
   //
   ////////////////////////////////////////////////////////////////////////
 
-  RawData::RawData() {}
+  RawData::RawData()
+    : unpack_fn_(&RawData::unpack_blocks<true, true>)
+  {
+    config_.min_angle = 0;
+    config_.max_angle = ROTATION_MAX_UNITS;
+    config_.full_view = true;
+    config_.raw_intensity = false;
+  }
   
   /** Update parameters: conversions and update */
   void RawData::setParameters(double min_range,
@@ -75,6 +83,35 @@ inline float SQR(float val) { return val*val; }
       config_.min_angle = 0;
       config_.max_angle = 36000;
     }
+    config_.full_view = config_.min_angle <= 0 && config_.max_angle >= 36000;
+  }
+
+  void RawData::setRawIntensity(bool raw_intensity)
+  {
+    config_.raw_intensity = raw_intensity;
+    if (!laser_constants_.empty())      // else built once the calibration is read
+      buildCorrectionTables();
+  }
+
+  inline bool RawData::rotationInView(int rotation) const
+  {
+    return (rotation >= config_.min_angle
+            && rotation <= config_.max_angle
+            && config_.min_angle < config_.max_angle)
+        || (config_.min_angle > config_.max_angle
+            && (rotation <= config_.max_angle
+                || rotation >= config_.min_angle));
+  }
+
+  inline bool RawData::arcInView(int first, int last) const
+  {
+    if (config_.full_view)
+      return true;
+
+    // two arcs intersect if either contains the start of the other
+    const int length = ((last - first) % 36000 + 36000) % 36000;
+    const int view_start = ((config_.min_angle - first) % 36000 + 36000) % 36000;
+    return rotationInView(first % 36000) || view_start <= length;
   }
 
   int RawData::scansPerPacket() const
@@ -210,9 +247,9 @@ inline float SQR(float val) { return val*val; }
       }
 
     ROS_INFO_STREAM("correction angles: " << config_.calibrationFile);
+    private_nh.param("calibration_cache", config_.calibrationCache, std::string(""));
 
-    calibration_.read(config_.calibrationFile);
-    if (!calibration_.initialized) {
+    if (!loadCalibration()) {
       ROS_ERROR_STREAM("Unable to open calibration file: " <<
           config_.calibrationFile);
       return boost::none;
@@ -220,17 +257,13 @@ inline float SQR(float val) { return val*val; }
 
     ROS_INFO_STREAM("Number of lasers: " << calibration_.num_lasers << ".");
 
-    // Set up cached values for sin and cos of all the possible headings
-    for (uint16_t rot_index = 0; rot_index < ROTATION_MAX_UNITS; ++rot_index) {
-      float rotation = angles::from_degrees(ROTATION_RESOLUTION * rot_index);
-      cos_rot_table_[rot_index] = cosf(rotation);
-      sin_rot_table_[rot_index] = sinf(rotation);
-    }
-   return calibration_;
+    buildCorrectionTables();
+    return calibration_;
   }
 
   /** Set up for offline operation */
-  int RawData::setupOffline(std::string calibration_file, double max_range_, double min_range_)
+  int RawData::setupOffline(std::string calibration_file, double max_range_, double min_range_,
+                            const std::string& calibration_cache)
   {
 
     config_.max_range = max_range_;
@@ -240,24 +273,251 @@ inline float SQR(float val) { return val*val; }
       << config_.max_range << "]");
 
     config_.calibrationFile = calibration_file;
+    config_.calibrationCache = calibration_cache;
 
     ROS_INFO_STREAM("correction angles: " << config_.calibrationFile);
 
-    calibration_.read(config_.calibrationFile);
-    if (!calibration_.initialized) {
+    if (!loadCalibration()) {
       ROS_ERROR_STREAM("Unable to open calibration file: " << config_.calibrationFile);
       return -1;
     }
 
+    buildCorrectionTables();
+    return 0;
+  }
+
+
+  /** Read the calibration and build the trig tables, through the cache if configured. */
+  bool RawData::loadCalibration()
+  {
+    uint64_t checksum = 0;
+    const bool use_cache = !config_.calibrationCache.empty()
+      && velodyne_pointcloud::calibrationChecksum(config_.calibrationFile, checksum);
+    if (use_cache
+        && velodyne_pointcloud::readCalibrationCache(config_.calibrationCache, checksum,
+                                                     calibration_, cos_rot_table_,
+                                                     sin_rot_table_, ROTATION_MAX_UNITS)) {
+      ROS_INFO_STREAM("calibration cache: " << config_.calibrationCache);
+      return true;
+    }
+
+    calibration_.read(config_.calibrationFile);
+    if (!calibration_.initialized)
+      return false;
+
     // Set up cached values for sin and cos of all the possible headings
     for (uint16_t rot_index = 0; rot_index < ROTATION_MAX_UNITS; ++rot_index) {
       float rotation = angles::from_degrees(ROTATION_RESOLUTION * rot_index);
       cos_rot_table_[rot_index] = cosf(rotation);
       sin_rot_table_[rot_index] = sinf(rotation);
     }
-    return 0;
+
+    if (use_cache) {
+      if (velodyne_pointcloud::writeCalibrationCache(config_.calibrationCache, checksum,
+                                                     calibration_, cos_rot_table_,
+                                                     sin_rot_table_, ROTATION_MAX_UNITS))
+        ROS_INFO_STREAM("updated calibration cache: " << config_.calibrationCache);
+      else
+        ROS_WARN_STREAM("Unable to write calibration cache: " << config_.calibrationCache);
+    }
+    return true;
   }
 
+  /** Build the per-laser constants. */
+  void RawData::buildCorrectionTables()
+  {
+    bool two_pt_correction = false;
+    bool intensity_correction = false;
+
+    laser_constants_.resize(calibration_.laser_corrections.size());
+    for (size_t i = 0; i < calibration_.laser_corrections.size(); ++i) {
+      const velodyne_pointcloud::LaserCorrection &corrections =
+        calibration_.laser_corrections[i];
+      laser_constants_t &constants = laser_constants_[i];
+
+      constants.dist_correction = corrections.dist_correction;
+      constants.cos_vert_correction = corrections.cos_vert_correction;
+      constants.sin_vert_correction = corrections.sin_vert_correction;
+      constants.rot_correction = corrections.rot_correction;
+      constants.cos_rot_correction = corrections.cos_rot_correction;
+      constants.sin_rot_correction = corrections.sin_rot_correction;
+      constants.horiz_offset_correction = corrections.horiz_offset_correction;
+      constants.vert_offset_sin_vert =
+        corrections.vert_offset_correction * corrections.sin_vert_correction;
+      constants.vert_offset_cos_vert =
+        corrections.vert_offset_correction * corrections.cos_vert_correction;
+
+      // Lasers without two point calibration get a zero slope and an
+      // offset equal to dist_correction, which yields exactly zero
+      // correction in the interpolating variants.
+      if (corrections.two_pt_correction_available) {
+        constants.dist_correction_x = corrections.dist_correction_x;
+        constants.dist_correction_y = corrections.dist_correction_y;
+        constants.two_pt_slope_x =
+          (corrections.dist_correction - corrections.dist_correction_x)
+          / (25.04 - 2.4);
+        constants.two_pt_slope_y =
+          (corrections.dist_correction - corrections.dist_correction_y)
+          / (25.04 - 1.93);
+        two_pt_correction = true;
+      }
+      else {
+        constants.dist_correction_x = corrections.dist_correction;
+        constants.dist_correction_y = corrections.dist_correction;
+        constants.two_pt_slope_x = 0;
+        constants.two_pt_slope_y = 0;
+      }
+
+      constants.focal_offset = 256
+                             * (1 - corrections.focal_distance / 13100)
+                             * (1 - corrections.focal_distance / 13100);
+      if (config_.raw_intensity) {
+        // limits of the intensity byte, which leave it unchanged
+        constants.focal_slope = 0;
+        constants.min_intensity = 0;
+        constants.max_intensity = 255;
+      }
+      else {
+        constants.focal_slope = corrections.focal_slope;
+        if (corrections.focal_slope != 0)
+          intensity_correction = true;
+        constants.min_intensity = corrections.min_intensity;
+        constants.max_intensity = corrections.max_intensity;
+      }
+      constants.laser_ring = corrections.laser_ring;
+    }
+
+    ring_lasers_.assign(laser_constants_.size(), -1);
+    for (size_t i = 0; i < laser_constants_.size(); ++i) {
+      if (laser_constants_[i].laser_ring < ring_lasers_.size())
+        ring_lasers_[laser_constants_[i].laser_ring] = i;
+    }
+
+    if (calibration_.num_lasers == 16) {
+      if (two_pt_correction)
+        unpack_fn_ = intensity_correction ? &RawData::unpack_vlp16<true, true>
+                                          : &RawData::unpack_vlp16<true, false>;
+      else
+        unpack_fn_ = intensity_correction ? &RawData::unpack_vlp16<false, true>
+                                          : &RawData::unpack_vlp16<false, false>;
+    }
+    else {
+      if (two_pt_correction)
+        unpack_fn_ = intensity_correction ? &RawData::unpack_blocks<true, true>
+                                          : &RawData::unpack_blocks<true, false>;
+      else
+        unpack_fn_ = intensity_correction ? &RawData::unpack_blocks<false, true>
+                                          : &RawData::unpack_blocks<false, false>;
+    }
+
+    ROS_INFO_STREAM("two point correction: " << (two_pt_correction ? "on" : "off")
+                    << ", intensity correction: " << (intensity_correction ? "on" : "off"));
+  }
+
+  /** Returns of one block or firing, handed to the container in one call. */
+  struct point_batch_t
+  {
+    float x[SCANS_PER_BLOCK];
+    float y[SCANS_PER_BLOCK];
+    float z[SCANS_PER_BLOCK];
+    uint16_t ring[SCANS_PER_BLOCK];
+    uint16_t azimuth[SCANS_PER_BLOCK];
+    float distance[SCANS_PER_BLOCK];
+    float intensity[SCANS_PER_BLOCK];
+    float time[SCANS_PER_BLOCK];
+    size_t count;
+
+    point_batch_t() : count(0) {}
+
+    inline void push(float x_coord, float y_coord, float z_coord, uint16_t laser_ring,
+                     uint16_t rotation, float dist, float inten, float t)
+    {
+      x[count] = x_coord;
+      y[count] = y_coord;
+      z[count] = z_coord;
+      ring[count] = laser_ring;
+      azimuth[count] = rotation;
+      distance[count] = dist;
+      intensity[count] = inten;
+      time[count] = t;
+      ++count;
+    }
+
+    inline void flush(DataContainerBase& data)
+    {
+      if (count)
+        data.addPoints(x, y, z, ring, azimuth, distance, intensity, time, count);
+      count = 0;
+    }
+  };
+
+  /** @brief compute the corrected position of a single return
+   *
+   *  @param constants per-laser constants of the firing laser
+   *  @param distance raw distance plus dist_correction [m]
+   *  @param cos_rot_angle cosine of the corrected rotation
+   *  @param sin_rot_angle sine of the corrected rotation
+   */
+  template <bool TWO_PT_CORRECTION>
+  inline void computePoint(const laser_constants_t &constants, float distance,
+                           float cos_rot_angle, float sin_rot_angle,
+                           float &x_coord, float &y_coord, float &z_coord)
+  {
+    float cos_vert_angle = constants.cos_vert_correction;
+    float sin_vert_angle = constants.sin_vert_correction;
+    float horiz_offset = constants.horiz_offset_correction;
+
+    // Compute the distance in the xy plane (w/o accounting for rotation)
+    /**the new term of 'vert_offset * sin_vert_angle'
+     * was added to the expression due to the mathemathical
+     * model we used.
+     */
+    float xy_distance = distance * cos_vert_angle - constants.vert_offset_sin_vert;
+
+    float distance_x = distance;
+    float distance_y = distance;
+    if (TWO_PT_CORRECTION) {
+      // Calculate temporal X, use absolute value.
+      float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
+      // Calculate temporal Y, use absolute value
+      float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
+      if (xx < 0) xx=-xx;
+      if (yy < 0) yy=-yy;
+
+      // Get 2points calibration values,Linear interpolation to get distance
+      // correction for X and Y, that means distance correction use
+      // different value at different distance
+      float distance_corr_x =
+        constants.two_pt_slope_x * (xx - 2.4) + constants.dist_correction_x;
+      distance_corr_x -= constants.dist_correction;
+      float distance_corr_y =
+        constants.two_pt_slope_y * (yy - 1.93) + constants.dist_correction_y;
+      distance_corr_y -= constants.dist_correction;
+
+      distance_x += distance_corr_x;
+      distance_y += distance_corr_y;
+    }
+
+    xy_distance = distance_x * cos_vert_angle - constants.vert_offset_sin_vert;
+    ///the expression wiht '-' is proved to be better than the one with '+'
+    float x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
+
+    xy_distance = distance_y * cos_vert_angle - constants.vert_offset_sin_vert;
+    float y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
+
+    // Using distance_y is not symmetric, but the velodyne manual
+    // does this.
+    /**the new term of 'vert_offset * cos_vert_angle'
+     * was added to the expression due to the mathemathical
+     * model we used.
+     */
+    float z = distance_y * sin_vert_angle + constants.vert_offset_cos_vert;
+
+    /** Use standard ROS coordinate system (right-hand rule) */
+    x_coord = y;
+    y_coord = -x;
+    z_coord = z;
+  }
 
   /** @brief convert raw packet to point cloud
    *
@@ -266,22 +526,40 @@ inline float SQR(float val) { return val*val; }
    */
   void RawData::unpack(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase& data, const ros::Time& scan_start_time)
   {
-    using velodyne_pointcloud::LaserCorrection;
     ROS_DEBUG_STREAM("Received packet, time: " << pkt.stamp);
+    (this->*unpack_fn_)(pkt, data, scan_start_time);
+  }
 
-    /** special parsing for the VLP16 **/
-    if (calibration_.num_lasers == 16)
-    {
-      unpack_vlp16(pkt, data, scan_start_time);
-      return;
-    }
-
+  /** @brief convert raw packet of 32-laser blocks to point cloud
+   *
+   *  @param pkt raw packet to unpack
+   *  @param pc shared pointer to point cloud (points are appended)
+   */
+  template <bool TWO_PT_CORRECTION, bool INTENSITY_CORRECTION>
+  void RawData::unpack_blocks(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase& data, const ros::Time& scan_start_time)
+  {
     float time_diff_start_to_this_packet = (pkt.stamp - scan_start_time).toSec();
     
     const raw_packet_t *raw = (const raw_packet_t *) &pkt.data[0];
+    point_batch_t batch;
+
+    // skip packets entirely outside the view, keeping one line per block
+    if (!arcInView(raw->blocks[0].rotation,
+                   raw->blocks[BLOCKS_PER_PACKET-1].rotation)) {
+      for (int i = 0; i < BLOCKS_PER_PACKET; i++)
+        data.newLine();
+      return;
+    }
 
     for (int i = 0; i < BLOCKS_PER_PACKET; i++) {
 
+      /*condition added to avoid calculating points which are not
+        in the interesting defined area (min_angle < area < max_angle)*/
+      if (!rotationInView(raw->blocks[i].rotation)) {
+        data.newLine();
+        continue;
+      }
+
       // upper bank lasers are numbered [0..31]
       // NOTE: this is a change from the old velodyne_common implementation
 
@@ -293,12 +571,12 @@ inline float SQR(float val) { return val*val; }
 
       for (int j = 0, k = 0; j < SCANS_PER_BLOCK; j++, k += RAW_SCAN_SIZE) {
         
-        float x, y, z;
+        float x_coord, y_coord, z_coord;
         float intensity;
         const uint8_t laser_number  = j + bank_origin;
         float time = 0;
 
-        const LaserCorrection &corrections = calibration_.laser_corrections[laser_number];
+        const laser_constants_t &constants = laser_constants_[laser_number];
 
         /** Position Calculation */
         const raw_block_t &block = raw->blocks[i];
@@ -306,128 +584,47 @@ inline float SQR(float val) { return val*val; }
         tmp.bytes[0] = block.data[k];
         tmp.bytes[1] = block.data[k+1];
 
-        /*condition added to avoid calculating points which are not
-          in the interesting defined area (min_angle < area < max_angle)*/
-        if ((block.rotation >= config_.min_angle
-             && block.rotation <= config_.max_angle
-             && config_.min_angle < config_.max_angle)
-             ||(config_.min_angle > config_.max_angle 
-             && (raw->blocks[i].rotation <= config_.max_angle 
-             || raw->blocks[i].rotation >= config_.min_angle))){
-
-          if (timing_offsets.size())
-          {
-            time = timing_offsets[i][j] + time_diff_start_to_this_packet;
-          }
+        if (timing_offsets.size())
+        {
+          time = timing_offsets[i][j] + time_diff_start_to_this_packet;
+        }
 
-          if (tmp.uint == 0) // no valid laser beam return
-          {
-            // call to addPoint is still required since output could be organized
-            data.addPoint(nanf(""), nanf(""), nanf(""), corrections.laser_ring, raw->blocks[i].rotation, nanf(""), nanf(""), time);
-            continue;
-          }
+        if (tmp.uint == 0) // no valid laser beam return
+        {
+          // the point is still required since output could be organized
+          batch.push(nanf(""), nanf(""), nanf(""), constants.laser_ring, raw->blocks[i].rotation, nanf(""), nanf(""), time);
+          continue;
+        }
 
-          float distance = tmp.uint * calibration_.distance_resolution_m;
-          distance += corrections.dist_correction;
-  
-          float cos_vert_angle = corrections.cos_vert_correction;
-          float sin_vert_angle = corrections.sin_vert_correction;
-          float cos_rot_correction = corrections.cos_rot_correction;
-          float sin_rot_correction = corrections.sin_rot_correction;
-  
-          // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
-          // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
-          float cos_rot_angle = 
-            cos_rot_table_[block.rotation] * cos_rot_correction +
-            sin_rot_table_[block.rotation] * sin_rot_correction;
-          float sin_rot_angle = 
-            sin_rot_table_[block.rotation] * cos_rot_correction -
-            cos_rot_table_[block.rotation] * sin_rot_correction;
-  
-          float horiz_offset = corrections.horiz_offset_correction;
-          float vert_offset = corrections.vert_offset_correction;
-  
-          // Compute the distance in the xy plane (w/o accounting for rotation)
-          /**the new term of 'vert_offset * sin_vert_angle'
-           * was added to the expression due to the mathemathical
-           * model we used.
-           */
-          float xy_distance = distance * cos_vert_angle - vert_offset * sin_vert_angle;
-  
-          // Calculate temporal X, use absolute value.
-          float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-          // Calculate temporal Y, use absolute value
-          float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-          if (xx < 0) xx=-xx;
-          if (yy < 0) yy=-yy;
-    
-          // Get 2points calibration values,Linear interpolation to get distance
-          // correction for X and Y, that means distance correction use
-          // different value at different distance
-          float distance_corr_x = 0;
-          float distance_corr_y = 0;
-          if (corrections.two_pt_correction_available) {
-            distance_corr_x = 
-              (corrections.dist_correction - corrections.dist_correction_x)
-                * (xx - 2.4) / (25.04 - 2.4) 
-              + corrections.dist_correction_x;
-            distance_corr_x -= corrections.dist_correction;
-            distance_corr_y = 
-              (corrections.dist_correction - corrections.dist_correction_y)
-                * (yy - 1.93) / (25.04 - 1.93)
-              + corrections.dist_correction_y;
-            distance_corr_y -= corrections.dist_correction;
-          }
-  
-          float distance_x = distance + distance_corr_x;
-          /**the new term of 'vert_offset * sin_vert_angle'
-           * was added to the expression due to the mathemathical
-           * model we used.
-           */
-          xy_distance = distance_x * cos_vert_angle - vert_offset * sin_vert_angle ;
-          ///the expression wiht '-' is proved to be better than the one with '+'
-          x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-  
-          float distance_y = distance + distance_corr_y;
-          xy_distance = distance_y * cos_vert_angle - vert_offset * sin_vert_angle ;
-          /**the new term of 'vert_offset * sin_vert_angle'
-           * was added to the expression due to the mathemathical
-           * model we used.
-           */
-          y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-  
-          // Using distance_y is not symmetric, but the velodyne manual
-          // does this.
-          /**the new term of 'vert_offset * cos_vert_angle'
-           * was added to the expression due to the mathemathical
-           * model we used.
-           */
-          z = distance_y * sin_vert_angle + vert_offset*cos_vert_angle;
-  
-          /** Use standard ROS coordinate system (right-hand rule) */
-          float x_coord = y;
-          float y_coord = -x;
-          float z_coord = z;
-  
-          /** Intensity Calculation */
-  
-          float min_intensity = corrections.min_intensity;
-          float max_intensity = corrections.max_intensity;
+        float distance = tmp.uint * calibration_.distance_resolution_m;
+        distance += constants.dist_correction;
+
+        // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
+        // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
+        float cos_rot_angle = 
+          cos_rot_table_[block.rotation] * constants.cos_rot_correction +
+          sin_rot_table_[block.rotation] * constants.sin_rot_correction;
+        float sin_rot_angle = 
+          sin_rot_table_[block.rotation] * constants.cos_rot_correction -
+          cos_rot_table_[block.rotation] * constants.sin_rot_correction;
+
+        computePoint<TWO_PT_CORRECTION>(constants, distance, cos_rot_angle, sin_rot_angle,
+                                        x_coord, y_coord, z_coord);
   
-          intensity = raw->blocks[i].data[k+2];
+        /** Intensity Calculation */
   
-          float focal_offset = 256 
-                             * (1 - corrections.focal_distance / 13100) 
-                             * (1 - corrections.focal_distance / 13100);
-          float focal_slope = corrections.focal_slope;
-          intensity += focal_slope * (std::abs(focal_offset - 256 * 
-            SQR(1 - static_cast<float>(tmp.uint)/65535)));
-          intensity = (intensity < min_intensity) ? min_intensity : intensity;
-          intensity = (intensity > max_intensity) ? max_intensity : intensity;
+        intensity = raw->blocks[i].data[k+2];
 
-          data.addPoint(x_coord, y_coord, z_coord, corrections.laser_ring, raw->blocks[i].rotation, distance, intensity, time);
+        if (INTENSITY_CORRECTION) {
+          intensity += constants.focal_slope * (std::abs(constants.focal_offset - 256 *
+            SQR(1 - static_cast<float>(tmp.uint)/65535)));
         }
+        intensity = (intensity < constants.min_intensity) ? constants.min_intensity : intensity;
+        intensity = (intensity > constants.max_intensity) ? constants.max_intensity : intensity;
+
+        batch.push(x_coord, y_coord, z_coord, constants.laser_ring, raw->blocks[i].rotation, distance, intensity, time);
       }
+      batch.flush(data);
       data.newLine();
     }
   }
@@ -437,6 +634,7 @@ inline float SQR(float val) { return val*val; }
    *  @param pkt raw packet to unpack
    *  @param pc shared pointer to point cloud (points are appended)
    */
+  template <bool TWO_PT_CORRECTION, bool INTENSITY_CORRECTION>
   void RawData::unpack_vlp16(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase& data, const ros::Time& scan_start_time)
   {
     float azimuth;
@@ -445,12 +643,26 @@ inline float SQR(float val) { return val*val; }
     float last_azimuth_diff=0;
     float azimuth_corrected_f;
     int azimuth_corrected;
-    float x, y, z;
+    float x_coord, y_coord, z_coord;
     float intensity;
 
     float time_diff_start_to_this_packet = (pkt.stamp - scan_start_time).toSec();
 
     const raw_packet_t *raw = (const raw_packet_t *) &pkt.data[0];
+    point_batch_t batch;
+
+    // skip packets entirely outside the view, keeping one line per
+    // firing; the last block reaches about one block step further
+    const int first_rotation = raw->blocks[0].rotation;
+    const int last_rotation = raw->blocks[BLOCKS_PER_PACKET-1].rotation;
+    const int packet_span = ((last_rotation - first_rotation) % 36000 + 36000) % 36000;
+    if (packet_span < 18000
+        && !arcInView(first_rotation,
+                      last_rotation + packet_span / (BLOCKS_PER_PACKET-1) + 1)) {
+      for (int i = 0; i < BLOCKS_PER_PACKET * VLP16_FIRINGS_PER_BLOCK; i++)
+        data.newLine();
+      return;
+    }
 
     for (int block = 0; block < BLOCKS_PER_PACKET; block++) {
 
@@ -488,9 +700,17 @@ inline float SQR(float val) { return val*val; }
         azimuth_diff = last_azimuth_diff;
       }
 
+      // skip blocks whose firings are all outside the view
+      if (!arcInView(raw->blocks[block].rotation,
+                     raw->blocks[block].rotation + (int)ceil(azimuth_diff))) {
+        for (int firing = 0; firing < VLP16_FIRINGS_PER_BLOCK; firing++)
+          data.newLine();
+        continue;
+      }
+
       for (int firing=0, k=0; firing < VLP16_FIRINGS_PER_BLOCK; firing++){
         for (int dsr=0; dsr < VLP16_SCANS_PER_FIRING; dsr++, k+=RAW_SCAN_SIZE){
-          velodyne_pointcloud::LaserCorrection &corrections = calibration_.laser_corrections[dsr];
+          const laser_constants_t &constants = laser_constants_[dsr];
 
           /** Position Calculation */
           union two_bytes tmp;
@@ -503,118 +723,156 @@ inline float SQR(float val) { return val*val; }
                  
           /*condition added to avoid calculating points which are not
             in the interesting defined area (min_angle < area < max_angle)*/
-          if ((azimuth_corrected >= config_.min_angle 
-               && azimuth_corrected <= config_.max_angle 
-               && config_.min_angle < config_.max_angle)
-               ||(config_.min_angle > config_.max_angle 
-               && (azimuth_corrected <= config_.max_angle 
-               || azimuth_corrected >= config_.min_angle))){
+          if (rotationInView(azimuth_corrected)){
 
             // convert polar coordinates to Euclidean XYZ
             float distance = tmp.uint * calibration_.distance_resolution_m;
-            distance += corrections.dist_correction;
-            
-            float cos_vert_angle = corrections.cos_vert_correction;
-            float sin_vert_angle = corrections.sin_vert_correction;
-            float cos_rot_correction = corrections.cos_rot_correction;
-            float sin_rot_correction = corrections.sin_rot_correction;
-    
+            distance += constants.dist_correction;
+
             // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
             // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
             float cos_rot_angle = 
-              cos_rot_table_[azimuth_corrected] * cos_rot_correction + 
-              sin_rot_table_[azimuth_corrected] * sin_rot_correction;
+              cos_rot_table_[azimuth_corrected] * constants.cos_rot_correction + 
+              sin_rot_table_[azimuth_corrected] * constants.sin_rot_correction;
             float sin_rot_angle = 
-              sin_rot_table_[azimuth_corrected] * cos_rot_correction - 
-              cos_rot_table_[azimuth_corrected] * sin_rot_correction;
-    
-            float horiz_offset = corrections.horiz_offset_correction;
-            float vert_offset = corrections.vert_offset_correction;
-    
-            // Compute the distance in the xy plane (w/o accounting for rotation)
-            /**the new term of 'vert_offset * sin_vert_angle'
-             * was added to the expression due to the mathemathical
-             * model we used.
-             */
-            float xy_distance = distance * cos_vert_angle - vert_offset * sin_vert_angle;
-    
-            // Calculate temporal X, use absolute value.
-            float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-            // Calculate temporal Y, use absolute value
-            float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-            if (xx < 0) xx=-xx;
-            if (yy < 0) yy=-yy;
-      
-            // Get 2points calibration values,Linear interpolation to get distance
-            // correction for X and Y, that means distance correction use
-            // different value at different distance
-            float distance_corr_x = 0;
-            float distance_corr_y = 0;
-            if (corrections.two_pt_correction_available) {
-              distance_corr_x = 
-                (corrections.dist_correction - corrections.dist_correction_x)
-                  * (xx - 2.4) / (25.04 - 2.4) 
-                + corrections.dist_correction_x;
-              distance_corr_x -= corrections.dist_correction;
-              distance_corr_y = 
-                (corrections.dist_correction - corrections.dist_correction_y)
-                  * (yy - 1.93) / (25.04 - 1.93)
-                + corrections.dist_correction_y;
-              distance_corr_y -= corrections.dist_correction;
-            }
-    
-            float distance_x = distance + distance_corr_x;
-            /**the new term of 'vert_offset * sin_vert_angle'
-             * was added to the expression due to the mathemathical
-             * model we used.
-             */
-            xy_distance = distance_x * cos_vert_angle - vert_offset * sin_vert_angle ;
-            x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-    
-            float distance_y = distance + distance_corr_y;
-            /**the new term of 'vert_offset * sin_vert_angle'
-             * was added to the expression due to the mathemathical
-             * model we used.
-             */
-            xy_distance = distance_y * cos_vert_angle - vert_offset * sin_vert_angle ;
-            y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-    
-            // Using distance_y is not symmetric, but the velodyne manual
-            // does this.
-            /**the new term of 'vert_offset * cos_vert_angle'
-             * was added to the expression due to the mathemathical
-             * model we used.
-             */
-            z = distance_y * sin_vert_angle + vert_offset*cos_vert_angle;
-  
-    
-            /** Use standard ROS coordinate system (right-hand rule) */
-            float x_coord = y;
-            float y_coord = -x;
-            float z_coord = z;
+              sin_rot_table_[azimuth_corrected] * constants.cos_rot_correction - 
+              cos_rot_table_[azimuth_corrected] * constants.sin_rot_correction;
+
+            computePoint<TWO_PT_CORRECTION>(constants, distance, cos_rot_angle, sin_rot_angle,
+                                            x_coord, y_coord, z_coord);
     
             /** Intensity Calculation */
-            float min_intensity = corrections.min_intensity;
-            float max_intensity = corrections.max_intensity;
-    
             intensity = raw->blocks[block].data[k+2];
-    
-            float focal_offset = 256 * SQR(1 - corrections.focal_distance / 13100);
-            float focal_slope = corrections.focal_slope;
-            intensity += focal_slope * (std::abs(focal_offset - 256 * 
-              SQR(1 - tmp.uint/65535)));
-            intensity = (intensity < min_intensity) ? min_intensity : intensity;
-            intensity = (intensity > max_intensity) ? max_intensity : intensity;
+
+            if (INTENSITY_CORRECTION) {
+              intensity += constants.focal_slope * (std::abs(constants.focal_offset - 256 *
+                SQR(1 - tmp.uint/65535)));
+            }
+            intensity = (intensity < constants.min_intensity) ? constants.min_intensity : intensity;
+            intensity = (intensity > constants.max_intensity) ? constants.max_intensity : intensity;
   
             float time = 0;
             if (timing_offsets.size())
               time = timing_offsets[block][firing * 16 + dsr] + time_diff_start_to_this_packet;
 
-            data.addPoint(x_coord, y_coord, z_coord, corrections.laser_ring, azimuth_corrected, distance, intensity, time);
+            batch.push(x_coord, y_coord, z_coord, constants.laser_ring, azimuth_corrected, distance, intensity, time);
           }
         }
+        batch.flush(data);
         data.newLine();
       }
     }
   }
+
+  /** @brief decode the returns of a single ring
+   *
+   *  @param pkt raw packet to unpack
+   *  @param ring laser ring to decode
+   *  @param returns the ring's returns are appended here
+   */
+  void RawData::unpackRing(const velodyne_msgs::VelodynePacket &pkt, uint16_t ring,
+                           std::vector<ring_return_t> &returns) const
+  {
+    if (ring >= ring_lasers_.size() || ring_lasers_[ring] < 0)
+      return;
+    const int laser_number = ring_lasers_[ring];
+    const laser_constants_t &constants = laser_constants_[laser_number];
+    const raw_packet_t *raw = (const raw_packet_t *) &pkt.data[0];
+
+    if (calibration_.num_lasers == 16) {
+      // interpolate the firing's rotation as unpack_vlp16() does
+      float last_azimuth_diff = 0;
+      for (int block = 0; block < BLOCKS_PER_PACKET; block++) {
+        if (UPPER_BANK != raw->blocks[block].header)
+          return;                         // bad packet: skip the rest
+
+        float azimuth_diff = last_azimuth_diff;
+        if (block < (BLOCKS_PER_PACKET-1)) {
+          const int raw_azimuth_diff =
+            raw->blocks[block+1].rotation - raw->blocks[block].rotation;
+          if (raw_azimuth_diff >= 0)
+            azimuth_diff = raw_azimuth_diff;
+          else if (last_azimuth_diff <= 0)
+            continue;                     // angle overflow, no previous step
+          last_azimuth_diff = azimuth_diff;
+        }
+
+        for (int firing = 0; firing < VLP16_FIRINGS_PER_BLOCK; firing++) {
+          const float azimuth_corrected_f = raw->blocks[block].rotation
+            + (azimuth_diff * ((laser_number*VLP16_DSR_TOFFSET) + (firing*VLP16_FIRING_TOFFSET))
+               / VLP16_BLOCK_TDURATION);
+          const int k = (firing * VLP16_SCANS_PER_FIRING + laser_number) * RAW_SCAN_SIZE;
+          addRingReturn(constants, &raw->blocks[block].data[k],
+                        ((int)round(azimuth_corrected_f)) % 36000, returns);
+        }
+      }
+    }
+    else {
+      // lower bank blocks carry lasers [32..63]
+      const bool lower_bank = laser_number >= SCANS_PER_BLOCK;
+      const int k = (laser_number % SCANS_PER_BLOCK) * RAW_SCAN_SIZE;
+      for (int i = 0; i < BLOCKS_PER_PACKET; i++) {
+        if ((raw->blocks[i].header == LOWER_BANK) == lower_bank)
+          addRingReturn(constants, &raw->blocks[i].data[k], raw->blocks[i].rotation, returns);
+      }
+    }
+  }
+
+  void RawData::addRingReturn(const laser_constants_t &constants, const uint8_t *data,
+                              int rotation, std::vector<ring_return_t> &returns) const
+  {
+    union two_bytes tmp;
+    tmp.bytes[0] = data[0];
+    tmp.bytes[1] = data[1];
+    if (tmp.uint == 0 || rotation >= ROTATION_MAX_UNITS || !rotationInView(rotation))
+      return;
+
+    const float distance = tmp.uint * calibration_.distance_resolution_m + constants.dist_correction;
+    if (distance < config_.min_range || distance > config_.max_range)
+      return;
+
+    ring_return_t ret;
+    if (constants.two_pt_slope_x != 0 || constants.two_pt_slope_y != 0) {
+      // the two point correction differs along x and y: take the full point
+      const float cos_rot_angle =
+        cos_rot_table_[rotation] * constants.cos_rot_correction +
+        sin_rot_table_[rotation] * constants.sin_rot_correction;
+      const float sin_rot_angle =
+        sin_rot_table_[rotation] * constants.cos_rot_correction -
+        cos_rot_table_[rotation] * constants.sin_rot_correction;
+      float x, y, z;
+      computePoint<true>(constants, distance, cos_rot_angle, sin_rot_angle, x, y, z);
+      ret.range = sqrtf(x * x + y * y);
+      ret.angle = atan2f(y, x);
+    }
+    else {
+      // the point is the horizontal offset rotated by the corrected
+      // rotation, so the bearing is that rotation plus a small angle
+      const float xy_distance = distance * constants.cos_vert_correction - constants.vert_offset_sin_vert;
+      if (xy_distance <= 0)
+        return;
+      const float horiz_offset = constants.horiz_offset_correction;
+      ret.range = sqrtf(xy_distance * xy_distance + horiz_offset * horiz_offset);
+      ret.angle = constants.rot_correction
+        - angles::from_degrees(ROTATION_RESOLUTION * rotation)
+        + horiz_offset / xy_distance;
+      while (ret.angle < -M_PI)
+        ret.angle += 2 * M_PI;
+      while (ret.angle >= M_PI)
+        ret.angle -= 2 * M_PI;
+    }
+
+    // same intensity as the point cloud, including unpack_vlp16()'s
+    // integer division
+    const float scaled_distance = calibration_.num_lasers == 16 ? tmp.uint/65535
+                                                                : static_cast<float>(tmp.uint)/65535;
+    float intensity = data[2];
+    intensity += constants.focal_slope * (std::abs(constants.focal_offset - 256 *
+      SQR(1 - scaled_distance)));
+    intensity = (intensity < constants.min_intensity) ? constants.min_intensity : intensity;
+    intensity = (intensity > constants.max_intensity) ? constants.max_intensity : intensity;
+    ret.intensity = intensity;
+
+    returns.push_back(ret);
+  }
 } // namespace velodyne_rawdata
@@ -0,0 +1,226 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/calibration_cache.h>
+#include <velodyne_pointcloud/rawdata.h>
+
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using velodyne_pointcloud::Calibration;
+
+namespace
+{
+const size_t TABLE_SIZE = 36000;
+
+std::string paramsFile(const std::string& name)
+{
+  return std::string(VELODYNE_POINTCLOUD_PARAMS_DIR) + "/" + name;
+}
+
+std::string cacheFile(const std::string& name)
+{
+  std::ostringstream path;
+  path << "/tmp/test_calibration_cache_" << getpid() << "_" << name;
+  return path.str();
+}
+
+struct Tables
+{
+  std::vector<float> cos_table;
+  std::vector<float> sin_table;
+
+  explicit Tables(float value = 0.0f) : cos_table(TABLE_SIZE, value), sin_table(TABLE_SIZE, value) {}
+};
+
+Tables rotationTables()
+{
+  Tables tables;
+  for (size_t i = 0; i < TABLE_SIZE; ++i)
+  {
+    tables.cos_table[i] = cosf(i * 0.01f * M_PI / 180);
+    tables.sin_table[i] = sinf(i * 0.01f * M_PI / 180);
+  }
+  return tables;
+}
+
+void expectSameCorrection(const velodyne_pointcloud::LaserCorrection& a,
+                          const velodyne_pointcloud::LaserCorrection& b)
+{
+  EXPECT_EQ(a.rot_correction, b.rot_correction);
+  EXPECT_EQ(a.vert_correction, b.vert_correction);
+  EXPECT_EQ(a.dist_correction, b.dist_correction);
+  EXPECT_EQ(a.two_pt_correction_available, b.two_pt_correction_available);
+  EXPECT_EQ(a.dist_correction_x, b.dist_correction_x);
+  EXPECT_EQ(a.dist_correction_y, b.dist_correction_y);
+  EXPECT_EQ(a.vert_offset_correction, b.vert_offset_correction);
+  EXPECT_EQ(a.horiz_offset_correction, b.horiz_offset_correction);
+  EXPECT_EQ(a.max_intensity, b.max_intensity);
+  EXPECT_EQ(a.min_intensity, b.min_intensity);
+  EXPECT_EQ(a.focal_distance, b.focal_distance);
+  EXPECT_EQ(a.focal_slope, b.focal_slope);
+  EXPECT_EQ(a.cos_rot_correction, b.cos_rot_correction);
+  EXPECT_EQ(a.sin_rot_correction, b.sin_rot_correction);
+  EXPECT_EQ(a.cos_vert_correction, b.cos_vert_correction);
+  EXPECT_EQ(a.sin_vert_correction, b.sin_vert_correction);
+  EXPECT_EQ(a.laser_ring, b.laser_ring);
+}
+}  // namespace
+
+TEST(CalibrationCache, roundTrip)
+{
+  const std::string source = paramsFile("64e_utexas.yaml");
+  const std::string cache = cacheFile("round_trip");
+  Calibration calibration(source, false);
+  ASSERT_TRUE(calibration.initialized);
+  uint64_t checksum;
+  ASSERT_TRUE(velodyne_pointcloud::calibrationChecksum(source, checksum));
+
+  const Tables tables = rotationTables();
+  ASSERT_TRUE(velodyne_pointcloud::writeCalibrationCache(cache, checksum, calibration, tables.cos_table.data(),
+                                                         tables.sin_table.data(), TABLE_SIZE));
+
+  Calibration cached(false);
+  Tables loaded;
+  ASSERT_TRUE(velodyne_pointcloud::readCalibrationCache(cache, checksum, cached, loaded.cos_table.data(),
+                                                        loaded.sin_table.data(), TABLE_SIZE));
+  EXPECT_TRUE(cached.initialized);
+  EXPECT_EQ(calibration.num_lasers, cached.num_lasers);
+  EXPECT_EQ(calibration.distance_resolution_m, cached.distance_resolution_m);
+  ASSERT_EQ(calibration.laser_corrections.size(), cached.laser_corrections.size());
+  for (size_t i = 0; i < calibration.laser_corrections.size(); ++i)
+    expectSameCorrection(calibration.laser_corrections[i], cached.laser_corrections[i]);
+  ASSERT_EQ(calibration.laser_corrections_map.size(), cached.laser_corrections_map.size());
+  for (std::map<int, velodyne_pointcloud::LaserCorrection>::const_iterator it =
+           calibration.laser_corrections_map.begin();
+       it != calibration.laser_corrections_map.end(); ++it)
+  {
+    ASSERT_EQ(1u, cached.laser_corrections_map.count(it->first));
+    expectSameCorrection(it->second, cached.laser_corrections_map[it->first]);
+  }
+  EXPECT_TRUE(tables.cos_table == loaded.cos_table);
+  EXPECT_TRUE(tables.sin_table == loaded.sin_table);
+  remove(cache.c_str());
+}
+
+TEST(CalibrationCache, rejectsStaleOrDamagedCache)
+{
+  const std::string source = paramsFile("VLP16db.yaml");
+  const std::string cache = cacheFile("stale");
+  Calibration calibration(source, false);
+  ASSERT_TRUE(calibration.initialized);
+  uint64_t checksum;
+  ASSERT_TRUE(velodyne_pointcloud::calibrationChecksum(source, checksum));
+  const Tables tables = rotationTables();
+  ASSERT_TRUE(velodyne_pointcloud::writeCalibrationCache(cache, checksum, calibration, tables.cos_table.data(),
+                                                         tables.sin_table.data(), TABLE_SIZE));
+
+  // another calibration file or table size
+  Calibration cached(false);
+  Tables loaded(-1.0f);
+  EXPECT_FALSE(velodyne_pointcloud::readCalibrationCache(cache, checksum + 1, cached, loaded.cos_table.data(),
+                                                         loaded.sin_table.data(), TABLE_SIZE));
+  EXPECT_FALSE(velodyne_pointcloud::readCalibrationCache(cache, checksum, cached, loaded.cos_table.data(),
+                                                         loaded.sin_table.data(), TABLE_SIZE / 2));
+  EXPECT_FALSE(velodyne_pointcloud::readCalibrationCache(cacheFile("missing"), checksum, cached,
+                                                         loaded.cos_table.data(), loaded.sin_table.data(),
+                                                         TABLE_SIZE));
+
+  // damaged payload
+  std::vector<char> bytes;
+  {
+    std::ifstream in(cache.c_str(), std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  ASSERT_GT(bytes.size(), 1000u);
+  bytes[bytes.size() - 1000] ^= 0x10;
+  {
+    std::ofstream out(cache.c_str(), std::ios::binary);
+    out.write(bytes.data(), bytes.size());
+  }
+  EXPECT_FALSE(velodyne_pointcloud::readCalibrationCache(cache, checksum, cached, loaded.cos_table.data(),
+                                                         loaded.sin_table.data(), TABLE_SIZE));
+
+  // truncated file
+  {
+    std::ofstream out(cache.c_str(), std::ios::binary);
+    out.write(bytes.data(), bytes.size() / 2);
+  }
+  EXPECT_FALSE(velodyne_pointcloud::readCalibrationCache(cache, checksum, cached, loaded.cos_table.data(),
+                                                         loaded.sin_table.data(), TABLE_SIZE));
+
+  // rejected caches leave the outputs untouched
+  EXPECT_FALSE(cached.initialized);
+  EXPECT_EQ(0, cached.num_lasers);
+  EXPECT_EQ(-1.0f, loaded.cos_table[0]);
+  remove(cache.c_str());
+}
+
+TEST(CalibrationCache, rawDataCreatesAndUsesCache)
+{
+  const std::string source = paramsFile("VLP16db.yaml");
+  const std::string cache = cacheFile("raw_data");
+  remove(cache.c_str());
+
+  velodyne_rawdata::RawData first;
+  ASSERT_EQ(0, first.setupOffline(source, 130.0, 0.4, cache));
+  ASSERT_EQ(0, access(cache.c_str(), R_OK));
+
+  uint64_t checksum;
+  ASSERT_TRUE(velodyne_pointcloud::calibrationChecksum(source, checksum));
+  Calibration cached(false);
+  Tables loaded;
+  EXPECT_TRUE(velodyne_pointcloud::readCalibrationCache(cache, checksum, cached, loaded.cos_table.data(),
+                                                        loaded.sin_table.data(), TABLE_SIZE));
+  EXPECT_EQ(16, cached.num_lasers);
+
+  velodyne_rawdata::RawData second;
+  ASSERT_EQ(0, second.setupOffline(source, 130.0, 0.4, cache));
+  EXPECT_EQ(first.scansPerPacket(), second.scansPerPacket());
+  remove(cache.c_str());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
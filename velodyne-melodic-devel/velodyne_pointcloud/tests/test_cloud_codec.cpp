@@ -0,0 +1,232 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/cloud_codec.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+using velodyne_pointcloud::CloudCodec;
+
+namespace
+{
+void addField(sensor_msgs::PointCloud2& cloud, const std::string& name, uint32_t offset, uint8_t datatype)
+{
+  sensor_msgs::PointField field;
+  field.name = name;
+  field.offset = offset;
+  field.datatype = datatype;
+  field.count = 1;
+  cloud.fields.push_back(field);
+}
+
+template <typename T>
+void setValue(sensor_msgs::PointCloud2& cloud, size_t point, uint32_t offset, T value)
+{
+  memcpy(&cloud.data[point * cloud.point_step + offset], &value, sizeof(T));
+}
+
+float getFloat(const sensor_msgs::PointCloud2& cloud, size_t point, uint32_t offset)
+{
+  float value;
+  memcpy(&value, &cloud.data[point * cloud.point_step + offset], sizeof(value));
+  return value;
+}
+
+/// a cloud in the velodyne_pointcloud XYZIR layout, ring interleaved
+sensor_msgs::PointCloud2 makeXYZIR(unsigned int rings, unsigned int columns, bool organized, bool holes)
+{
+  sensor_msgs::PointCloud2 cloud;
+  addField(cloud, "x", 0, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "y", 4, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "z", 8, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "intensity", 12, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "ring", 16, sensor_msgs::PointField::UINT16);
+  addField(cloud, "time", 18, sensor_msgs::PointField::FLOAT32);
+  cloud.point_step = 22;
+  cloud.height = organized ? columns : 1;
+  cloud.width = organized ? rings : rings * columns;
+  cloud.row_step = cloud.width * cloud.point_step;
+  cloud.data.resize(cloud.row_step * cloud.height);
+  cloud.is_dense = !holes;
+
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for (unsigned int column = 0; column < columns; ++column)
+  {
+    for (unsigned int ring = 0; ring < rings; ++ring)
+    {
+      const size_t i = column * rings + ring;
+      const float azimuth = column * 0.0035f;
+      const float elevation = (static_cast<float>(ring) - rings / 2.0f) * 0.035f;
+      const float range = 12.0f + 4.0f * std::sin(azimuth * 3.0f + ring);
+      const bool hole = holes && (i % 17) == 3;
+      setValue(cloud, i, 0, hole ? nan : range * std::cos(elevation) * std::cos(azimuth));
+      setValue(cloud, i, 4, hole ? nan : range * std::cos(elevation) * std::sin(azimuth));
+      setValue(cloud, i, 8, hole ? nan : range * std::sin(elevation));
+      setValue(cloud, i, 12, hole ? nan : static_cast<float>((column + 7 * ring) % 100));
+      setValue(cloud, i, 16, static_cast<uint16_t>(ring));
+      setValue(cloud, i, 18, column * 5.5e-5f);
+    }
+  }
+  return cloud;
+}
+
+sensor_msgs::PointCloud2 roundTrip(const sensor_msgs::PointCloud2& cloud, double resolution, size_t* size = NULL)
+{
+  CloudCodec codec(resolution);
+  std::vector<uint8_t> data;
+  EXPECT_TRUE(codec.encode(cloud, data));
+  if (size)
+    *size = data.size();
+
+  sensor_msgs::PointCloud2 decoded;
+  EXPECT_TRUE(codec.decode(data, decoded));
+  EXPECT_EQ(cloud.height, decoded.height);
+  EXPECT_EQ(cloud.width, decoded.width);
+  EXPECT_EQ(cloud.point_step, decoded.point_step);
+  EXPECT_EQ(cloud.row_step, decoded.row_step);
+  EXPECT_EQ(cloud.is_dense, decoded.is_dense);
+  EXPECT_EQ(cloud.fields.size(), decoded.fields.size());
+  return decoded;
+}
+}  // namespace
+
+TEST(CloudCodec, losslessXYZIR)
+{
+  sensor_msgs::PointCloud2 cloud = makeXYZIR(16, 200, false, false);
+  sensor_msgs::PointCloud2 decoded = roundTrip(cloud, 0.0);
+  EXPECT_TRUE(cloud.data == decoded.data);
+}
+
+TEST(CloudCodec, quantizedXYZIR)
+{
+  const double resolution = 0.002;
+  sensor_msgs::PointCloud2 cloud = makeXYZIR(32, 300, false, false);
+  size_t size;
+  sensor_msgs::PointCloud2 decoded = roundTrip(cloud, resolution, &size);
+  EXPECT_LT(size, cloud.data.size() / 3);
+
+  for (size_t i = 0; i < cloud.width; ++i)
+  {
+    for (uint32_t offset = 0; offset < 12; offset += 4)
+      EXPECT_NEAR(getFloat(cloud, i, offset), getFloat(decoded, i, offset), resolution / 2 + 1e-6);
+    // intensity, ring and time are kept bit-exact
+    EXPECT_EQ(0, memcmp(&cloud.data[i * cloud.point_step + 12], &decoded.data[i * cloud.point_step + 12], 10));
+  }
+}
+
+TEST(CloudCodec, organizedWithHoles)
+{
+  sensor_msgs::PointCloud2 cloud = makeXYZIR(16, 100, true, true);
+  sensor_msgs::PointCloud2 decoded = roundTrip(cloud, 0.001);
+
+  for (size_t i = 0; i < static_cast<size_t>(cloud.width) * cloud.height; ++i)
+  {
+    for (uint32_t offset = 0; offset < 16; offset += 4)
+    {
+      const float expected = getFloat(cloud, i, offset);
+      const float actual = getFloat(decoded, i, offset);
+      if (std::isnan(expected))
+        EXPECT_TRUE(std::isnan(actual));
+      else
+        EXPECT_NEAR(expected, actual, 0.0005 + 1e-6);
+    }
+  }
+
+  decoded = roundTrip(cloud, 0.0);
+  EXPECT_TRUE(cloud.data == decoded.data);
+}
+
+TEST(CloudCodec, lslidarLayout)
+{
+  // PointXYZIT of the lslidar_c32 decoder: int32 laserid, padded to 48 bytes
+  sensor_msgs::PointCloud2 cloud;
+  addField(cloud, "x", 0, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "y", 4, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "z", 8, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "intensity", 16, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "v_angle", 20, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "h_angle", 24, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "range", 28, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "laserid", 32, sensor_msgs::PointField::INT32);
+  cloud.point_step = 48;
+  cloud.height = 1;
+  cloud.width = 32 * 100;
+  cloud.row_step = cloud.width * cloud.point_step;
+  cloud.data.assign(cloud.row_step, 0);
+  for (size_t i = 0; i < cloud.width; ++i)
+  {
+    const int32_t laser = static_cast<int32_t>(i % 32);
+    const float range = 5.0f + 0.01f * i;
+    setValue(cloud, i, 0, range * 0.8f);
+    setValue(cloud, i, 4, range * 0.6f);
+    setValue(cloud, i, 8, 0.05f * (laser - 16));
+    setValue(cloud, i, 16, static_cast<float>(i % 200));
+    setValue(cloud, i, 20, static_cast<float>(laser - 16));
+    setValue(cloud, i, 24, 0.18f * (i / 32));
+    setValue(cloud, i, 28, range);
+    setValue(cloud, i, 32, laser);
+  }
+
+  sensor_msgs::PointCloud2 decoded = roundTrip(cloud, 0.0);
+  EXPECT_TRUE(cloud.data == decoded.data);
+}
+
+TEST(CloudCodec, rejectsBadData)
+{
+  sensor_msgs::PointCloud2 cloud = makeXYZIR(16, 10, false, false);
+  CloudCodec codec;
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(codec.encode(cloud, data));
+
+  sensor_msgs::PointCloud2 decoded;
+  std::vector<uint8_t> truncated(data.begin(), data.begin() + data.size() / 2);
+  EXPECT_FALSE(codec.decode(truncated, decoded));
+
+  data[0] = 'X';
+  EXPECT_FALSE(codec.decode(data, decoded));
+
+  cloud.data.resize(cloud.data.size() - 1);
+  EXPECT_FALSE(codec.encode(cloud, data));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,215 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/cloud_decimator.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+
+using velodyne_pointcloud::CloudDecimator;
+
+namespace
+{
+void addField(sensor_msgs::PointCloud2& cloud, const std::string& name, uint32_t offset, uint8_t datatype)
+{
+  sensor_msgs::PointField field;
+  field.name = name;
+  field.offset = offset;
+  field.datatype = datatype;
+  field.count = 1;
+  cloud.fields.push_back(field);
+}
+
+template <typename T>
+void setValue(sensor_msgs::PointCloud2& cloud, size_t point, uint32_t offset, T value)
+{
+  memcpy(&cloud.data[point * cloud.point_step + offset], &value, sizeof(T));
+}
+
+template <typename T>
+T getValue(const sensor_msgs::PointCloud2& cloud, size_t point, uint32_t offset)
+{
+  T value;
+  memcpy(&value, &cloud.data[point * cloud.point_step + offset], sizeof(value));
+  return value;
+}
+
+/// a cloud in the velodyne_pointcloud XYZIR layout, ring interleaved
+sensor_msgs::PointCloud2 makeXYZIR(unsigned int rings, unsigned int columns, bool organized)
+{
+  sensor_msgs::PointCloud2 cloud;
+  addField(cloud, "x", 0, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "y", 4, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "z", 8, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "intensity", 12, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "ring", 16, sensor_msgs::PointField::UINT16);
+  addField(cloud, "time", 18, sensor_msgs::PointField::FLOAT32);
+  cloud.header.frame_id = "velodyne";
+  cloud.point_step = 22;
+  cloud.height = organized ? columns : 1;
+  cloud.width = organized ? rings : rings * columns;
+  cloud.row_step = cloud.width * cloud.point_step;
+  cloud.data.resize(cloud.row_step * cloud.height);
+
+  for (unsigned int column = 0; column < columns; ++column)
+  {
+    for (unsigned int ring = 0; ring < rings; ++ring)
+    {
+      const size_t i = column * rings + ring;
+      const float azimuth = column * 0.0035f;
+      const float elevation = (static_cast<float>(ring) - rings / 2.0f) * 0.035f;
+      const float range = 12.0f;
+      setValue(cloud, i, 0, range * std::cos(elevation) * std::cos(azimuth));
+      setValue(cloud, i, 4, range * std::cos(elevation) * std::sin(azimuth));
+      setValue(cloud, i, 8, range * std::sin(elevation));
+      setValue(cloud, i, 12, static_cast<float>(ring));
+      setValue(cloud, i, 16, static_cast<uint16_t>(ring));
+      setValue(cloud, i, 18, column * 5.5e-5f);
+    }
+  }
+  return cloud;
+}
+}  // namespace
+
+TEST(CloudDecimator, disabledByDefault)
+{
+  CloudDecimator decimator;
+  EXPECT_FALSE(decimator.enabled());
+
+  sensor_msgs::PointCloud2 cloud = makeXYZIR(16, 50, false);
+  sensor_msgs::PointCloud2 reduced;
+  ASSERT_TRUE(decimator.decimate(cloud, reduced));
+  EXPECT_EQ(cloud.header.frame_id, reduced.header.frame_id);
+  EXPECT_EQ(cloud.width, reduced.width);
+  EXPECT_TRUE(cloud.data == reduced.data);
+}
+
+TEST(CloudDecimator, ringAndAzimuthStride)
+{
+  CloudDecimator decimator;
+  decimator.configure(4, 3, 0.0);
+  EXPECT_TRUE(decimator.enabled());
+
+  // the organized layout has one row per firing
+  sensor_msgs::PointCloud2 cloud = makeXYZIR(16, 30, true);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  setValue(cloud, 3 * 16, 0, nan);        // ring 0 of the fourth firing is missing
+
+  sensor_msgs::PointCloud2 reduced;
+  ASSERT_TRUE(decimator.decimate(cloud, reduced));
+  EXPECT_EQ(1u, reduced.height);
+  EXPECT_TRUE(reduced.is_dense);
+  EXPECT_EQ(4u * 10u - 1u, reduced.width);
+  for (size_t i = 0; i < reduced.width; ++i)
+  {
+    EXPECT_EQ(0, getValue<uint16_t>(reduced, i, 16) % 4);
+    // firings 0, 3, 6, ... of each ring
+    const float time = getValue<float>(reduced, i, 18);
+    EXPECT_EQ(0, static_cast<int>(std::round(time / 5.5e-5f)) % 3);
+  }
+
+  // the counters restart with every scan
+  ASSERT_TRUE(decimator.decimate(cloud, reduced));
+  EXPECT_EQ(4u * 10u - 1u, reduced.width);
+}
+
+TEST(CloudDecimator, voxelCentroids)
+{
+  CloudDecimator decimator;
+  decimator.configure(1, 1, 1.0);
+
+  sensor_msgs::PointCloud2 cloud;
+  addField(cloud, "x", 0, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "y", 4, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "z", 8, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "intensity", 12, sensor_msgs::PointField::FLOAT32);
+  cloud.point_step = 16;
+  cloud.height = 1;
+  cloud.width = 5;
+  cloud.row_step = cloud.width * cloud.point_step;
+  cloud.data.resize(cloud.row_step);
+  const float points[5][4] = {
+    {0.2f, 0.2f, 0.2f, 10.0f},
+    {5.5f, -0.5f, 0.5f, 7.0f},
+    {0.6f, 0.8f, 0.4f, 20.0f},
+    {-0.5f, 0.5f, 0.5f, 1.0f},              // negative coordinates have their own voxel
+    {0.7f, 0.2f, 0.9f, 30.0f},
+  };
+  for (size_t i = 0; i < cloud.width; ++i)
+    for (uint32_t j = 0; j < 4; ++j)
+      setValue(cloud, i, 4 * j, points[i][j]);
+
+  sensor_msgs::PointCloud2 reduced;
+  for (int scan = 0; scan < 3; ++scan)
+  {
+    ASSERT_TRUE(decimator.decimate(cloud, reduced));
+    ASSERT_EQ(3u, reduced.width);
+    EXPECT_NEAR(0.5f, getValue<float>(reduced, 0, 0), 1e-6);
+    EXPECT_NEAR(0.4f, getValue<float>(reduced, 0, 4), 1e-6);
+    EXPECT_NEAR(0.5f, getValue<float>(reduced, 0, 8), 1e-6);
+    EXPECT_NEAR(20.0f, getValue<float>(reduced, 0, 12), 1e-6);
+    EXPECT_EQ(5.5f, getValue<float>(reduced, 1, 0));
+    EXPECT_EQ(-0.5f, getValue<float>(reduced, 2, 0));
+  }
+}
+
+TEST(CloudDecimator, missingFields)
+{
+  CloudDecimator decimator;
+  decimator.configure(2, 1, 0.0);
+
+  sensor_msgs::PointCloud2 cloud;
+  addField(cloud, "x", 0, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "y", 4, sensor_msgs::PointField::FLOAT32);
+  addField(cloud, "z", 8, sensor_msgs::PointField::FLOAT32);
+  cloud.point_step = 12;
+  cloud.height = 1;
+  cloud.width = 2;
+  cloud.row_step = 24;
+  cloud.data.resize(24);
+
+  sensor_msgs::PointCloud2 reduced;
+  EXPECT_FALSE(decimator.decimate(cloud, reduced));   // a ring stride needs rings
+  decimator.configure(1, 1, 0.1);
+  EXPECT_TRUE(decimator.decimate(cloud, reduced));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
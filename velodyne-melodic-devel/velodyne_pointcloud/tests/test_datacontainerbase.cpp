@@ -0,0 +1,230 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/pointcloudXYZIR.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using velodyne_pointcloud::PointcloudXYZIR;
+
+namespace
+{
+const double START = 1000.0;
+const double END = 1000.1;
+
+/** Cloud whose tf lookups come from a pose linear in time:
+ *  yaw of 90 degrees and 2 m along x from START to END.
+ */
+class PosedCloud : public PointcloudXYZIR
+{
+public:
+  PosedCloud() : PointcloudXYZIR(130.0, 0.4, "odom", "odom", 384), lookups(0), fail_after(-1)
+  {
+  }
+
+  virtual bool lookupTransformation(const ros::Time& time, Eigen::Quaternionf& rotation, Eigen::Vector3f& origin)
+  {
+    if (fail_after >= 0 && lookups >= fail_after)
+    {
+      return false;
+    }
+    ++lookups;
+    const float fraction = static_cast<float>((time.toSec() - START) / (END - START));
+    rotation = Eigen::Quaternionf(Eigen::AngleAxisf(fraction * M_PI / 2, Eigen::Vector3f::UnitZ()));
+    origin = Eigen::Vector3f(2.0f * fraction, 0.0f, 0.0f);
+    return true;
+  }
+
+  /// where the current transformation moves the point (1, 0, 0)
+  Eigen::Vector3f movedUnitX()
+  {
+    float x = 1.0f, y = 0.0f, z = 0.0f;
+    transformPoint(x, y, z);
+    return Eigen::Vector3f(x, y, z);
+  }
+
+  size_t cachedKnots() const
+  {
+    return transform_cache_.size();
+  }
+
+  int lookups;     ///< successful lookups
+  int fail_after;  ///< lookups that succeed before every next one fails, -1 for none
+};
+
+/// (1, 0, 0) moved by the pose at fraction of [START, END]
+Eigen::Vector3f expectedUnitX(double fraction)
+{
+  return Eigen::Vector3f(2.0 * fraction + std::cos(fraction * M_PI / 2), std::sin(fraction * M_PI / 2), 0.0);
+}
+
+velodyne_msgs::VelodyneScanPtr makeScan()
+{
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.stamp = ros::Time(START);
+  scan->header.frame_id = "velodyne";
+  scan->packets.resize(10);
+  return scan;
+}
+
+/// one scan of three returns tagged with value
+sensor_msgs::PointCloud2Ptr finishScan(PointcloudXYZIR& cloud, float value)
+{
+  cloud.setup(makeScan());
+  for (uint16_t ring = 0; ring < 3; ++ring)
+  {
+    cloud.addPoint(value, 1.0f, 2.0f, ring, 0, 10.0f, value, 0.0f);
+  }
+  return cloud.finishCloudPtr();
+}
+
+void expectNear(const Eigen::Vector3f& expected, const Eigen::Vector3f& actual)
+{
+  EXPECT_NEAR(expected.x(), actual.x(), 1e-4);
+  EXPECT_NEAR(expected.y(), actual.y(), 1e-4);
+  EXPECT_NEAR(expected.z(), actual.z(), 1e-4);
+}
+}  // namespace
+
+TEST(TransformCache, interpolateBetweenTwoPoses)
+{
+  PosedCloud cloud;
+  ASSERT_TRUE(cloud.cacheTransformations(ros::Time(START), ros::Time(END), 2));
+  EXPECT_EQ(2u, cloud.cachedKnots());
+  EXPECT_EQ(2, cloud.lookups);
+
+  // SLERP of the yaw and lerp of the origin, without another lookup
+  ASSERT_TRUE(cloud.updateTransformation(ros::Time((START + END) / 2)));
+  expectNear(expectedUnitX(0.5), cloud.movedUnitX());
+  ASSERT_TRUE(cloud.updateTransformation(ros::Time(START + 0.25 * (END - START))));
+  expectNear(expectedUnitX(0.25), cloud.movedUnitX());
+  EXPECT_EQ(2, cloud.lookups);
+
+  ASSERT_TRUE(cloud.updateTransformation(ros::Time(START)));
+  expectNear(expectedUnitX(0.0), cloud.movedUnitX());
+  ASSERT_TRUE(cloud.updateTransformation(ros::Time(END)));
+  expectNear(expectedUnitX(1.0), cloud.movedUnitX());
+}
+
+TEST(TransformCache, clampOutsideTheCachedInterval)
+{
+  PosedCloud cloud;
+  ASSERT_TRUE(cloud.cacheTransformations(ros::Time(START), ros::Time(END), 2));
+
+  ASSERT_TRUE(cloud.updateTransformation(ros::Time(END + 0.5)));
+  expectNear(expectedUnitX(1.0), cloud.movedUnitX());
+  ASSERT_TRUE(cloud.updateTransformation(ros::Time(START - 0.5)));
+  expectNear(expectedUnitX(0.0), cloud.movedUnitX());
+  EXPECT_EQ(2, cloud.lookups);
+}
+
+TEST(TransformCache, segmentsOfManyKnots)
+{
+  PosedCloud cloud;
+  ASSERT_TRUE(cloud.cacheTransformations(ros::Time(START), ros::Time(END), 5));
+  EXPECT_EQ(5u, cloud.cachedKnots());
+
+  // the pose is linear in time, so every segment reproduces it
+  for (int i = 0; i <= 20; ++i)
+  {
+    const double fraction = i / 20.0;
+    ASSERT_TRUE(cloud.updateTransformation(ros::Time(START + fraction * (END - START))));
+    expectNear(expectedUnitX(fraction), cloud.movedUnitX());
+  }
+}
+
+TEST(TransformCache, failedLookupClearsTheCache)
+{
+  PosedCloud cloud;
+  ASSERT_TRUE(cloud.cacheTransformations(ros::Time(START), ros::Time(END), 2));
+
+  // the second knot of the next scan cannot be looked up
+  cloud.lookups = 0;
+  cloud.fail_after = 1;
+  EXPECT_FALSE(cloud.cacheTransformations(ros::Time(START), ros::Time(END), 3));
+  EXPECT_EQ(0u, cloud.cachedKnots());
+
+  // without a cache every update is a lookup
+  EXPECT_FALSE(cloud.updateTransformation(ros::Time((START + END) / 2)));
+  cloud.fail_after = -1;
+  ASSERT_TRUE(cloud.updateTransformation(ros::Time((START + END) / 2)));
+  EXPECT_EQ(2, cloud.lookups);
+  expectNear(expectedUnitX(0.5), cloud.movedUnitX());
+}
+
+TEST(CloudPool, heldMessageIsNeverReused)
+{
+  PointcloudXYZIR cloud(130.0, 0.4, "velodyne", "velodyne", 384);
+  const sensor_msgs::PointCloud2Ptr held = finishScan(cloud, 1.0f);
+  const std::vector<uint8_t> published = held->data;
+
+  // more scans than the pool holds, while a subscriber keeps the first one
+  for (int i = 2; i < 8; ++i)
+  {
+    const sensor_msgs::PointCloud2Ptr msg = finishScan(cloud, static_cast<float>(i));
+    EXPECT_NE(held.get(), msg.get());
+    EXPECT_NE(held->data.data(), msg->data.data());
+  }
+  EXPECT_TRUE(published == held->data);
+}
+
+TEST(CloudPool, releasedMessageIsReused)
+{
+  PointcloudXYZIR cloud(130.0, 0.4, "velodyne", "velodyne", 384);
+  sensor_msgs::PointCloud2Ptr msg = finishScan(cloud, 1.0f);
+  const sensor_msgs::PointCloud2* pooled = msg.get();
+  const uint8_t* buffer = msg->data.data();
+  msg.reset();
+
+  // the released message is handed out again, its points go back to the container
+  msg = finishScan(cloud, 2.0f);
+  EXPECT_EQ(pooled, msg.get());
+  float x;
+  memcpy(&x, msg->data.data(), sizeof(x));
+  EXPECT_EQ(2.0f, x);
+
+  // and the next scan is unpacked into the old buffer, without reallocating
+  cloud.setup(makeScan());
+  EXPECT_EQ(buffer, cloud.cloud.data.data());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}
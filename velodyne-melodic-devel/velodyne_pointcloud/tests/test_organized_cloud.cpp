@@ -0,0 +1,238 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/organized_cloudXYZIR.h>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using velodyne_pointcloud::OrganizedCloudXYZIR;
+
+namespace
+{
+const double MAX_RANGE = 130.0;
+const double MIN_RANGE = 0.4;
+const unsigned int NUM_LASERS = 4;
+const unsigned int AZIMUTH_BINS = 8;  ///< 45 degrees each
+
+velodyne_msgs::VelodyneScanPtr makeScan(size_t npackets)
+{
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.stamp = ros::Time(1000.0);
+  scan->header.frame_id = "velodyne";
+  scan->packets.resize(npackets);
+  return scan;
+}
+
+class BinnedCloud : public OrganizedCloudXYZIR
+{
+public:
+  BinnedCloud()
+    : OrganizedCloudXYZIR(MAX_RANGE, MIN_RANGE, "velodyne", "velodyne", NUM_LASERS, 12,
+                          boost::shared_ptr<tf::TransformListener>(), AZIMUTH_BINS)
+  {
+  }
+
+  /// a valid return at 10 m, tagged with value in x and intensity
+  void addValid(uint16_t ring, uint16_t azimuth, float value)
+  {
+    addPoint(value, 1.0f, 2.0f, ring, azimuth, 10.0f, value, value / 100);
+  }
+
+  /// a missing return, as unpack() reports it
+  void addMissing(uint16_t ring, uint16_t azimuth)
+  {
+    const float nan = nanf("");
+    addPoint(nan, nan, nan, ring, azimuth, nan, nan, 0.5f);
+  }
+
+  /// a return closer than min_range
+  void addTooClose(uint16_t ring, uint16_t azimuth)
+  {
+    addPoint(0.1f, 0.1f, 0.1f, ring, azimuth, 0.2f, 50.0f, 0.5f);
+  }
+
+  template <typename T>
+  T value(unsigned int ring, unsigned int bin, const std::string& field) const
+  {
+    for (size_t i = 0; i < cloud.fields.size(); ++i)
+    {
+      if (cloud.fields[i].name == field)
+      {
+        T result;
+        memcpy(&result, &cloud.data[ring * cloud.row_step + bin * cloud.point_step + cloud.fields[i].offset],
+               sizeof(T));
+        return result;
+      }
+    }
+    ADD_FAILURE() << "no field " << field;
+    return T();
+  }
+
+  float x(unsigned int ring, unsigned int bin) const
+  {
+    return value<float>(ring, bin, "x");
+  }
+};
+}  // namespace
+
+TEST(OrganizedCloudBinned, fixedDimensions)
+{
+  BinnedCloud cloud;
+  for (size_t npackets = 1; npackets < 200; npackets *= 10)
+  {
+    cloud.setup(makeScan(npackets));
+    cloud.addValid(1, 100, 5.0f);
+    const sensor_msgs::PointCloud2& msg = cloud.finishCloud();
+    EXPECT_EQ(AZIMUTH_BINS, msg.width);
+    EXPECT_EQ(NUM_LASERS, msg.height);
+    EXPECT_EQ(msg.width * msg.point_step, msg.row_step);
+    EXPECT_EQ(msg.row_step * msg.height, msg.data.size());
+    EXPECT_FALSE(msg.is_dense);
+  }
+
+  // every other cell is NaN and knows its ring
+  for (unsigned int ring = 0; ring < NUM_LASERS; ++ring)
+  {
+    for (unsigned int bin = 0; bin < AZIMUTH_BINS; ++bin)
+    {
+      EXPECT_EQ(ring, cloud.value<uint16_t>(ring, bin, "ring"));
+      if (ring != 1 || bin != 0)
+      {
+        EXPECT_TRUE(std::isnan(cloud.x(ring, bin)));
+        EXPECT_TRUE(std::isnan(cloud.value<float>(ring, bin, "intensity")));
+      }
+    }
+  }
+}
+
+TEST(OrganizedCloudBinned, binPlacement)
+{
+  BinnedCloud cloud;
+  cloud.setup(makeScan(10));
+  cloud.addValid(0, 0, 1.0f);
+  cloud.addValid(0, 4499, 2.0f);
+  cloud.addValid(2, 4500, 3.0f);
+  cloud.addValid(3, 35999, 4.0f);
+  cloud.addValid(3, 18000, 5.0f);
+  cloud.finishCloud();
+
+  EXPECT_EQ(2.0f, cloud.x(0, 0));  // same bin as azimuth 0, later wins
+  EXPECT_EQ(3.0f, cloud.x(2, 1));
+  EXPECT_EQ(4.0f, cloud.x(3, AZIMUTH_BINS - 1));
+  EXPECT_EQ(5.0f, cloud.x(3, 4));
+  EXPECT_EQ(5.0f, cloud.value<float>(3, 4, "intensity"));
+  EXPECT_EQ(1.0f, cloud.value<float>(3, 4, "y"));
+  EXPECT_EQ(2.0f, cloud.value<float>(3, 4, "z"));
+  EXPECT_FLOAT_EQ(0.05f, cloud.value<float>(3, 4, "time"));
+  EXPECT_TRUE(std::isnan(cloud.x(1, 1)));
+  EXPECT_TRUE(std::isnan(cloud.x(2, 0)));
+}
+
+TEST(OrganizedCloudBinned, invalidKeepsValid)
+{
+  BinnedCloud cloud;
+  cloud.setup(makeScan(10));
+
+  // a dual return or another firing in the same bin must not erase a valid point
+  cloud.addValid(0, 1000, 1.0f);
+  cloud.addMissing(0, 1100);
+  cloud.addTooClose(0, 1200);
+  cloud.addMissing(1, 1000);
+  cloud.addValid(1, 1100, 2.0f);
+  cloud.addMissing(1, 1200);
+  cloud.addMissing(2, 1000);
+  cloud.addTooClose(2, 1100);
+  cloud.finishCloud();
+
+  EXPECT_EQ(1.0f, cloud.x(0, 0));
+  EXPECT_EQ(1.0f, cloud.value<float>(0, 0, "intensity"));
+  EXPECT_EQ(2.0f, cloud.x(1, 0));
+  EXPECT_TRUE(std::isnan(cloud.x(2, 0)));
+  EXPECT_TRUE(std::isnan(cloud.value<float>(2, 0, "intensity")));
+  EXPECT_EQ(2u, cloud.value<uint16_t>(2, 0, "ring"));
+}
+
+TEST(OrganizedCloudBinned, appendMatchesSerial)
+{
+  BinnedCloud first, second, serial;
+  first.setup(makeScan(10));
+  second.setup(makeScan(10));
+  serial.setup(makeScan(10));
+
+  // the first half of a scan
+  first.addValid(0, 0, 1.0f);
+  first.addValid(1, 0, 2.0f);
+  first.addMissing(2, 0);
+  first.addValid(3, 9000, 3.0f);
+  // the second half
+  second.addMissing(0, 0);
+  second.addValid(1, 0, 4.0f);
+  second.addValid(2, 0, 5.0f);
+  second.addTooClose(3, 27000);
+
+  serial.addValid(0, 0, 1.0f);
+  serial.addValid(1, 0, 2.0f);
+  serial.addMissing(2, 0);
+  serial.addValid(3, 9000, 3.0f);
+  serial.addMissing(0, 0);
+  serial.addValid(1, 0, 4.0f);
+  serial.addValid(2, 0, 5.0f);
+  serial.addTooClose(3, 27000);
+
+  first.append(second);
+  const sensor_msgs::PointCloud2& merged = first.finishCloud();
+  const sensor_msgs::PointCloud2& expected = serial.finishCloud();
+
+  EXPECT_EQ(1.0f, first.x(0, 0));  // not replaced by the later missing return
+  EXPECT_EQ(4.0f, first.x(1, 0));
+  EXPECT_EQ(5.0f, first.x(2, 0));
+  EXPECT_EQ(3.0f, first.x(3, 2));
+  EXPECT_TRUE(std::isnan(first.x(3, 6)));
+  EXPECT_FLOAT_EQ(0.5f, first.value<float>(3, 6, "time"));
+  EXPECT_TRUE(std::isnan(first.x(1, 1)));
+
+  EXPECT_EQ(expected.width, merged.width);
+  EXPECT_EQ(expected.height, merged.height);
+  EXPECT_TRUE(expected.data == merged.data);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}
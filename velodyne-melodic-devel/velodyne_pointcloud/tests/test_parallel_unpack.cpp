@@ -0,0 +1,202 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/calibration.h>
+#include <velodyne_pointcloud/organized_cloudXYZIR.h>
+#include <velodyne_pointcloud/parallel_unpack.h>
+#include <velodyne_pointcloud/pointcloudXYZIR.h>
+#include <velodyne_pointcloud/rawdata.h>
+
+#include <boost/bind.hpp>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using velodyne_pointcloud::OrganizedCloudXYZIR;
+using velodyne_pointcloud::ParallelUnpacker;
+using velodyne_pointcloud::PointcloudXYZIR;
+using velodyne_rawdata::DataContainerBase;
+using velodyne_rawdata::RawData;
+
+namespace
+{
+const double MAX_RANGE = 130.0;
+const double MIN_RANGE = 0.4;
+
+enum Layout
+{
+  FLAT,
+  ORGANIZED,
+  BINNED
+};
+
+boost::shared_ptr<DataContainerBase> makeContainer(Layout layout, unsigned int num_lasers,
+                                                   unsigned int scans_per_packet)
+{
+  if (layout == FLAT)
+  {
+    return boost::shared_ptr<DataContainerBase>(
+        new PointcloudXYZIR(MAX_RANGE, MIN_RANGE, "velodyne", "velodyne", scans_per_packet));
+  }
+  return boost::shared_ptr<DataContainerBase>(
+      new OrganizedCloudXYZIR(MAX_RANGE, MIN_RANGE, "velodyne", "velodyne", num_lasers, scans_per_packet,
+                              boost::shared_ptr<tf::TransformListener>(), layout == BINNED ? 1800 : 0));
+}
+
+/// one revolution of packets with smooth ranges, some misses and some returns out of range
+velodyne_msgs::VelodyneScanPtr makeScan(const unsigned int num_lasers)
+{
+  using namespace velodyne_rawdata;
+
+  const bool hdl64 = num_lasers == 64;
+  const unsigned int npackets = num_lasers == 16 ? 76 : (hdl64 ? 348 : 181);
+  const unsigned int blocks_per_rotation = hdl64 ? BLOCKS_PER_PACKET / 2 : BLOCKS_PER_PACKET;
+  const unsigned int step = 36000 / (npackets * blocks_per_rotation);
+
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.stamp = ros::Time(1000.0);
+  scan->packets.resize(npackets);
+  unsigned int rotation = 0;
+  unsigned int noise = 54321;
+  for (unsigned int p = 0; p < npackets; ++p)
+  {
+    velodyne_msgs::VelodynePacket& packet = scan->packets[p];
+    packet.stamp = ros::Time(1000.0 + p * 0.1 / npackets);
+    raw_packet_t* raw = reinterpret_cast<raw_packet_t*>(&packet.data[0]);
+    for (int b = 0; b < BLOCKS_PER_PACKET; ++b)
+    {
+      const bool lower = hdl64 && (b % 2) == 1;
+      raw->blocks[b].header = lower ? LOWER_BANK : UPPER_BANK;
+      raw->blocks[b].rotation = rotation;
+      for (int k = 0; k < SCANS_PER_BLOCK; ++k)
+      {
+        noise = noise * 1103515245 + 12345;
+        int distance = static_cast<int>(5000 + 3000 * std::sin(rotation * 0.0005 + k * 0.4));
+        if ((noise >> 8) % 16 == 0)
+          distance = 0;                           // no return
+        else if ((noise >> 8) % 16 == 1)
+          distance = 50;                          // closer than MIN_RANGE
+        uint8_t* data = &raw->blocks[b].data[k * RAW_SCAN_SIZE];
+        data[0] = distance & 0xff;
+        data[1] = (distance >> 8) & 0xff;
+        data[2] = static_cast<uint8_t>(20 + (noise >> 20) % 80);
+      }
+      if (!hdl64 || lower)
+        rotation = (rotation + step) % 36000;
+    }
+  }
+  return scan;
+}
+
+/// the cloud of a ParallelUnpacker against unpacking the packets one after another
+void compareSerial(const std::string& calibration, Layout layout, unsigned int num_threads,
+                   double view_direction = 0.0, double view_width = 2 * M_PI)
+{
+  const std::string path = std::string(VELODYNE_POINTCLOUD_PARAMS_DIR) + "/" + calibration;
+  boost::shared_ptr<RawData> raw(new RawData);
+  ASSERT_EQ(0, raw->setupOffline(path, MAX_RANGE, MIN_RANGE));
+  raw->setParameters(MIN_RANGE, MAX_RANGE, view_direction, view_width);
+  const unsigned int num_lasers = velodyne_pointcloud::Calibration(path, false).num_lasers;
+  velodyne_msgs::VelodyneScanPtr scan = makeScan(num_lasers);
+
+  boost::shared_ptr<DataContainerBase> serial = makeContainer(layout, num_lasers, raw->scansPerPacket());
+  serial->setup(scan);
+  for (size_t i = 0; i < scan->packets.size(); ++i)
+    raw->unpack(scan->packets[i], *serial, scan->header.stamp);
+  const sensor_msgs::PointCloud2& expected = serial->finishCloud();
+
+  ParallelUnpacker unpacker(raw, num_threads, false);
+  unpacker.resetContainers(boost::bind(&makeContainer, layout, num_lasers, raw->scansPerPacket()));
+  boost::shared_ptr<DataContainerBase> parallel = makeContainer(layout, num_lasers, raw->scansPerPacket());
+
+  // twice, so that clouds left by the first scan cannot leak into the second
+  for (int run = 0; run < 2; ++run)
+  {
+    parallel->setup(scan);
+    unpacker.unpack(scan, *parallel);
+    const sensor_msgs::PointCloud2& cloud = parallel->finishCloud();
+
+    ASSERT_EQ(expected.width, cloud.width) << calibration << " " << num_threads << " threads";
+    ASSERT_EQ(expected.height, cloud.height) << calibration << " " << num_threads << " threads";
+    EXPECT_EQ(expected.row_step, cloud.row_step);
+    EXPECT_EQ(expected.point_step, cloud.point_step);
+    EXPECT_EQ(expected.is_dense, cloud.is_dense);
+    ASSERT_EQ(expected.data.size(), cloud.data.size());
+    EXPECT_TRUE(expected.data == cloud.data) << calibration << " " << num_threads << " threads";
+  }
+  EXPECT_GT(expected.data.size(), 0u);
+}
+
+void compareAllThreads(const std::string& calibration, Layout layout)
+{
+  for (unsigned int num_threads = 1; num_threads <= 4; ++num_threads)
+    compareSerial(calibration, layout, num_threads);
+}
+}  // namespace
+
+TEST(ParallelUnpack, flat)
+{
+  compareAllThreads("VLP16db.yaml", FLAT);
+  compareAllThreads("32db.yaml", FLAT);
+  compareAllThreads("64e_s2.1-sztaki.yaml", FLAT);
+}
+
+TEST(ParallelUnpack, organized)
+{
+  compareAllThreads("VLP16db.yaml", ORGANIZED);
+  compareAllThreads("32db.yaml", ORGANIZED);
+  compareAllThreads("64e_s2.1-sztaki.yaml", ORGANIZED);
+}
+
+TEST(ParallelUnpack, binned)
+{
+  compareAllThreads("VLP16db.yaml", BINNED);
+  compareAllThreads("32db.yaml", BINNED);
+  compareAllThreads("64e_s2.1-sztaki.yaml", BINNED);
+}
+
+TEST(ParallelUnpack, partialView)
+{
+  compareSerial("VLP16db.yaml", FLAT, 3, 1.0, 2.0);
+  compareSerial("VLP16db.yaml", ORGANIZED, 3, 1.0, 2.0);
+  compareSerial("64e_s2.1-sztaki.yaml", BINNED, 3, -2.5, 1.0);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,234 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/calibration.h>
+#include <velodyne_pointcloud/range_image.h>
+#include <velodyne_pointcloud/rawdata.h>
+
+#include <cstring>
+#include <string>
+
+using velodyne_pointcloud::Calibration;
+using velodyne_pointcloud::RangeImage;
+using velodyne_rawdata::RawData;
+
+namespace
+{
+const double MAX_RANGE = 130.0;
+const double MIN_RANGE = 0.4;
+const unsigned int COLUMNS = 360;  ///< one degree each
+
+std::string calibrationPath(const std::string& name)
+{
+  return std::string(VELODYNE_POINTCLOUD_PARAMS_DIR) + "/" + name;
+}
+
+uint16_t pixel(const RangeImage& image, unsigned int ring, unsigned int column)
+{
+  const sensor_msgs::Image& range = *image.rangeImage();
+  uint16_t value;
+  memcpy(&value, &range.data[ring * range.step + column * sizeof(uint16_t)], sizeof(value));
+  return value;
+}
+
+void setReturn(velodyne_rawdata::raw_block_t& block, int scan, uint16_t distance, uint8_t intensity)
+{
+  uint8_t* data = &block.data[scan * velodyne_rawdata::RAW_SCAN_SIZE];
+  data[0] = distance & 0xff;
+  data[1] = (distance >> 8) & 0xff;
+  data[2] = intensity;
+}
+
+/// raw distance of every return of the packets, unique within a scan
+uint16_t rawDistance(unsigned int block, unsigned int scan)
+{
+  return static_cast<uint16_t>(1000 + block * velodyne_rawdata::SCANS_PER_BLOCK + scan);
+}
+
+/// raw intensity of every return, below and above the intensity limits of the calibration
+uint8_t rawIntensity(unsigned int block, unsigned int scan)
+{
+  return static_cast<uint8_t>(block * velodyne_rawdata::SCANS_PER_BLOCK + scan);
+}
+
+uint8_t intensityPixel(const RangeImage& image, unsigned int ring, unsigned int column)
+{
+  const sensor_msgs::Image& intensity = *image.intensityImage();
+  return intensity.data[ring * intensity.step + column];
+}
+}  // namespace
+
+TEST(RangeImage, hdl64RawDistances)
+{
+  using namespace velodyne_rawdata;
+
+  const Calibration calibration(calibrationPath("64e_s2.1-sztaki.yaml"), false);
+  RawData raw;
+  ASSERT_EQ(0, raw.setupOffline(calibrationPath("64e_s2.1-sztaki.yaml"), MAX_RANGE, MIN_RANGE));
+  raw.setParameters(MIN_RANGE, MAX_RANGE, 0.0, 2 * M_PI);
+
+  // upper and lower block of a pair share the rotation, half a degree into column 3 * pair + 1
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.stamp = ros::Time(1000.0);
+  scan->packets.resize(1);
+  raw_packet_t* packet = reinterpret_cast<raw_packet_t*>(&scan->packets[0].data[0]);
+  for (int b = 0; b < BLOCKS_PER_PACKET; ++b)
+  {
+    packet->blocks[b].header = (b % 2) ? LOWER_BANK : UPPER_BANK;
+    packet->blocks[b].rotation = (b / 2) * 300 + 150;
+    for (int k = 0; k < SCANS_PER_BLOCK; ++k)
+      setReturn(packet->blocks[b], k, rawDistance(b, k), rawIntensity(b, k));
+  }
+
+  // corrected intensities, as the point cloud has them
+  RangeImage corrected(MAX_RANGE, MIN_RANGE, calibration, COLUMNS, raw.scansPerPacket(), true);
+  corrected.setup(scan);
+  raw.unpack(scan->packets[0], corrected, scan->header.stamp);
+
+  raw.setRawIntensity(true);
+  RangeImage image(MAX_RANGE, MIN_RANGE, calibration, COLUMNS, raw.scansPerPacket(), true);
+  image.setup(scan);
+  raw.unpack(scan->packets[0], image, scan->header.stamp);
+
+  const sensor_msgs::Image& range = *image.rangeImage();
+  ASSERT_EQ(64u, range.height);
+  ASSERT_EQ(COLUMNS, range.width);
+  ASSERT_EQ(COLUMNS * sizeof(uint16_t), range.step);
+
+  size_t filled = 0, differing = 0;
+  for (int b = 0; b < BLOCKS_PER_PACKET; ++b)
+  {
+    for (int k = 0; k < SCANS_PER_BLOCK; ++k)
+    {
+      const int laser = k + ((b % 2) ? SCANS_PER_BLOCK : 0);
+      const int ring = calibration.laser_corrections[laser].laser_ring;
+      // the dist_correction of the laser is not part of the pixel
+      EXPECT_EQ(rawDistance(b, k), pixel(image, ring, 3 * (b / 2) + 1)) << "laser " << laser;
+      // nor its intensity correction
+      EXPECT_EQ(rawIntensity(b, k), intensityPixel(image, ring, 3 * (b / 2) + 1)) << "laser " << laser;
+      differing += intensityPixel(corrected, ring, 3 * (b / 2) + 1) != rawIntensity(b, k);
+    }
+  }
+  EXPECT_GT(differing, 0u);  // the calibration corrects intensities
+  for (unsigned int ring = 0; ring < range.height; ++ring)
+  {
+    for (unsigned int column = 0; column < range.width; ++column)
+      filled += pixel(image, ring, column) != 0;
+  }
+  EXPECT_EQ(static_cast<size_t>(BLOCKS_PER_PACKET * SCANS_PER_BLOCK), filled);
+}
+
+TEST(RangeImage, vlp16ColumnsOfFirings)
+{
+  using namespace velodyne_rawdata;
+
+  const Calibration calibration(calibrationPath("VLP16db.yaml"), false);
+  RawData raw;
+  ASSERT_EQ(0, raw.setupOffline(calibrationPath("VLP16db.yaml"), MAX_RANGE, MIN_RANGE));
+  raw.setParameters(MIN_RANGE, MAX_RANGE, 0.0, 2 * M_PI);
+
+  // blocks two degrees apart, the second firing of a block lands one column later
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.stamp = ros::Time(1000.0);
+  scan->packets.resize(1);
+  raw_packet_t* packet = reinterpret_cast<raw_packet_t*>(&scan->packets[0].data[0]);
+  for (int b = 0; b < BLOCKS_PER_PACKET; ++b)
+  {
+    packet->blocks[b].header = UPPER_BANK;
+    packet->blocks[b].rotation = 1000 + b * 200;
+    for (int k = 0; k < SCANS_PER_BLOCK; ++k)
+      setReturn(packet->blocks[b], k, rawDistance(b, k), 100);
+  }
+
+  RangeImage image(MAX_RANGE, MIN_RANGE, calibration, COLUMNS, raw.scansPerPacket(), false);
+  image.setup(scan);
+  raw.unpack(scan->packets[0], image, scan->header.stamp);
+  EXPECT_FALSE(image.intensityImage());
+
+  for (int b = 0; b < BLOCKS_PER_PACKET; ++b)
+  {
+    for (int firing = 0; firing < VLP16_FIRINGS_PER_BLOCK; ++firing)
+    {
+      for (int dsr = 0; dsr < VLP16_SCANS_PER_FIRING; ++dsr)
+      {
+        const int ring = calibration.laser_corrections[dsr].laser_ring;
+        const int column = 10 + 2 * b + firing;
+        EXPECT_EQ(rawDistance(b, firing * VLP16_SCANS_PER_FIRING + dsr), pixel(image, ring, column))
+            << "block " << b << " firing " << firing << " laser " << dsr;
+      }
+    }
+  }
+  EXPECT_EQ(0, pixel(image, 0, 9));
+  EXPECT_EQ(0, pixel(image, 0, 10 + 2 * BLOCKS_PER_PACKET));
+}
+
+TEST(RangeImage, pixelEncoding)
+{
+  const Calibration calibration(calibrationPath("64e_s2.1-sztaki.yaml"), false);
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->packets.resize(1);
+
+  RangeImage image(MAX_RANGE, MIN_RANGE, calibration, COLUMNS, 384, true);
+  image.setup(scan);
+
+  const int laser = 5;
+  const uint16_t ring = calibration.laser_corrections[laser].laser_ring;
+  const float dist_correction = calibration.laser_corrections[laser].dist_correction;
+  const float resolution = calibration.distance_resolution_m;
+  const float nan = nanf("");
+
+  // as RawData reports them: raw distance times resolution plus dist_correction
+  image.addPoint(1, 2, 3, ring, 0, 60000 * resolution + dist_correction, 17.4f, 0);
+  image.addPoint(1, 2, 3, ring, 100, 1 * resolution + dist_correction + MIN_RANGE, 300.0f, 0);
+  image.addPoint(1, 2, 3, ring, 35999, 0.5f * MIN_RANGE, 50.0f, 0);
+  image.addPoint(nan, nan, nan, ring, 200, nan, nan, 0);
+
+  EXPECT_EQ(60000, pixel(image, ring, 0));
+  EXPECT_EQ(static_cast<uint16_t>(1 + MIN_RANGE / resolution + 0.5f), pixel(image, ring, 1));
+  EXPECT_EQ(0, pixel(image, ring, COLUMNS - 1));  // closer than min_range
+  EXPECT_EQ(0, pixel(image, ring, 2));            // no return
+
+  const sensor_msgs::Image& intensity = *image.intensityImage();
+  EXPECT_EQ(17, intensity.data[ring * intensity.step]);
+  EXPECT_EQ(255, intensity.data[ring * intensity.step + 1]);
+  EXPECT_EQ(0, intensity.data[ring * intensity.step + COLUMNS - 1]);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}
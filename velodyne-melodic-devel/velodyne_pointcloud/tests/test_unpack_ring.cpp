@@ -0,0 +1,204 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/datacontainerbase.h>
+#include <velodyne_pointcloud/rawdata.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using velodyne_rawdata::RawData;
+using velodyne_rawdata::ring_return_t;
+
+namespace
+{
+const double MAX_RANGE = 130.0;
+const double MIN_RANGE = 0.4;
+
+/// keeps the valid returns of unpack() with the bearing and range of velodyne_laserscan
+class RingRecorder : public velodyne_rawdata::DataContainerBase
+{
+public:
+  RingRecorder()
+    : DataContainerBase(MAX_RANGE, MIN_RANGE, "", "", 0, 1, true, 0, no_tf_, 0)
+    , returns(64)
+  {
+  }
+
+  virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth,
+                        const float distance, const float intensity, const float time)
+  {
+    if (!std::isnan(x) && pointInRange(distance) && ring < returns.size())
+    {
+      ring_return_t ret;
+      ret.angle = atan2f(y, x);
+      ret.range = sqrtf(x * x + y * y);
+      ret.intensity = intensity;
+      returns[ring].push_back(ret);
+    }
+  }
+
+  virtual void newLine()
+  {
+  }
+
+  std::vector<std::vector<ring_return_t> > returns;
+
+private:
+  static boost::shared_ptr<tf::TransformListener> no_tf_;
+};
+boost::shared_ptr<tf::TransformListener> RingRecorder::no_tf_;
+
+/// one revolution of packets with smooth ranges and some misses
+velodyne_msgs::VelodyneScanPtr makeScan(const unsigned int num_lasers)
+{
+  using namespace velodyne_rawdata;
+
+  const bool hdl64 = num_lasers == 64;
+  const unsigned int npackets = num_lasers == 16 ? 76 : (hdl64 ? 348 : 181);
+  const unsigned int blocks_per_rotation = hdl64 ? BLOCKS_PER_PACKET / 2 : BLOCKS_PER_PACKET;
+  const unsigned int step = 36000 / (npackets * blocks_per_rotation);
+
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.stamp = ros::Time(1000.0);
+  scan->packets.resize(npackets);
+  unsigned int rotation = 0;
+  unsigned int noise = 12345;
+  for (unsigned int p = 0; p < npackets; ++p)
+  {
+    velodyne_msgs::VelodynePacket& packet = scan->packets[p];
+    packet.stamp = ros::Time(1000.0 + p * 0.1 / npackets);
+    raw_packet_t* raw = reinterpret_cast<raw_packet_t*>(&packet.data[0]);
+    for (int b = 0; b < BLOCKS_PER_PACKET; ++b)
+    {
+      const bool lower = hdl64 && (b % 2) == 1;
+      raw->blocks[b].header = lower ? LOWER_BANK : UPPER_BANK;
+      raw->blocks[b].rotation = rotation;
+      for (int k = 0; k < SCANS_PER_BLOCK; ++k)
+      {
+        noise = noise * 1103515245 + 12345;
+        int distance = static_cast<int>(5000 + 3000 * std::sin(rotation * 0.0005 + k * 0.4));
+        if ((noise >> 8) % 16 == 0)
+          distance = 0;                           // no return
+        uint8_t* data = &raw->blocks[b].data[k * RAW_SCAN_SIZE];
+        data[0] = distance & 0xff;
+        data[1] = (distance >> 8) & 0xff;
+        data[2] = static_cast<uint8_t>(20 + (noise >> 20) % 80);
+      }
+      if (!hdl64 || lower)
+        rotation = (rotation + step) % 36000;
+    }
+  }
+  return scan;
+}
+
+/// unpackRing() of every ring against the points of unpack()
+void compareRings(const std::string& calibration, double view_direction, double view_width)
+{
+  RawData raw;
+  ASSERT_EQ(0, raw.setupOffline(std::string(VELODYNE_POINTCLOUD_PARAMS_DIR) + "/" + calibration,
+                                MAX_RANGE, MIN_RANGE));
+  raw.setParameters(MIN_RANGE, MAX_RANGE, view_direction, view_width);
+  const unsigned int num_lasers = velodyne_pointcloud::Calibration(
+      std::string(VELODYNE_POINTCLOUD_PARAMS_DIR) + "/" + calibration, false).num_lasers;
+  velodyne_msgs::VelodyneScanPtr scan = makeScan(num_lasers);
+
+  RingRecorder recorder;
+  for (size_t i = 0; i < scan->packets.size(); ++i)
+    raw.unpack(scan->packets[i], recorder, scan->header.stamp);
+
+  size_t total = 0;
+  for (unsigned int ring = 0; ring < num_lasers; ++ring)
+  {
+    std::vector<ring_return_t> returns;
+    for (size_t i = 0; i < scan->packets.size(); ++i)
+      raw.unpackRing(scan->packets[i], ring, returns);
+
+    const std::vector<ring_return_t>& expected = recorder.returns[ring];
+    ASSERT_EQ(expected.size(), returns.size()) << calibration << " ring " << ring;
+    for (size_t i = 0; i < returns.size(); ++i)
+    {
+      const float angle_error = std::fabs(std::remainder(expected[i].angle - returns[i].angle, 2 * M_PI));
+      EXPECT_LT(angle_error, 1e-5) << calibration << " ring " << ring;
+      EXPECT_NEAR(expected[i].range, returns[i].range, 1e-4) << calibration << " ring " << ring;
+      EXPECT_EQ(expected[i].intensity, returns[i].intensity) << calibration << " ring " << ring;
+      EXPECT_GE(returns[i].angle, -M_PI);
+      EXPECT_LT(returns[i].angle, M_PI);
+    }
+    total += returns.size();
+  }
+  EXPECT_GT(total, 0u);
+}
+}  // namespace
+
+TEST(UnpackRing, vlp16)
+{
+  compareRings("VLP16db.yaml", 0.0, 2 * M_PI);
+}
+
+TEST(UnpackRing, hdl32)
+{
+  compareRings("32db.yaml", 0.0, 2 * M_PI);
+}
+
+TEST(UnpackRing, hdl64)
+{
+  compareRings("64e_s2.1-sztaki.yaml", 0.0, 2 * M_PI);
+}
+
+TEST(UnpackRing, partialView)
+{
+  compareRings("VLP16db.yaml", 1.0, 2.0);
+  compareRings("64e_s2.1-sztaki.yaml", -2.5, 1.0);
+}
+
+TEST(UnpackRing, unknownRing)
+{
+  RawData raw;
+  ASSERT_EQ(0, raw.setupOffline(std::string(VELODYNE_POINTCLOUD_PARAMS_DIR) + "/VLP16db.yaml",
+                                MAX_RANGE, MIN_RANGE));
+  velodyne_msgs::VelodyneScanPtr scan = makeScan(16);
+  std::vector<ring_return_t> returns;
+  raw.unpackRing(scan->packets[0], 16, returns);
+  EXPECT_TRUE(returns.empty());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,174 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include <velodyne_driver/view_culling.h>
+#include <velodyne_pointcloud/pointcloudXYZIR.h>
+#include <velodyne_pointcloud/rawdata.h>
+
+#include <cmath>
+#include <string>
+
+using velodyne_pointcloud::PointcloudXYZIR;
+using velodyne_rawdata::RawData;
+
+namespace
+{
+const double MAX_RANGE = 130.0;
+const double MIN_RANGE = 0.4;
+
+std::string calibrationPath(const std::string& name)
+{
+  return std::string(VELODYNE_POINTCLOUD_PARAMS_DIR) + "/" + name;
+}
+
+/// one revolution of packets with smooth ranges, starting at start in 1/100°
+velodyne_msgs::VelodyneScanPtr makeCapture(const unsigned int num_lasers, unsigned int start)
+{
+  using namespace velodyne_rawdata;
+
+  const bool hdl64 = num_lasers == 64;
+  const unsigned int npackets = num_lasers == 16 ? 76 : (hdl64 ? 348 : 181);
+  const unsigned int blocks_per_rotation = hdl64 ? BLOCKS_PER_PACKET / 2 : BLOCKS_PER_PACKET;
+  const unsigned int step = 36000 / (npackets * blocks_per_rotation);
+
+  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.stamp = ros::Time(1000.0);
+  scan->packets.resize(npackets);
+  unsigned int rotation = start;
+  for (unsigned int p = 0; p < npackets; ++p)
+  {
+    velodyne_msgs::VelodynePacket& packet = scan->packets[p];
+    packet.stamp = ros::Time(1000.0 + p * 0.1 / npackets);
+    raw_packet_t* raw = reinterpret_cast<raw_packet_t*>(&packet.data[0]);
+    for (int b = 0; b < BLOCKS_PER_PACKET; ++b)
+    {
+      const bool lower = hdl64 && (b % 2) == 1;
+      raw->blocks[b].header = lower ? LOWER_BANK : UPPER_BANK;
+      raw->blocks[b].rotation = rotation;
+      for (int k = 0; k < SCANS_PER_BLOCK; ++k)
+      {
+        const int distance = static_cast<int>(5000 + 3000 * std::sin(rotation * 0.0005 + k * 0.4));
+        uint8_t* data = &raw->blocks[b].data[k * RAW_SCAN_SIZE];
+        data[0] = distance & 0xff;
+        data[1] = (distance >> 8) & 0xff;
+        data[2] = 50;
+      }
+      if (!hdl64 || lower)
+        rotation = (rotation + step) % 36000;
+    }
+  }
+  return scan;
+}
+
+/// unpacks the capture with and without the packets culled by the driver, for a view in radians
+void compareCulled(const std::string& calibration, unsigned int num_lasers,
+                   double view_direction, double view_width)
+{
+  RawData raw;
+  ASSERT_EQ(0, raw.setupOffline(calibrationPath(calibration), MAX_RANGE, MIN_RANGE));
+  raw.setParameters(MIN_RANGE, MAX_RANGE, view_direction, view_width);
+
+  int view_min_angle, view_max_angle;
+  ASSERT_TRUE(velodyne_driver::packetView(view_direction, view_width, &view_min_angle, &view_max_angle));
+
+  // starting off the block grid, so that the edges of the view fall inside packets
+  const velodyne_msgs::VelodyneScanPtr scan = makeCapture(num_lasers, 7);
+  velodyne_msgs::VelodyneScanPtr culled(new velodyne_msgs::VelodyneScan);
+  culled->header = scan->header;
+  for (size_t i = 0; i < scan->packets.size(); ++i)
+  {
+    if (velodyne_driver::packetInView(scan->packets[i], view_min_angle, view_max_angle))
+      culled->packets.push_back(scan->packets[i]);
+  }
+
+  PointcloudXYZIR all(MAX_RANGE, MIN_RANGE, "velodyne", "velodyne", raw.scansPerPacket());
+  all.setup(scan);
+  for (size_t i = 0; i < scan->packets.size(); ++i)
+    raw.unpack(scan->packets[i], all, scan->header.stamp);
+  const sensor_msgs::PointCloud2& expected = all.finishCloud();
+
+  PointcloudXYZIR kept(MAX_RANGE, MIN_RANGE, "velodyne", "velodyne", raw.scansPerPacket());
+  kept.setup(culled);
+  for (size_t i = 0; i < culled->packets.size(); ++i)
+    raw.unpack(culled->packets[i], kept, culled->header.stamp);
+  const sensor_msgs::PointCloud2& cloud = kept.finishCloud();
+
+  const std::string view = calibration + " view " + std::to_string(view_direction) + " "
+      + std::to_string(view_width);
+  EXPECT_GT(expected.width, 0u) << view;
+  EXPECT_LT(culled->packets.size(), scan->packets.size()) << view;
+  ASSERT_EQ(expected.width, cloud.width) << view;
+  ASSERT_EQ(expected.data.size(), cloud.data.size()) << view;
+  EXPECT_TRUE(expected.data == cloud.data) << view;
+}
+
+void compareViews(const std::string& calibration, unsigned int num_lasers)
+{
+  compareCulled(calibration, num_lasers, 0.0, 1.0);        // across rotation 0
+  compareCulled(calibration, num_lasers, M_PI, 1.0);
+  compareCulled(calibration, num_lasers, 2.0, 0.01);       // within a single packet
+  compareCulled(calibration, num_lasers, -2.5, 3.0);
+  compareCulled(calibration, num_lasers, 1.0, 6.0);
+}
+}  // namespace
+
+TEST(ViewCulling, vlp16)
+{
+  compareViews("VLP16db.yaml", 16);
+}
+
+TEST(ViewCulling, hdl32)
+{
+  compareViews("32db.yaml", 32);
+}
+
+TEST(ViewCulling, hdl64)
+{
+  compareViews("64e_s2.1-sztaki.yaml", 64);
+}
+
+TEST(ViewCulling, fullView)
+{
+  int view_min_angle, view_max_angle;
+  EXPECT_FALSE(velodyne_driver::packetView(0.0, 2 * M_PI, &view_min_angle, &view_max_angle));
+  EXPECT_FALSE(velodyne_driver::packetView(1.0, 0.0, &view_min_angle, &view_max_angle));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}